@@ -1,7 +1,7 @@
 #version 450 //use glsl 4.5
 
-layout(location = 0) in vec4 position;
-layout(location = 1) in vec4 normal;
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec4 inNormal;
 layout(location = 2) in vec4 color;
 layout(location = 3) in vec2 texUV;
 
@@ -12,19 +12,21 @@ layout(set = 0, binding = 0) uniform UboVP
     vec4 lightPos;
 } uboVP;
 
-//unused (replaced by push constants)
-layout(set = 0, binding = 1) uniform DynamicUBObj
+//per object records, one per draw. the draw's first instance is the object's index in the table
+struct ObjectData
 {
     mat4 M;
     mat4 MinvT;
+    vec4 boundingSphere;
     int texIndex;
-} dynamicUBObj;
+    int materialIndex;
+    int vertexFormat; //0: Vertex, 1: PackedVertex
+};
 
-layout(push_constant) uniform PObj
+layout(std430, set = 0, binding = 1) readonly buffer ObjectTable
 {
-    mat4 M;
-    mat4 MinvT;
-} pushObj;
+    ObjectData objects[];
+} objectTable;
 
 layout(location = 0) out vec4 fragColor;
 layout(location = 1) out vec4 normalForFP;
@@ -32,16 +34,39 @@ layout(location = 2) out vec3 positionForFP;
 layout(location = 3) out vec2 fragTex;
 layout(location = 4) out flat int texID;
 
+const int VERTEX_FORMAT_PACKED = 1;
+
+//inverse of the octahedral encoding of PixelObject::packVertices(), same as shader.vert
+vec3 decodeOctahedral(vec2 encoded)
+{
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main()
 {
-    gl_Position = uboVP.P * uboVP.V * pushObj.M * position;
+    ObjectData object = objectTable.objects[gl_InstanceIndex];
+
+    //packed vertices come in normalized. the position is relative to the bounding sphere, the normal is octahedral
+    vec4 position = inPosition;
+    vec3 normal = inNormal.xyz;
+    if(object.vertexFormat == VERTEX_FORMAT_PACKED)
+    {
+        position = vec4(object.boundingSphere.xyz + inPosition.xyz * object.boundingSphere.w, 1.0);
+        normal = decodeOctahedral(inNormal.xy);
+    }
+
+    gl_Position = uboVP.P * uboVP.V * object.M * position;
     fragColor = color;
 
-    vec4 tempPos = uboVP.V * pushObj.M * position;
+    vec4 tempPos = uboVP.V * object.M * position;
     positionForFP = tempPos.xyz;
-    vec4 tempNorm = uboVP.V * pushObj.MinvT * vec4(normal.xyz, 0.0f);
+    vec4 tempNorm = uboVP.V * object.MinvT * vec4(normal, 0.0f);
     normalForFP = vec4(normalize(tempNorm.xyz),0.0f);
 
     fragTex = texUV;
-    texID = dynamicUBObj.texIndex;
+    texID = object.texIndex;
 }
\ No newline at end of file
@@ -5,5 +5,7 @@ C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V grid.frag -o gridFrag.spv
 C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V shader.comp -o comp.spv
 C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V NoLightingShader.vert -o NoLightingShaderVert.spv
 C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V NoLightingShader.frag -o NoLightingShaderFrag.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V cull.comp -o cull.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslangValidator.exe -V depthPyramid.comp -o depthPyramid.spv
 
 
@@ -7,4 +7,11 @@
 #  
 
 /Users/hamzalah/VulkanSDK/1.3.239.0/macOS/bin/glslc shader.vert -o vert.spv
-/Users/hamzalah/VulkanSDK/1.3.239.0/macOS/bin/glslc shader.frag -o frag.spv
\ No newline at end of file
+/Users/hamzalah/VulkanSDK/1.3.239.0/macOS/bin/glslc shader.frag -o frag.spv
+/Users/hamzalah/VulkanSDK/1.3.239.0/macOS/bin/glslc grid.vert -o gridVert.spv
+/Users/hamzalah/VulkanSDK/1.3.239.0/macOS/bin/glslc grid.frag -o gridFrag.spv
+/Users/hamzalah/VulkanSDK/1.3.239.0/macOS/bin/glslc shader.comp -o comp.spv
+/Users/hamzalah/VulkanSDK/1.3.239.0/macOS/bin/glslc NoLightingShader.vert -o NoLightingShaderVert.spv
+/Users/hamzalah/VulkanSDK/1.3.239.0/macOS/bin/glslc NoLightingShader.frag -o NoLightingShaderFrag.spv
+/Users/hamzalah/VulkanSDK/1.3.239.0/macOS/bin/glslc cull.comp -o cull.spv
+/Users/hamzalah/VulkanSDK/1.3.239.0/macOS/bin/glslc depthPyramid.comp -o depthPyramid.spv
@@ -1,4 +1,5 @@
 #version 450 //glsl version
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec4 fragColor;
 layout(location = 1) in vec4 normalForFP;
@@ -8,7 +9,13 @@ layout(location = 4) in vec2 fragTex;
 layout(location = 5) in flat int texID;
 
 
-layout(set = 1, binding = 0) uniform sampler2D texSampler[16];
+//global texture table, texID is the texture's stable index in it
+layout(set = 1, binding = 0) uniform sampler2D texSampler[];
+
+//finest mip level each texture was sampled at this frame (relative to its resident levels), read back by the texture streamer
+layout(set = 1, binding = 1) buffer TextureFeedback{
+    int minLevel[];
+} textureFeedback;
 
 layout(location = 0) out vec4 outColor; //final output color, must have location 0. we output to the first attachment
 
@@ -36,7 +43,15 @@ void main()
     vec3 albedo;
     if(texID >= 0 )
     {
-        albedo = texture(texSampler[texID], fragTex).xyz;
+        albedo = texture(texSampler[nonuniformEXT(texID)], fragTex).xyz;
+        //the lod needs the derivatives of the whole quad, it is queried before the branch below
+        int level = int(floor(textureQueryLod(texSampler[nonuniformEXT(texID)], fragTex).y));
+
+        //one fragment in 8x8 reports, that is plenty to find the level and keeps the atomics cheap
+        if((int(gl_FragCoord.x) & 7) == 0 && (int(gl_FragCoord.y) & 7) == 0)
+        {
+            atomicMin(textureFeedback.minLevel[texID], level);
+        }
     } else
     {
         albedo = fragColor.xyz;
@@ -0,0 +1,107 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#include "PixelAssetLoader.h"
+
+#include <exception>
+
+void PixelAssetLoader::init(PixBackend* device, PixelJobSystem* jobSystem, PixelUploadBatcher* uploadBatcher) {
+
+    printf("Creating Asset Loader\n");
+    fflush(stdout);
+
+    m_device = device;
+    m_jobSystem = jobSystem;
+    m_uploadBatcher = uploadBatcher;
+}
+
+uint32_t PixelAssetLoader::requestMesh(const std::string& filename) {
+
+    auto index = static_cast<uint32_t>(m_meshes.size());
+    m_meshes.emplace_back();
+
+    std::unique_ptr<PixelObject>& slot = m_meshes.back();
+    PixBackend* device = m_device;
+    bool useMeshCache = m_useMeshCache;
+    m_pendingJobs.push_back(runJob([&slot, device, filename, useMeshCache](){
+        slot = std::make_unique<PixelObject>(device, filename, useMeshCache);
+    }));
+
+    return index;
+}
+
+uint32_t PixelAssetLoader::requestTexture(const std::string& filename) {
+
+    auto index = static_cast<uint32_t>(m_textures.size());
+    m_textures.push_back(std::make_unique<PixelImage>(m_device, 0, 0, false));
+
+    PixelImage* texture = m_textures.back().get();
+    PixelUploadBatcher* uploadBatcher = m_uploadBatcher;
+    m_pendingJobs.push_back(runJob([texture, uploadBatcher, filename](){
+        //decode into the staging memory and create the image. the copy goes out with the next flushed batch
+        texture->loadTexture(filename, uploadBatcher);
+    }));
+
+    return index;
+}
+
+uint32_t PixelAssetLoader::requestStreamedTexture(PixelTextureStreamer* streamer, const std::string& filename) {
+
+    auto index = static_cast<uint32_t>(m_streamedTextures.size());
+    m_streamedTextures.push_back(0);
+
+    uint32_t& slot = m_streamedTextures.back();
+    m_pendingJobs.push_back(runJob([&slot, streamer, filename](){
+        slot = streamer->addTexture(filename);
+    }));
+
+    return index;
+}
+
+void PixelAssetLoader::waitAll() {
+
+    //the jobs reference their slots, none may still be running when an error is passed on
+    std::exception_ptr error;
+    for(auto& job : m_pendingJobs)
+    {
+        try {
+            job.get();
+        }
+        catch(...)
+        {
+            if(!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    }
+    m_pendingJobs.clear();
+
+    if(error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void PixelAssetLoader::clear() {
+
+    waitAll();
+    m_meshes.clear();
+    m_textures.clear();
+    m_streamedTextures.clear();
+}
+
+std::future<void> PixelAssetLoader::runJob(std::function<void()> job) {
+
+    if(m_parallel && m_jobSystem != nullptr)
+    {
+        return m_jobSystem->submit(std::move(job));
+    }
+
+    //sequential loading, the error is kept in the future like a job's
+    std::packaged_task<void()> task(std::move(job));
+    std::future<void> future = task.get_future();
+    task();
+    return future;
+}
@@ -0,0 +1,73 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#ifndef PIXELENGINE_PIXELASSETLOADER_H
+#define PIXELENGINE_PIXELASSETLOADER_H
+
+#include "PixelObject.h"
+#include "PixelImage.h"
+#include "PixelJobSystem.h"
+#include "PixelUploadBatcher.h"
+#include "PixelTextureStreamer.h"
+#include "Utility.h"
+
+#include <string>
+#include <deque>
+#include <memory>
+#include <future>
+#include <cstdint>
+
+//loads meshes and textures on the job system's threads. every request is its own job: mesh import, texture decode
+//and the copy into the upload batcher's staging ring run concurrently, and a texture's upload is recorded as soon as
+//it is decoded. requests are made from one thread, the assets can be read once waitAll() returned
+class PixelAssetLoader {
+public:
+    PixelAssetLoader() = default;
+    PixelAssetLoader(const PixelAssetLoader&) = delete;
+    PixelAssetLoader& operator=(const PixelAssetLoader&) = delete;
+
+    void init(PixBackend* device, PixelJobSystem* jobSystem, PixelUploadBatcher* uploadBatcher);
+
+    //file names are relative to objects/ and Textures/. the returned index is valid until clear()
+    uint32_t requestMesh(const std::string& filename);
+    uint32_t requestTexture(const std::string& filename);
+    //the texture is owned by the streamer, getStreamedTexture() gives its streamer id
+    uint32_t requestStreamedTexture(PixelTextureStreamer* streamer, const std::string& filename);
+
+    //wait for every request, the first error is rethrown once they are all done
+    void waitAll();
+
+    //forget the loaded assets. the gpu resources of the textures belong to whoever copied them, or are leaked
+    void clear();
+
+    //getters
+    PixelObject* getMesh(uint32_t index){return m_meshes[index].get();}
+    PixelImage* getTexture(uint32_t index){return m_textures[index].get();}
+    uint32_t getStreamedTexture(uint32_t index){return m_streamedTextures[index];}
+    uint32_t getMeshCount(){return static_cast<uint32_t>(m_meshes.size());}
+    uint32_t getTextureCount(){return static_cast<uint32_t>(m_textures.size());}
+
+    //setters
+    void setParallel(bool parallel){m_parallel = parallel;} //false loads every request on the calling thread
+    void setUseMeshCache(bool useMeshCache){m_useMeshCache = useMeshCache;}
+
+private:
+
+    std::future<void> runJob(std::function<void()> job);
+
+    PixBackend* m_device = VK_NULL_HANDLE;
+    PixelJobSystem* m_jobSystem = nullptr;
+    PixelUploadBatcher* m_uploadBatcher = nullptr;
+    bool m_parallel = true;
+    bool m_useMeshCache = true;
+
+    //deques so a job can keep a reference to its slot while more requests are added
+    std::deque<std::unique_ptr<PixelObject>> m_meshes;
+    std::deque<std::unique_ptr<PixelImage>> m_textures;
+    std::deque<uint32_t> m_streamedTextures;
+    std::deque<std::future<void>> m_pendingJobs;
+};
+
+
+#endif //PIXELENGINE_PIXELASSETLOADER_H
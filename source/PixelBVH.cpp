@@ -0,0 +1,406 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#include "PixelBVH.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstdio>
+
+float PixelBVH::Bounds::area() const {
+    glm::vec3 extent = max - min;
+    if(extent.x < 0.0f)
+    {
+        return 0.0f; //empty
+    }
+    return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+void PixelBVH::build(const std::vector<Bounds>& primitiveBounds, PixelJobSystem* jobSystem) {
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    clear();
+    auto primitiveCount = static_cast<uint32_t>(primitiveBounds.size());
+    if(primitiveCount == 0)
+    {
+        return;
+    }
+
+    m_primitiveBounds = &primitiveBounds;
+    m_centroids.resize(primitiveCount);
+    m_primitiveOrder.resize(primitiveCount);
+    for(uint32_t i = 0; i < primitiveCount; i++)
+    {
+        m_centroids[i] = (primitiveBounds[i].min + primitiveBounds[i].max) * 0.5f;
+        m_primitiveOrder[i] = i;
+    }
+
+    //a binary tree over n leaves has at most 2n - 1 nodes, the children are taken from here by any thread
+    m_nodes.resize(2 * static_cast<size_t>(primitiveCount));
+    m_nodes[0].leftFirst = 0;
+    m_nodes[0].primitiveCount = primitiveCount;
+    std::atomic<uint32_t> nodesUsed{1};
+    m_nodesUsed = &nodesUsed;
+
+    uint32_t threadCount = jobSystem != nullptr ? jobSystem->getThreadCount() : 1;
+    if(threadCount > 1 && primitiveCount >= 2 * BVH_MIN_PARALLEL_SUBTREE)
+    {
+        //the top of the tree is split here until the subtrees are small enough to balance the threads, the subtrees are
+        //then finished one job each
+        uint32_t deferredSize = std::max(BVH_MIN_PARALLEL_SUBTREE, primitiveCount / (4 * threadCount));
+        std::vector<Subtree> deferred;
+        subdivide(0, 0, deferredSize, &deferred);
+
+        //largest first so the last jobs are the short ones
+        std::sort(deferred.begin(), deferred.end(), [this](const Subtree& a, const Subtree& b){
+            return m_nodes[a.nodeIndex].primitiveCount > m_nodes[b.nodeIndex].primitiveCount;
+        });
+        jobSystem->parallelFor(static_cast<uint32_t>(deferred.size()), static_cast<uint32_t>(deferred.size()),
+                               [this, &deferred](uint32_t, uint32_t begin, uint32_t end){
+            for(uint32_t i = begin; i < end; i++)
+            {
+                subdivide(deferred[i].nodeIndex, deferred[i].depth, 0, nullptr);
+            }
+        });
+    } else
+    {
+        subdivide(0, 0, 0, nullptr);
+    }
+
+    m_nodes.resize(nodesUsed);
+    flattenDepthFirst();
+
+    m_primitiveBounds = nullptr;
+    m_nodesUsed = nullptr;
+    m_centroids.clear();
+    m_centroids.shrink_to_fit();
+
+    m_stats.buildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+    computeStats();
+}
+
+void PixelBVH::refit(const std::vector<Bounds>& primitiveBounds) {
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    //children are always stored after their parent
+    for(size_t i = m_nodes.size(); i-- > 0;)
+    {
+        Node& node = m_nodes[i];
+        Bounds bounds;
+        if(node.primitiveCount > 0)
+        {
+            for(uint32_t j = 0; j < node.primitiveCount; j++)
+            {
+                bounds.grow(primitiveBounds[m_primitiveOrder[node.leftFirst + j]]);
+            }
+        } else
+        {
+            const Node& left = m_nodes[node.leftFirst];
+            const Node& right = m_nodes[node.leftFirst + 1];
+            bounds.grow(Bounds{left.boundsMin, left.boundsMax});
+            bounds.grow(Bounds{right.boundsMin, right.boundsMax});
+        }
+        node.boundsMin = bounds.min;
+        node.boundsMax = bounds.max;
+    }
+
+    double buildMs = m_stats.buildMs;
+    computeStats(); //the boxes overlap more as the primitives move, the expected cost goes up
+    m_stats.buildMs = buildMs;
+    m_stats.refitMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+}
+
+void PixelBVH::clear() {
+    m_nodes.clear();
+    m_primitiveOrder.clear();
+    m_stats = Stats{};
+}
+
+void PixelBVH::subdivide(uint32_t nodeIndex, uint32_t depth, uint32_t deferredSize, std::vector<Subtree>* deferred) {
+
+    Node& node = m_nodes[nodeIndex];
+    updateNodeBounds(node);
+
+    if(node.primitiveCount <= 1 || depth >= BVH_MAX_DEPTH)
+    {
+        return;
+    }
+
+    int axis = -1;
+    float splitPosition = 0.0f;
+    float splitCost = 0.0f;
+    if(!findSplit(node, axis, splitPosition, splitCost))
+    {
+        return; //every centroid in the same place
+    }
+
+    //the cost of a leaf against one more level, in units of a primitive test weighted by the area
+    float nodeArea = Bounds{node.boundsMin, node.boundsMax}.area();
+    float leafCost = static_cast<float>(node.primitiveCount) * nodeArea;
+    if(splitCost + BVH_TRAVERSAL_COST * nodeArea >= leafCost && node.primitiveCount <= BVH_MAX_LEAF_SIZE)
+    {
+        return;
+    }
+
+    uint32_t i = node.leftFirst;
+    uint32_t end = node.leftFirst + node.primitiveCount;
+    while(i < end)
+    {
+        if(m_centroids[m_primitiveOrder[i]][axis] < splitPosition)
+        {
+            i++;
+        } else
+        {
+            std::swap(m_primitiveOrder[i], m_primitiveOrder[--end]);
+        }
+    }
+
+    uint32_t leftCount = i - node.leftFirst;
+    if(leftCount == 0 || leftCount == node.primitiveCount)
+    {
+        return;
+    }
+
+    uint32_t leftChild = m_nodesUsed->fetch_add(2);
+    m_nodes[leftChild].leftFirst = node.leftFirst;
+    m_nodes[leftChild].primitiveCount = leftCount;
+    m_nodes[leftChild + 1].leftFirst = i;
+    m_nodes[leftChild + 1].primitiveCount = node.primitiveCount - leftCount;
+    node.leftFirst = leftChild;
+    node.primitiveCount = 0;
+
+    for(uint32_t child = leftChild; child < leftChild + 2; child++)
+    {
+        if(deferred != nullptr && m_nodes[child].primitiveCount <= deferredSize)
+        {
+            deferred->push_back({child, depth + 1});
+        } else
+        {
+            subdivide(child, depth + 1, deferredSize, deferred);
+        }
+    }
+}
+
+bool PixelBVH::findSplit(const Node& node, int& axis, float& splitPosition, float& splitCost) const {
+
+    Bounds centroidBounds;
+    for(uint32_t i = 0; i < node.primitiveCount; i++)
+    {
+        centroidBounds.grow(m_centroids[m_primitiveOrder[node.leftFirst + i]]);
+    }
+
+    struct Bin{
+        Bounds bounds;
+        uint32_t count = 0;
+    };
+
+    axis = -1;
+    splitCost = 3.402823466e+38f;
+    for(int a = 0; a < 3; a++)
+    {
+        float boundsMin = centroidBounds.min[a];
+        float extent = centroidBounds.max[a] - boundsMin;
+        if(extent <= 0.0f)
+        {
+            continue;
+        }
+
+        Bin bins[BVH_BIN_COUNT];
+        float scale = static_cast<float>(BVH_BIN_COUNT) / extent;
+        for(uint32_t i = 0; i < node.primitiveCount; i++)
+        {
+            uint32_t primitive = m_primitiveOrder[node.leftFirst + i];
+            auto binIndex = std::min(BVH_BIN_COUNT - 1, static_cast<uint32_t>((m_centroids[primitive][a] - boundsMin) * scale));
+            bins[binIndex].count++;
+            bins[binIndex].bounds.grow((*m_primitiveBounds)[primitive]);
+        }
+
+        //area and count on both sides of every plane between two bins
+        float leftArea[BVH_BIN_COUNT - 1];
+        float rightArea[BVH_BIN_COUNT - 1];
+        uint32_t leftCount[BVH_BIN_COUNT - 1];
+        uint32_t rightCount[BVH_BIN_COUNT - 1];
+        Bounds leftBounds, rightBounds;
+        uint32_t leftSum = 0, rightSum = 0;
+        for(uint32_t i = 0; i < BVH_BIN_COUNT - 1; i++)
+        {
+            leftSum += bins[i].count;
+            leftCount[i] = leftSum;
+            leftBounds.grow(bins[i].bounds);
+            leftArea[i] = leftBounds.area();
+
+            rightSum += bins[BVH_BIN_COUNT - 1 - i].count;
+            rightCount[BVH_BIN_COUNT - 2 - i] = rightSum;
+            rightBounds.grow(bins[BVH_BIN_COUNT - 1 - i].bounds);
+            rightArea[BVH_BIN_COUNT - 2 - i] = rightBounds.area();
+        }
+
+        float binWidth = extent / static_cast<float>(BVH_BIN_COUNT);
+        for(uint32_t i = 0; i < BVH_BIN_COUNT - 1; i++)
+        {
+            if(leftCount[i] == 0 || rightCount[i] == 0)
+            {
+                continue;
+            }
+            float cost = static_cast<float>(leftCount[i]) * leftArea[i] + static_cast<float>(rightCount[i]) * rightArea[i];
+            if(cost < splitCost)
+            {
+                axis = a;
+                splitPosition = boundsMin + binWidth * static_cast<float>(i + 1);
+                splitCost = cost;
+            }
+        }
+    }
+
+    return axis >= 0;
+}
+
+void PixelBVH::updateNodeBounds(Node& node) const {
+
+    Bounds bounds;
+    for(uint32_t i = 0; i < node.primitiveCount; i++)
+    {
+        bounds.grow((*m_primitiveBounds)[m_primitiveOrder[node.leftFirst + i]]);
+    }
+    node.boundsMin = bounds.min;
+    node.boundsMax = bounds.max;
+}
+
+void PixelBVH::flattenDepthFirst() {
+
+    //the jobs took their nodes from the shared counter in any order. a subtree is made contiguous again so the
+    //traversal of one region of the scene stays within a few cache lines
+    std::vector<Node> nodes;
+    nodes.reserve(m_nodes.size());
+    nodes.push_back(m_nodes[0]);
+
+    std::vector<uint32_t> stack{0}; //indices into the new array, their children still index the old one
+    while(!stack.empty())
+    {
+        uint32_t nodeIndex = stack.back();
+        stack.pop_back();
+        if(nodes[nodeIndex].primitiveCount > 0)
+        {
+            continue;
+        }
+
+        uint32_t oldChild = nodes[nodeIndex].leftFirst;
+        auto newChild = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(m_nodes[oldChild]);
+        nodes.push_back(m_nodes[oldChild + 1]);
+        nodes[nodeIndex].leftFirst = newChild;
+
+        stack.push_back(newChild + 1);
+        stack.push_back(newChild); //the left subtree is laid out first
+    }
+
+    m_nodes = std::move(nodes);
+}
+
+void PixelBVH::computeStats() {
+
+    m_stats.primitiveCount = static_cast<uint32_t>(m_primitiveOrder.size());
+    m_stats.nodeCount = static_cast<uint32_t>(m_nodes.size());
+    m_stats.leafCount = 0;
+    m_stats.maxDepth = 0;
+    m_stats.maxLeafSize = 0;
+    m_stats.expectedNodeVisits = 0.0f;
+    m_stats.expectedPrimitiveTests = 0.0f;
+    if(m_nodes.empty())
+    {
+        return;
+    }
+
+    //a ray that hits the root hits a node with the probability of their area ratio
+    float rootArea = Bounds{m_nodes[0].boundsMin, m_nodes[0].boundsMax}.area();
+    struct Entry{
+        uint32_t nodeIndex;
+        uint32_t depth;
+    };
+    std::vector<Entry> stack{{0, 0}};
+    while(!stack.empty())
+    {
+        Entry entry = stack.back();
+        stack.pop_back();
+        const Node& node = m_nodes[entry.nodeIndex];
+
+        float probability = rootArea > 0.0f ? Bounds{node.boundsMin, node.boundsMax}.area() / rootArea : 1.0f;
+        m_stats.expectedNodeVisits += probability;
+        m_stats.maxDepth = std::max(m_stats.maxDepth, entry.depth);
+        if(node.primitiveCount > 0)
+        {
+            m_stats.leafCount++;
+            m_stats.maxLeafSize = std::max(m_stats.maxLeafSize, node.primitiveCount);
+            m_stats.expectedPrimitiveTests += probability * static_cast<float>(node.primitiveCount);
+        } else
+        {
+            stack.push_back({node.leftFirst, entry.depth + 1});
+            stack.push_back({node.leftFirst + 1, entry.depth + 1});
+        }
+    }
+}
+
+void PixelBVH::runBenchmark(uint32_t triangleCount, PixelJobSystem* jobSystem) {
+
+    //small triangles scattered through a box, a rough stand in for a dense mesh
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> offset(-0.2f, 0.2f);
+    std::vector<glm::vec3> vertices(3 * static_cast<size_t>(triangleCount));
+    for(uint32_t i = 0; i < triangleCount; i++)
+    {
+        glm::vec3 center(position(random), position(random), position(random));
+        for(uint32_t k = 0; k < 3; k++)
+        {
+            vertices[3 * i + k] = center + glm::vec3(offset(random), offset(random), offset(random));
+        }
+    }
+
+    auto computeBounds = [&vertices, triangleCount](std::vector<Bounds>& bounds){
+        bounds.assign(triangleCount, Bounds{});
+        for(uint32_t i = 0; i < triangleCount; i++)
+        {
+            for(uint32_t k = 0; k < 3; k++)
+            {
+                bounds[i].grow(vertices[3 * i + k]);
+            }
+        }
+    };
+
+    std::vector<Bounds> bounds;
+    computeBounds(bounds);
+
+    printf("BVH benchmark: %u triangles, %u threads\n", triangleCount, jobSystem->getThreadCount());
+
+    PixelBVH bvh;
+    double serialMs = 0.0;
+    for(int parallel = 0; parallel < 2; parallel++)
+    {
+        bvh.build(bounds, parallel ? jobSystem : nullptr);
+        const Stats& stats = bvh.getStats();
+        if(!parallel)
+        {
+            serialMs = stats.buildMs;
+        }
+        printf("  %-8s build %8.2f ms (%.2fx), %u nodes, %u leaves (max %u triangles), depth %u\n",
+               parallel ? "parallel" : "serial", stats.buildMs, serialMs / stats.buildMs,
+               stats.nodeCount, stats.leafCount, stats.maxLeafSize, stats.maxDepth);
+        printf("           per ray: %.1f node visits, %.1f triangle tests (%u without the BVH)\n",
+               stats.expectedNodeVisits, stats.expectedPrimitiveTests, triangleCount);
+    }
+
+    //everything moves a little, as an animation would
+    for(auto& vertex : vertices)
+    {
+        vertex += glm::vec3(offset(random), offset(random), offset(random));
+    }
+    computeBounds(bounds);
+    bvh.refit(bounds);
+    const Stats& stats = bvh.getStats();
+    printf("  refit    %8.2f ms, per ray: %.1f node visits, %.1f triangle tests\n",
+           stats.refitMs, stats.expectedNodeVisits, stats.expectedPrimitiveTests);
+}
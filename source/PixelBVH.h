@@ -0,0 +1,97 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#ifndef PIXELENGINE_PIXELBVH_H
+#define PIXELENGINE_PIXELBVH_H
+
+#include "PixelJobSystem.h"
+#include "glm/glm.hpp"
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+const uint32_t BVH_BIN_COUNT = 16; //SAH candidates per axis
+const float BVH_TRAVERSAL_COST = 1.0f; //visiting a node against testing a primitive
+const uint32_t BVH_MAX_LEAF_SIZE = 8; //bigger leaves are split even when the SAH prefers a leaf
+const uint32_t BVH_MAX_DEPTH = 32; //the traversal stack of shader.comp holds this many nodes
+const uint32_t BVH_MIN_PARALLEL_SUBTREE = 1024; //smaller subtrees are not worth a job
+
+//bounding volume hierarchy over the bounding boxes of primitives (the triangles of the compute ray tracer). built top
+//down with a binned SAH, the subtrees are built on the job system. the nodes are flattened depth first with the two
+//children of a node next to each other, and the primitives of a leaf are contiguous in getPrimitiveOrder().
+//refit() updates the boxes for moved primitives without changing the tree
+class PixelBVH {
+public:
+
+    struct Bounds{
+        glm::vec3 min = glm::vec3(3.402823466e+38f);
+        glm::vec3 max = glm::vec3(-3.402823466e+38f);
+
+        void grow(const glm::vec3& point){min = glm::min(min, point); max = glm::max(max, point);}
+        void grow(const Bounds& bounds){min = glm::min(min, bounds.min); max = glm::max(max, bounds.max);}
+        float area() const;
+    };
+
+    //layout must match BVHNode in shader.comp (std430)
+    struct Node{
+        glm::vec3 boundsMin;
+        uint32_t leftFirst; //first child (the second one follows it), or first primitive of a leaf
+        glm::vec3 boundsMax;
+        uint32_t primitiveCount; //0 for inner nodes
+    };
+
+    struct Stats{
+        uint32_t primitiveCount = 0;
+        uint32_t nodeCount = 0;
+        uint32_t leafCount = 0;
+        uint32_t maxDepth = 0;
+        uint32_t maxLeafSize = 0;
+        double buildMs = 0.0;
+        double refitMs = 0.0;
+        //SAH estimate for a random ray hitting the root: inner nodes visited and primitives tested
+        float expectedNodeVisits = 0.0f;
+        float expectedPrimitiveTests = 0.0f;
+    };
+
+    //without a job system the whole tree is built on the calling thread
+    void build(const std::vector<Bounds>& primitiveBounds, PixelJobSystem* jobSystem = nullptr);
+    //same primitives, moved. the boxes are recomputed bottom up
+    void refit(const std::vector<Bounds>& primitiveBounds);
+    void clear();
+
+    //getters
+    const std::vector<Node>& getNodes() const {return m_nodes;}
+    const std::vector<uint32_t>& getPrimitiveOrder() const {return m_primitiveOrder;} //primitive of each leaf slot
+    const Stats& getStats() const {return m_stats;}
+
+    //build random triangle soups of triangleCount triangles on one thread and on the job system
+    static void runBenchmark(uint32_t triangleCount, PixelJobSystem* jobSystem);
+
+private:
+
+    //build state
+    struct Subtree{
+        uint32_t nodeIndex;
+        uint32_t depth;
+    };
+
+    void subdivide(uint32_t nodeIndex, uint32_t depth, uint32_t deferredSize, std::vector<Subtree>* deferred);
+    bool findSplit(const Node& node, int& axis, float& splitPosition, float& splitCost) const;
+    void updateNodeBounds(Node& node) const;
+    void flattenDepthFirst();
+    void computeStats();
+
+    //only during build()
+    const std::vector<Bounds>* m_primitiveBounds = nullptr;
+    std::vector<glm::vec3> m_centroids;
+    std::atomic<uint32_t>* m_nodesUsed = nullptr;
+
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_primitiveOrder;
+    Stats m_stats{};
+};
+
+
+#endif //PIXELENGINE_PIXELBVH_H
@@ -4,9 +4,11 @@
 
 #include "PixelComputePipeline.h"
 
+#include <algorithm>
 #include <array>
+#include <cstring>
 
-PixelComputePipeline::PixelComputePipeline(PixBackend* backend, VkExtent2D inputExtent): m_backend(backend), m_extent(inputExtent) {
+PixelComputePipeline::PixelComputePipeline(PixBackend* backend, VkExtent2D inputExtent): m_extent(inputExtent), m_backend(backend) {
 
 }
 
@@ -22,19 +24,28 @@ void PixelComputePipeline::addComputeShader(const std::string &filename) {
 void PixelComputePipeline::cleanUp() {
 
 
-    if(!raytracedInputTexture.hasBeenCleaned())
+    for(auto& texture : accumulationTextures)
     {
-        raytracedInputTexture.cleanUp();
+        if(!texture.hasBeenCleaned())
+        {
+            texture.cleanUp();
+        }
     }
+    destroyTileBuffers();
 
     if(!customTexture.hasBeenCleaned())
     {
         customTexture.cleanUp();
     }
 
-    if(!raytracedOutputTexture.hasBeenCleaned())
+    for(uint32_t i = 0; i < SCENE_BUFFER_COUNT; i++)
     {
-        raytracedOutputTexture.cleanUp();
+        if(primitiveBuffers[i] != VK_NULL_HANDLE)
+        {
+            m_backend->allocator->destroyBuffer(&primitiveBuffers[i], &primitiveBufferAllocations[i]);
+            primitiveBuffers[i] = VK_NULL_HANDLE;
+            primitiveBufferCapacities[i] = 0;
+        }
     }
 
     vkDestroyPipeline(m_backend->logicalDevice, computePipeline, nullptr);
@@ -54,28 +65,273 @@ void PixelComputePipeline::populatePipelineLayout() {
 }
 
 void PixelComputePipeline::initImageBufferStorage() {
-    uint32_t width = 1024;
-    uint32_t height = 768;
-    raytracedInputTexture = PixelImage(m_backend, width, height, false);
-    raytracedInputTexture.loadEmptyTexture(width, height, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
-    raytracedOutputTexture = PixelImage(m_backend, width, height, false);
-    raytracedOutputTexture.loadEmptyTexture(width, height, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+    uint32_t width = std::max(m_extent.width, 1u);
+    uint32_t height = std::max(m_extent.height, 1u);
+    for(auto& texture : accumulationTextures)
+    {
+        texture = PixelImage(m_backend, width, height, false);
+        texture.loadEmptyTexture(width, height, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, ACCUMULATION_FORMAT);
+    }
     customTexture = PixelImage(m_backend, width, height, false);
-    customTexture.loadEmptyTexture(width, height, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+    customTexture.loadEmptyTexture(width, height, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+
+    //new images have no history
+    destroyTileBuffers();
+    createTileBuffers();
+    m_imagesInitialized = false;
+    m_accumulationIndex = 0;
+    resetAccumulation();
+}
+
+void PixelComputePipeline::createTileBuffers() {
+
+    VkExtent2D tileGrid = getTileGrid();
+    uint32_t tileCount = tileGrid.width * tileGrid.height;
+
+    //an entry is a tile index and its sample count, a tile is traced or copied at most once per dispatch
+    m_backend->allocator->createBuffer(sizeof(uint32_t) * 2 * tileCount * m_framesInFlight, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       &tileListBuffer, &tileListAllocation);
+    m_backend->allocator->createBuffer(sizeof(float) * tileCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       &tileErrorBuffer, &tileErrorAllocation);
+    memset(tileErrorAllocation.mappedData, 0, sizeof(float) * tileCount);
+
+    m_tileSamples.assign(tileCount, 0);
+    m_tileLastTraced.assign(tileCount, 0);
+    m_tileCandidates.reserve(tileCount);
+}
+
+void PixelComputePipeline::destroyTileBuffers() {
+
+    if(tileListBuffer != VK_NULL_HANDLE)
+    {
+        m_backend->allocator->destroyBuffer(&tileListBuffer, &tileListAllocation);
+        tileListBuffer = VK_NULL_HANDLE;
+    }
+    if(tileErrorBuffer != VK_NULL_HANDLE)
+    {
+        m_backend->allocator->destroyBuffer(&tileErrorBuffer, &tileErrorAllocation);
+        tileErrorBuffer = VK_NULL_HANDLE;
+    }
+}
+
+void PixelComputePipeline::resetAccumulation() {
+
+    test.currentSample = 0;
+    std::fill(m_tileSamples.begin(), m_tileSamples.end(), 0);
+    std::fill(m_tileLastTraced.begin(), m_tileLastTraced.end(), 0);
+    m_customImageValid = false;
+    m_samplingStats = SamplingStats{};
+    m_samplingStats.tileCount = static_cast<uint32_t>(m_tileSamples.size());
+}
+
+uint32_t PixelComputePipeline::scheduleTiles(uint32_t frameIndex) {
+
+    VkExtent2D tileGrid = getTileGrid();
+    uint32_t tileCount = tileGrid.width * tileGrid.height;
+    auto* tileErrors = static_cast<const float*>(tileErrorAllocation.mappedData); //may be a frame old
+    uint32_t* entries = static_cast<uint32_t*>(tileListAllocation.mappedData) + static_cast<size_t>(2) * tileCount * frameIndex;
+
+    SamplingStats stats{};
+    stats.tileCount = tileCount;
+    stats.totalSamples = m_samplingStats.totalSamples;
+
+    //every tile that is not converged is a candidate
+    m_tileCandidates.clear();
+    uint32_t unsampledTiles = 0;
+    for(uint32_t tile = 0; tile < tileCount; tile++)
+    {
+        unsampledTiles += m_tileSamples[tile] == 0 ? 1 : 0;
+        bool measured = m_tileSamples[tile] >= MIN_TILE_SAMPLES;
+        if(measured && tileErrors[tile] <= test.targetError)
+        {
+            stats.convergedTiles++;
+            continue;
+        }
+        if(measured)
+        {
+            stats.maxError = std::max(stats.maxError, tileErrors[tile]);
+        }
+        m_tileCandidates.push_back(tile);
+    }
+
+    //over the budget, the tiles without a variance yet go first and then the noisiest ones. tiles without any sample
+    //hold stale or undefined texels that differ between the two images, they are all traced whatever the budget
+    //(the whole image after a reset or a resize)
+    uint32_t maxTiles = m_sampleBudget == 0 ? tileCount : std::max(m_sampleBudget / (TILE_SIZE * TILE_SIZE), 1u);
+    maxTiles = std::max(maxTiles, unsampledTiles);
+    if(m_tileCandidates.size() > maxTiles)
+    {
+        std::nth_element(m_tileCandidates.begin(), m_tileCandidates.begin() + maxTiles, m_tileCandidates.end(),
+                         [this, tileErrors](uint32_t a, uint32_t b){
+            bool aMeasured = m_tileSamples[a] >= MIN_TILE_SAMPLES;
+            bool bMeasured = m_tileSamples[b] >= MIN_TILE_SAMPLES;
+            if(aMeasured != bMeasured)
+            {
+                return !aMeasured;
+            }
+            return aMeasured ? tileErrors[a] > tileErrors[b] : m_tileSamples[a] < m_tileSamples[b];
+        });
+        m_tileCandidates.resize(maxTiles);
+    }
+
+    uint32_t entryCount = 0;
+    for(uint32_t tile : m_tileCandidates)
+    {
+        entries[2 * entryCount] = tile | (static_cast<uint32_t>(TILE_TRACE) << TILE_MODE_SHIFT);
+        entries[2 * entryCount + 1] = m_tileSamples[tile];
+        entryCount++;
+
+        m_tileSamples[tile]++;
+        m_tileLastTraced[tile] = m_dispatchIndex + 1;
+
+        uint32_t tileWidth = std::min(TILE_SIZE, m_extent.width - (tile % tileGrid.width) * TILE_SIZE);
+        uint32_t tileHeight = std::min(TILE_SIZE, m_extent.height - (tile / tileGrid.width) * TILE_SIZE);
+        stats.samples += tileWidth * tileHeight;
+    }
+    stats.tracedTiles = entryCount;
+
+    //the outline follows the mouse over the whole image, the tiles that are not traced draw it again when it moved
+    CustomImageInputs customImageInputs{};
+    customImageInputs.mouseCoordX = test.outlineEnabled != 0 ? test.mouseCoordX : 0;
+    customImageInputs.mouseCoordY = test.outlineEnabled != 0 ? test.mouseCoordY : 0;
+    customImageInputs.outlineEnabled = test.outlineEnabled;
+    customImageInputs.heatmapEnabled = test.heatmapEnabled;
+    bool customImageStale = !m_customImageValid || !(customImageInputs == m_customImageInputs);
+    m_customImageInputs = customImageInputs;
+    m_customImageValid = true;
+
+    //the image written by this dispatch holds an older average of the tiles the previous dispatch traced. once copied,
+    //both images agree and the tile is left alone until it is traced again
+    for(uint32_t tile = 0; tile < tileCount; tile++)
+    {
+        if(m_tileLastTraced[tile] == m_dispatchIndex + 1)
+        {
+            continue;
+        }
+
+        TileMode mode;
+        if(m_dispatchIndex > 0 && m_tileLastTraced[tile] == m_dispatchIndex)
+        {
+            mode = customImageStale ? TILE_COPY_CUSTOM : TILE_COPY;
+            stats.copiedTiles++;
+        } else if(customImageStale)
+        {
+            mode = TILE_CUSTOM;
+        } else
+        {
+            continue;
+        }
+
+        entries[2 * entryCount] = tile | (static_cast<uint32_t>(mode) << TILE_MODE_SHIFT);
+        entries[2 * entryCount + 1] = m_tileSamples[tile];
+        entryCount++;
+    }
+
+    stats.totalSamples += stats.samples;
+    m_samplingStats = stats;
+    return entryCount;
+}
+
+void PixelComputePipeline::resize(VkExtent2D extent) {
+
+    printf("Resizing Compute Images to %ux%u\n", extent.width, extent.height);
+    fflush(stdout);
+
+    for(auto& texture : accumulationTextures)
+    {
+        texture.cleanUp();
+    }
+    customTexture.cleanUp();
+
+    m_extent = extent;
+    initImageBufferStorage();
+    writeImageDescriptors();
+}
+
+void PixelComputePipeline::recordRaytracing(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+
+    uint32_t entryCount = scheduleTiles(frameIndex);
+    test.tilesX = getTileGrid().width;
+    test.tileListOffset = getTileGrid().width * getTileGrid().height * frameIndex;
+
+    //the images keep the general layout from here on, the history of new images is not read (their tiles have no samples)
+    if(!m_imagesInitialized)
+    {
+        std::array<PixelImage*, 3> images = {&accumulationTextures[0], &accumulationTextures[1], &customTexture};
+        std::array<VkImageMemoryBarrier, 3> imageBarriers{};
+        for(size_t i = 0; i < images.size(); i++)
+        {
+            imageBarriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            imageBarriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageBarriers[i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            imageBarriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarriers[i].image = images[i]->getImage();
+            imageBarriers[i].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            imageBarriers[i].srcAccessMask = 0;
+            imageBarriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        }
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+        m_imagesInitialized = true;
+    } else
+    {
+        //the previous dispatch wrote the history read here and read the image written here
+        VkMemoryBarrier accumulationBarrier{};
+        accumulationBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        accumulationBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        accumulationBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &accumulationBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 1,
+                            &computeDescriptorSets[m_accumulationIndex], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pushComputeConstantRange.size, &test);
+
+    //one workgroup per listed tile. converged tiles are only listed when the custom image changed, both images already
+    //hold them
+    if(entryCount > 0)
+    {
+        vkCmdDispatch(commandBuffer, entryCount, 1, 1);
+    }
+
+    //the tile errors are read back by the scheduling of a later frame
+    VkMemoryBarrier errorBarrier{};
+    errorBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    errorBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    errorBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &errorBarrier, 0, nullptr, 0, nullptr);
+
+    //the next dispatch adds its samples to this one
+    m_accumulationIndex ^= 1;
+    m_dispatchIndex++;
+    test.currentSample++;
+}
+
+VkExtent2D PixelComputePipeline::getTileGrid() {
+    return {(m_extent.width + TILE_SIZE - 1) / TILE_SIZE, (m_extent.height + TILE_SIZE - 1) / TILE_SIZE};
 }
 
-void PixelComputePipeline::init() {
+void PixelComputePipeline::init(uint32_t framesInFlight) {
+    m_framesInFlight = framesInFlight;
     addComputeShader("shaders/comp.spv");
     initImageBufferStorage();
     createDescriptorSetLayout();
     createDescriptorPool();
     createDescriptorSets();
+    updatePrimitiveBuffers(); //the descriptors need buffers, even for an empty scene
     createComputePipelineLayout();
     createComputePipeline();
 }
 
 void PixelComputePipeline::createDescriptorSetLayout() {
-    std::array<VkDescriptorSetLayoutBinding, 3> layoutBindings{};
+    std::array<VkDescriptorSetLayoutBinding, 3 + SCENE_BUFFER_COUNT + 2> layoutBindings{};
 
     layoutBindings[0].binding = 0;
     layoutBindings[0].descriptorCount = 1;
@@ -95,6 +351,16 @@ void PixelComputePipeline::createDescriptorSetLayout() {
     layoutBindings[2].pImmutableSamplers = nullptr;
     layoutBindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
+    //spheres, planes, triangles and BVH nodes, then the tile list and the tile errors
+    for(uint32_t i = 0; i < SCENE_BUFFER_COUNT + 2; i++)
+    {
+        layoutBindings[3 + i].binding = 3 + i;
+        layoutBindings[3 + i].descriptorCount = 1;
+        layoutBindings[3 + i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layoutBindings[3 + i].pImmutableSamplers = nullptr;
+        layoutBindings[3 + i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     layoutInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
@@ -111,58 +377,63 @@ void PixelComputePipeline::createDescriptorSets() {
     VkDescriptorSetAllocateInfo textureSetAllocateInfo{};
     textureSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     textureSetAllocateInfo.descriptorPool = computeDescriptorPool;
-    textureSetAllocateInfo.descriptorSetCount = 1;
-    textureSetAllocateInfo.pSetLayouts = &computeDescriptorSetLayout;
+    //one per accumulation direction, the images swap their bindings
+    std::array<VkDescriptorSetLayout, 2> setLayouts = {computeDescriptorSetLayout, computeDescriptorSetLayout};
+    textureSetAllocateInfo.descriptorSetCount = static_cast<uint32_t>(setLayouts.size());
+    textureSetAllocateInfo.pSetLayouts = setLayouts.data();
     // has to be 1:1 relationship with descriptor sets
 
-    VkResult result = vkAllocateDescriptorSets(m_backend->logicalDevice, &textureSetAllocateInfo, &computeDescriptorSet);
+    VkResult result = vkAllocateDescriptorSets(m_backend->logicalDevice, &textureSetAllocateInfo, computeDescriptorSets.data());
     if(result != VK_SUCCESS)
     {
         throw std::runtime_error("failed to allocate descriptor set for compute textures");
     }
 
-    std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
-
-    VkDescriptorImageInfo inputImageBuffer{};
-    inputImageBuffer.imageView = raytracedInputTexture.getImageView();
-    inputImageBuffer.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    //inputImageBuffer.sampler = VK_NULL_HANDLE;
-
-    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[0].dstSet = computeDescriptorSet;
-    descriptorWrites[0].dstBinding = 0;
-    descriptorWrites[0].dstArrayElement = 0;
-    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    descriptorWrites[0].descriptorCount = 1;
-    descriptorWrites[0].pImageInfo = &inputImageBuffer;
-
-    VkDescriptorImageInfo ouputImageBuffer{};
-    ouputImageBuffer.imageView = raytracedOutputTexture.getImageView();
-    ouputImageBuffer.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    //ouputImageBuffer.sampler = VK_NULL_HANDLE;
-
-    descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[1].dstSet = computeDescriptorSet;
-    descriptorWrites[1].dstBinding = 1;
-    descriptorWrites[1].dstArrayElement = 0;
-    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    descriptorWrites[1].descriptorCount = 1;
-    descriptorWrites[1].pImageInfo = &ouputImageBuffer;
-
-    VkDescriptorImageInfo customImageBuffer{};
-    customImageBuffer.imageView = customTexture.getImageView();
-    customImageBuffer.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    //ouputImageBuffer.sampler = VK_NULL_HANDLE;
-
-    descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[2].dstSet = computeDescriptorSet;
-    descriptorWrites[2].dstBinding = 2;
-    descriptorWrites[2].dstArrayElement = 0;
-    descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    descriptorWrites[2].descriptorCount = 1;
-    descriptorWrites[2].pImageInfo = &customImageBuffer;
-
-    vkUpdateDescriptorSets(m_backend->logicalDevice, 3, descriptorWrites.data(), 0, nullptr);
+    writeImageDescriptors();
+}
+
+void PixelComputePipeline::writeImageDescriptors() {
+
+    //set i reads the history from accumulation image i and writes the new average to the other one
+    std::array<VkDescriptorImageInfo, 6> imageInfos{};
+    std::array<VkWriteDescriptorSet, 6> descriptorWrites{};
+    for(uint32_t set = 0; set < 2; set++)
+    {
+        std::array<PixelImage*, 3> images = {&accumulationTextures[set], &accumulationTextures[set ^ 1], &customTexture};
+        for(uint32_t binding = 0; binding < 3; binding++)
+        {
+            uint32_t i = set * 3 + binding;
+            imageInfos[i].imageView = images[binding]->getImageView();
+            imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+            descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[i].dstSet = computeDescriptorSets[set];
+            descriptorWrites[i].dstBinding = binding;
+            descriptorWrites[i].dstArrayElement = 0;
+            descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            descriptorWrites[i].descriptorCount = 1;
+            descriptorWrites[i].pImageInfo = &imageInfos[i];
+        }
+    }
+
+    //the tile buffers follow the extent as well, both sets share them
+    std::array<VkDescriptorBufferInfo, 2> bufferInfos{};
+    bufferInfos[0] = {tileListBuffer, 0, VK_WHOLE_SIZE};
+    bufferInfos[1] = {tileErrorBuffer, 0, VK_WHOLE_SIZE};
+    std::array<VkWriteDescriptorSet, 4> bufferWrites{};
+    for(uint32_t i = 0; i < bufferWrites.size(); i++)
+    {
+        bufferWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        bufferWrites[i].dstSet = computeDescriptorSets[i / 2];
+        bufferWrites[i].dstBinding = 3 + SCENE_BUFFER_COUNT + i % 2;
+        bufferWrites[i].dstArrayElement = 0;
+        bufferWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bufferWrites[i].descriptorCount = 1;
+        bufferWrites[i].pBufferInfo = &bufferInfos[i % 2];
+    }
+
+    vkUpdateDescriptorSets(m_backend->logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    vkUpdateDescriptorSets(m_backend->logicalDevice, static_cast<uint32_t>(bufferWrites.size()), bufferWrites.data(), 0, nullptr);
 }
 
 void PixelComputePipeline::createDescriptorPool() {
@@ -230,6 +501,155 @@ void PixelComputePipeline::createComputePipelineLayout() {
     }
 }
 
+void PixelComputePipeline::addSphere(glm::vec3 center, float radius, glm::vec3 color, float metalFactor) {
+    m_spheres.push_back({glm::vec4(center, radius), glm::vec4(color, metalFactor)});
+}
+
+void PixelComputePipeline::addPlane(glm::vec3 origin, glm::vec3 normal, glm::vec3 color1, glm::vec3 color2, float metalFactor) {
+    m_planes.push_back({glm::vec4(origin, metalFactor), glm::vec4(glm::normalize(normal), 0.0f), glm::vec4(color1, 1.0f), glm::vec4(color2, 1.0f)});
+}
+
+uint32_t PixelComputePipeline::addMesh(PixelObject* object, glm::vec3 color, float metalFactor) {
+
+    std::vector<PixelObject::Vertex>* vertices = object->getVertices();
+    std::vector<uint32_t>* indices = object->getIndices();
+
+    auto meshIndex = static_cast<uint32_t>(m_meshes.size());
+    auto objectId = static_cast<float>(meshIndex);
+    Mesh mesh{static_cast<uint32_t>(m_triangles.size()), 0};
+    m_triangles.reserve(m_triangles.size() + indices->size() / 3);
+    for(size_t i = 0; i + 2 < indices->size(); i += 3)
+    {
+        for(size_t k = 0; k < 3; k++)
+        {
+            m_objectVertices.emplace_back((*vertices)[(*indices)[i + k]].position);
+        }
+        m_triangles.push_back({glm::vec4(0.0f, 0.0f, 0.0f, metalFactor), glm::vec4(0.0f, 0.0f, 0.0f, objectId), glm::vec4(0.0f), glm::vec4(color, 1.0f)});
+        mesh.triangleCount++;
+    }
+    m_meshes.push_back(mesh);
+
+    setMeshTransform(meshIndex, object->getObjectData()->M);
+    m_bvhRebuild = true;
+    return meshIndex;
+}
+
+void PixelComputePipeline::setMeshTransform(uint32_t meshIndex, const glm::mat4& transform) {
+
+    const Mesh& mesh = m_meshes[meshIndex];
+    for(uint32_t i = mesh.firstTriangle; i < mesh.firstTriangle + mesh.triangleCount; i++)
+    {
+        Triangle& triangle = m_triangles[i];
+        triangle.v0Metal = glm::vec4(glm::vec3(transform * glm::vec4(m_objectVertices[3 * i], 1.0f)), triangle.v0Metal.w);
+        triangle.v1ObjectId = glm::vec4(glm::vec3(transform * glm::vec4(m_objectVertices[3 * i + 1], 1.0f)), triangle.v1ObjectId.w);
+        triangle.v2 = glm::vec4(glm::vec3(transform * glm::vec4(m_objectVertices[3 * i + 2], 1.0f)), 0.0f);
+    }
+    m_bvhRefit = true;
+}
+
+void PixelComputePipeline::clearPrimitives() {
+    m_spheres.clear();
+    m_planes.clear();
+    m_triangles.clear();
+    m_objectVertices.clear();
+    m_meshes.clear();
+    m_bvhRebuild = true;
+}
+
+void PixelComputePipeline::updatePrimitiveBuffers() {
+
+    if(m_bvhRebuild || m_bvhRefit)
+    {
+        std::vector<PixelBVH::Bounds> triangleBounds(m_triangles.size());
+        for(size_t i = 0; i < m_triangles.size(); i++)
+        {
+            triangleBounds[i].grow(glm::vec3(m_triangles[i].v0Metal));
+            triangleBounds[i].grow(glm::vec3(m_triangles[i].v1ObjectId));
+            triangleBounds[i].grow(glm::vec3(m_triangles[i].v2));
+        }
+
+        if(m_bvhRebuild)
+        {
+            m_bvh.build(triangleBounds, m_jobSystem);
+        } else
+        {
+            m_bvh.refit(triangleBounds); //same tree, only the boxes follow the moved meshes
+        }
+
+        //the leaves index the triangles directly, the shader needs no indirection
+        const std::vector<uint32_t>& order = m_bvh.getPrimitiveOrder();
+        m_bvhTriangles.resize(order.size());
+        for(size_t i = 0; i < order.size(); i++)
+        {
+            m_bvhTriangles[i] = m_triangles[order[i]];
+        }
+        m_bvhRebuild = false;
+        m_bvhRefit = false;
+    }
+
+    const std::vector<PixelBVH::Node>& nodes = m_bvh.getNodes();
+    std::array<const void*, SCENE_BUFFER_COUNT> data = {m_spheres.data(), m_planes.data(), m_bvhTriangles.data(), nodes.data()};
+    std::array<VkDeviceSize, SCENE_BUFFER_COUNT> sizes = {sizeof(Sphere) * m_spheres.size(), sizeof(Plane) * m_planes.size(),
+                                                          sizeof(Triangle) * m_bvhTriangles.size(), sizeof(PixelBVH::Node) * nodes.size()};
+    std::array<VkDeviceSize, SCENE_BUFFER_COUNT> strides = {sizeof(Sphere), sizeof(Plane), sizeof(Triangle), sizeof(PixelBVH::Node)};
+
+    bool buffersChanged = false;
+    for(uint32_t i = 0; i < SCENE_BUFFER_COUNT; i++)
+    {
+        //grown to fit, never smaller than one element so the descriptor always has a buffer
+        VkDeviceSize requiredSize = std::max(sizes[i], strides[i]);
+        if(requiredSize > primitiveBufferCapacities[i])
+        {
+            if(primitiveBuffers[i] != VK_NULL_HANDLE)
+            {
+                m_backend->allocator->destroyBuffer(&primitiveBuffers[i], &primitiveBufferAllocations[i]);
+            }
+            m_backend->allocator->createBuffer(requiredSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                               &primitiveBuffers[i], &primitiveBufferAllocations[i]);
+            primitiveBufferCapacities[i] = requiredSize;
+            buffersChanged = true;
+        }
+
+        if(sizes[i] > 0)
+        {
+            memcpy(primitiveBufferAllocations[i].mappedData, data[i], static_cast<size_t>(sizes[i]));
+        }
+    }
+
+    if(buffersChanged)
+    {
+        writePrimitiveDescriptors();
+    }
+
+    test.sphereCount = static_cast<uint32_t>(m_spheres.size());
+    test.planeCount = static_cast<uint32_t>(m_planes.size());
+    test.triangleCount = static_cast<uint32_t>(m_bvhTriangles.size());
+}
+
+void PixelComputePipeline::writePrimitiveDescriptors() {
+
+    std::array<VkDescriptorBufferInfo, SCENE_BUFFER_COUNT> bufferInfos{};
+    std::array<VkWriteDescriptorSet, 2 * SCENE_BUFFER_COUNT> descriptorWrites{};
+    for(uint32_t i = 0; i < 2 * SCENE_BUFFER_COUNT; i++)
+    {
+        uint32_t buffer = i % SCENE_BUFFER_COUNT;
+        bufferInfos[buffer].buffer = primitiveBuffers[buffer];
+        bufferInfos[buffer].offset = 0;
+        bufferInfos[buffer].range = VK_WHOLE_SIZE;
+
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].dstSet = computeDescriptorSets[i / SCENE_BUFFER_COUNT]; //both sets see the same scene
+        descriptorWrites[i].dstBinding = 3 + buffer;
+        descriptorWrites[i].dstArrayElement = 0;
+        descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].pBufferInfo = &bufferInfos[buffer];
+    }
+
+    vkUpdateDescriptorSets(m_backend->logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
 VkPipeline PixelComputePipeline::getPipeline() {
     return computePipeline;
 }
@@ -239,11 +659,11 @@ VkPipelineLayout PixelComputePipeline::getPipelineLayout() {
 }
 
 VkDescriptorSet PixelComputePipeline::getDescriptorSet() {
-    return computeDescriptorSet;
+    return computeDescriptorSets[m_accumulationIndex];
 }
 
 PixelImage* PixelComputePipeline::getInputTexture() {
-    return &raytracedInputTexture;
+    return &accumulationTextures[m_accumulationIndex];
 }
 
 PixelImage* PixelComputePipeline::getCustomTexture() {
@@ -251,7 +671,7 @@ PixelImage* PixelComputePipeline::getCustomTexture() {
 }
 
 PixelImage* PixelComputePipeline::getOutputTexture() {
-    return &raytracedOutputTexture;
+    return &accumulationTextures[m_accumulationIndex ^ 1];
 }
 
 
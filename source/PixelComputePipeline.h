@@ -5,12 +5,23 @@
 #ifndef PIXELENGINE_PIXELCOMPUTEPIPELINE_H
 #define PIXELENGINE_PIXELCOMPUTEPIPELINE_H
 
+#include "PixelBVH.h"
 #include "PixelImage.h"
+#include "PixelJobSystem.h"
+#include "PixelObject.h"
 #include "glm/glm.hpp"
 
+#include <array>
+#include <vector>
+
 class PixelComputePipeline {
 public:
-    PixelComputePipeline(PixBackend* backend, VkExtent2D inputExtent);
+    //local_size_x and local_size_y of shader.comp, a workgroup traces one tile
+    static constexpr uint32_t TILE_SIZE = 8;
+    static constexpr uint32_t MIN_TILE_SAMPLES = 4; //before the variance of a tile is trusted
+    static constexpr float DEFAULT_TARGET_ERROR = 0.01f; //relative standard error a tile converges at
+
+    PixelComputePipeline(PixBackend* backend, VkExtent2D inputExtent); //extent of the ray traced images
     PixelComputePipeline() = default;
 
     struct PObj{
@@ -25,6 +36,33 @@ public:
         uint32_t mouseCoordX;
         uint32_t mouseCoordY;
         uint32_t outlineEnabled;
+        uint32_t sphereCount; //set by updatePrimitiveBuffers()
+        uint32_t planeCount;
+        uint32_t triangleCount;
+        uint32_t tilesX; //set by recordRaytracing()
+        uint32_t tileListOffset;
+        uint32_t heatmapEnabled;
+        float targetError;
+    };
+
+    //primitives of the ray traced scene, read by shader.comp from storage buffers. layouts must match it (std430)
+    struct Sphere{
+        glm::vec4 centerRadius;
+        glm::vec4 colorMetal; //rgb, metal factor
+    };
+
+    struct Plane{
+        glm::vec4 originMetal; //origin, metal factor
+        glm::vec4 normal;
+        glm::vec4 color1; //checkerboard colors
+        glm::vec4 color2;
+    };
+
+    struct Triangle{
+        glm::vec4 v0Metal; //first vertex, metal factor
+        glm::vec4 v1ObjectId; //second vertex, index of the mesh it belongs to
+        glm::vec4 v2;
+        glm::vec4 color;
     };
 
     void addComputeShader(const std::string& filename);
@@ -35,30 +73,74 @@ public:
     void createDescriptorSetLayout();
     void createComputePipeline();
     void createComputePipelineLayout();
-    void init();
+    void init(uint32_t framesInFlight);
     void cleanUp();
+    //recreates the images at the new extent, must not run while a compute frame is in flight
+    void resize(VkExtent2D extent);
+
+    //one sample of the noisiest tiles, averaged into their previous ones. the two accumulation images swap between the
+    //dispatches (alternate descriptor sets), so nothing is copied and the images stay in the general layout.
+    //called once the fence of the frame was waited on, its tile list is rewritten
+    void recordRaytracing(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+    void resetAccumulation(); //when the camera or the scene changed
+
+    struct SamplingStats{
+        uint32_t tileCount = 0;
+        uint32_t tracedTiles = 0; //by the last dispatch
+        uint32_t copiedTiles = 0;
+        uint32_t convergedTiles = 0;
+        uint64_t samples = 0; //pixel samples of the last dispatch
+        uint64_t totalSamples = 0; //since the accumulation was reset
+        float maxError = 0.0f; //of the tiles that are not converged
+    };
+
+    //scene. the primitives are uploaded by updatePrimitiveBuffers(), which must not run while a compute frame is in flight.
+    //the triangles are traced through a BVH, rebuilt when meshes are added and refit when they only move
+    void addSphere(glm::vec3 center, float radius, glm::vec3 color, float metalFactor);
+    void addPlane(glm::vec3 origin, glm::vec3 normal, glm::vec3 color1, glm::vec3 color2, float metalFactor);
+    uint32_t addMesh(PixelObject* object, glm::vec3 color, float metalFactor); //the triangles of its indices, in world space
+    void setMeshTransform(uint32_t meshIndex, const glm::mat4& transform);
+    void clearPrimitives();
+    void updatePrimitiveBuffers();
     static constexpr VkPushConstantRange pushComputeConstantRange {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PObj)};
 
     //getters
     VkPipeline getPipeline();
     VkPipelineLayout getPipelineLayout();
-    VkDescriptorSet getDescriptorSet();
-    PixelImage* getInputTexture();
-    PixelImage* getOutputTexture();
+    VkDescriptorSet getDescriptorSet(); //of the next dispatch
+    PixelImage* getInputTexture(); //history read by the next dispatch, the latest average once a dispatch finished
+    PixelImage* getOutputTexture(); //written by the next dispatch
     PixelImage* getCustomTexture();
+    VkExtent2D getExtent(){return m_extent;}
+    VkExtent2D getTileGrid(); //tiles covering the extent, the shader skips the pixels past its edge
+    const SamplingStats& getSamplingStats(){return m_samplingStats;}
+    float getTargetError(){return test.targetError;}
+    uint32_t getSampleBudget(){return m_sampleBudget;}
+    bool isHeatmapEnabled(){return test.heatmapEnabled != 0;}
     PObj* getPushObj(){return &test;}
+    uint32_t getTriangleCount(){return static_cast<uint32_t>(m_triangles.size());}
+    const PixelBVH::Stats& getBVHStats(){return m_bvh.getStats();}
 
     //setters
     void setPushObj(PixelComputePipeline::PObj pObj){test = pObj;}
+    void setJobSystem(PixelJobSystem* jobSystem){m_jobSystem = jobSystem;} //builds the BVH on its threads
+    void setTargetError(float targetError){test.targetError = targetError;}
+    void setSampleBudget(uint32_t samplesPerFrame){m_sampleBudget = samplesPerFrame;} //0 traces every tile that is not converged, tiles without samples are always traced
+    void setHeatmapEnabled(bool enabled){test.heatmapEnabled = enabled ? 1 : 0;} //tile noise and sample count in the custom texture
 
 private:
 
     VkExtent2D m_extent{};
-    PixelImage raytracedInputTexture;
-    PixelImage raytracedOutputTexture;
+    //running average of the samples. rgba32f, the 1/n steps of a long accumulation vanish in rgba8 or rgba16f
+    static constexpr VkFormat ACCUMULATION_FORMAT = VK_FORMAT_R32G32B32A32_SFLOAT;
+    std::array<PixelImage, 2> accumulationTextures;
     PixelImage customTexture;
+    uint32_t m_accumulationIndex = 0; //accumulation image read by the next dispatch
+    bool m_imagesInitialized = false; //still in the undefined layout
 
-    PObj test = {{0.0f,1.0f,5.0f},35.0f,{0.0f,0.0f,0.0f},0.0f, {3.0f,4.0f,0.0f},0.0f,{1.0f,1.0f,1.0f,1.0f}, 0, 0, 0, 0};
+    //focused on the look at point of shader.comp
+    PObj test = {{0.0f,1.0f,5.0f},35.0f,{0.0f,0.0f,0.0f},8.06f, {3.0f,4.0f,0.0f},0.0f,{1.0f,1.0f,1.0f,1.0f}, 0, 0, 0, 0,
+                 0, 0, 0, 0, 0, 0, DEFAULT_TARGET_ERROR};
 
     PixBackend* m_backend{};
     VkPipelineShaderStageCreateInfo computeCreateShaderInfo{};
@@ -67,8 +149,76 @@ private:
     VkPipelineLayoutCreateInfo computePipelineLayoutCreateInfo = {};
     VkShaderModule computeShaderModule = VK_NULL_HANDLE;
     VkDescriptorSetLayout computeDescriptorSetLayout{};
-    VkDescriptorSet computeDescriptorSet{};
+    std::array<VkDescriptorSet, 2> computeDescriptorSets{};
     VkDescriptorPool computeDescriptorPool{};
+
+    struct Mesh{
+        uint32_t firstTriangle;
+        uint32_t triangleCount;
+    };
+
+    //scene primitives, host visible. spheres, planes, triangles in BVH order and the BVH nodes
+    static constexpr uint32_t SCENE_BUFFER_COUNT = 4;
+    std::vector<Sphere> m_spheres;
+    std::vector<Plane> m_planes;
+    std::vector<Triangle> m_triangles;
+    std::vector<glm::vec3> m_objectVertices; //three per triangle, before the mesh transform
+    std::vector<Mesh> m_meshes;
+    std::array<VkBuffer, SCENE_BUFFER_COUNT> primitiveBuffers{};
+    std::array<PixAllocation, SCENE_BUFFER_COUNT> primitiveBufferAllocations{};
+    std::array<VkDeviceSize, SCENE_BUFFER_COUNT> primitiveBufferCapacities{};
+
+    PixelJobSystem* m_jobSystem{};
+    PixelBVH m_bvh;
+    std::vector<Triangle> m_bvhTriangles; //m_triangles in the order of the BVH leaves
+    bool m_bvhRebuild = true;
+    bool m_bvhRefit = false;
+
+    //adaptive sampling, a tile list per frame in flight written here and the tile errors written by the shader.
+    //both host visible
+    //mode of a tile list entry, in the top bits of its tile index. values match shader.comp
+    enum TileMode
+    {
+        TILE_TRACE, //a new sample, the custom image follows it
+        TILE_COPY, //the average of the previous dispatch is carried over to the other image
+        TILE_COPY_CUSTOM, //same, and the custom image is drawn again
+        TILE_CUSTOM //only the custom image is drawn again
+    };
+    static constexpr uint32_t TILE_MODE_SHIFT = 30;
+
+    //what the custom image was last drawn with. it does not depend on the samples, converged tiles only draw it again
+    //when this changes
+    struct CustomImageInputs{
+        uint32_t mouseCoordX;
+        uint32_t mouseCoordY;
+        uint32_t outlineEnabled;
+        uint32_t heatmapEnabled;
+
+        bool operator==(const CustomImageInputs& other) const {
+            return mouseCoordX == other.mouseCoordX && mouseCoordY == other.mouseCoordY &&
+                   outlineEnabled == other.outlineEnabled && heatmapEnabled == other.heatmapEnabled;
+        }
+    };
+
+    uint32_t m_framesInFlight = 1;
+    uint32_t m_sampleBudget = 0;
+    uint64_t m_dispatchIndex = 0;
+    std::vector<uint32_t> m_tileSamples;
+    std::vector<uint64_t> m_tileLastTraced; //dispatch index + 1, 0 when never traced
+    std::vector<uint32_t> m_tileCandidates;
+    SamplingStats m_samplingStats{};
+    CustomImageInputs m_customImageInputs{};
+    bool m_customImageValid = false;
+    VkBuffer tileListBuffer = VK_NULL_HANDLE;
+    PixAllocation tileListAllocation{};
+    VkBuffer tileErrorBuffer = VK_NULL_HANDLE;
+    PixAllocation tileErrorAllocation{};
+
+    void createTileBuffers();
+    void destroyTileBuffers();
+    uint32_t scheduleTiles(uint32_t frameIndex); //the number of entries written
+    void writeImageDescriptors();
+    void writePrimitiveDescriptors();
 };
 
 
@@ -0,0 +1,634 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#include "PixelCullingPipeline.h"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <array>
+#include <cassert>
+#include <algorithm>
+#include <cstring>
+
+static const uint32_t CULL_GROUP_SIZE = 64; //local_size_x of cull.comp
+static const uint32_t PYRAMID_GROUP_SIZE = 8; //local_size_x and local_size_y of depthPyramid.comp
+
+#ifndef NDEBUG
+//a box above the camera has to land on the top rows of the depth pyramid and one below it on the bottom rows, which
+//only holds with the y flip of getCullProjection()
+static bool occlusionRectMatchesPyramid()
+{
+    //a 2x2 pyramid level of a wall close to the camera covering the top half of the screen, nothing below it
+    const float pyramid[2][2] = {{0.1f, 0.1f}, {1.0f, 1.0f}}; //[row][column], row 0 is the top of the screen
+    auto isOccluded = [&pyramid](glm::vec2 minUV, glm::vec2 maxUV, float depth){
+        float pyramidDepth = 0.0f;
+        for(glm::vec2 uv : {minUV, glm::vec2(maxUV.x, minUV.y), glm::vec2(minUV.x, maxUV.y), maxUV})
+        {
+            glm::ivec2 texel = glm::clamp(glm::ivec2(uv * 2.0f), 0, 1);
+            pyramidDepth = std::max(pyramidDepth, pyramid[texel.y][texel.x]);
+        }
+        return depth > pyramidDepth;
+    };
+
+    glm::mat4 cullProjection = PixelCullingPipeline::getCullProjection(glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.01f, 100.0f));
+    glm::vec2 minUV, maxUV;
+
+    PixelCullingPipeline::getOcclusionRect(cullProjection, glm::vec3(0.0f, 2.0f, -10.0f), 0.5f, minUV, maxUV);
+    bool aboveOccluded = maxUV.y < 0.5f && isOccluded(minUV, maxUV, 0.5f);
+    PixelCullingPipeline::getOcclusionRect(cullProjection, glm::vec3(0.0f, -2.0f, -10.0f), 0.5f, minUV, maxUV);
+    bool belowOccluded = minUV.y > 0.5f && isOccluded(minUV, maxUV, 0.5f);
+
+    return aboveOccluded && !belowOccluded;
+}
+#endif
+
+void PixelCullingPipeline::init(PixBackend* backend, PixelImage* depthImage, uint32_t frameCount) {
+
+    printf("Creating Culling Pipeline\n");
+    fflush(stdout);
+
+    m_backend = backend;
+    m_depthImage = depthImage;
+    m_frameCount = frameCount;
+
+    assert(occlusionRectMatchesPyramid() && "the culling projection does not match the depth pyramid rows");
+
+    //per frame uniform and counters, both persistently mapped
+    cullDataBuffers.resize(m_frameCount);
+    cullDataBufferAllocations.resize(m_frameCount);
+    statsBuffers.resize(m_frameCount);
+    statsBufferAllocations.resize(m_frameCount);
+    writtenCullBindings.resize(m_frameCount);
+    for(uint32_t i = 0; i < m_frameCount; i++)
+    {
+        m_backend->allocator->createBuffer(sizeof(CullData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                           &cullDataBuffers[i], &cullDataBufferAllocations[i]);
+
+        //cleared on the gpu before every culling pass
+        m_backend->allocator->createBuffer(sizeof(CullStats), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                           &statsBuffers[i], &statsBufferAllocations[i]);
+        memset(statsBufferAllocations[i].mappedData, 0, sizeof(CullStats));
+    }
+
+    createPyramid();
+    createDescriptorSetLayouts();
+    createDescriptorPool();
+    createDescriptorSets();
+    createPipelines();
+}
+
+void PixelCullingPipeline::cleanUp() {
+
+    vkDestroyPipeline(m_backend->logicalDevice, cullPipeline, nullptr);
+    vkDestroyPipelineLayout(m_backend->logicalDevice, cullPipelineLayout, nullptr);
+    vkDestroyPipeline(m_backend->logicalDevice, pyramidPipeline, nullptr);
+    vkDestroyPipelineLayout(m_backend->logicalDevice, pyramidPipelineLayout, nullptr);
+
+    vkDestroyDescriptorPool(m_backend->logicalDevice, descriptorPool, nullptr); //frees the sets with it
+    vkDestroyDescriptorSetLayout(m_backend->logicalDevice, cullDescriptorSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_backend->logicalDevice, pyramidDescriptorSetLayout, nullptr);
+
+    for(uint32_t i = 0; i < m_frameCount; i++)
+    {
+        m_backend->allocator->destroyBuffer(&cullDataBuffers[i], &cullDataBufferAllocations[i]);
+        m_backend->allocator->destroyBuffer(&statsBuffers[i], &statsBufferAllocations[i]);
+    }
+
+    vkDestroySampler(m_backend->logicalDevice, pyramidSampler, nullptr);
+    for(auto levelView : pyramidLevelViews)
+    {
+        vkDestroyImageView(m_backend->logicalDevice, levelView, nullptr);
+    }
+    vkDestroyImageView(m_backend->logicalDevice, pyramidView, nullptr);
+    vkDestroyImage(m_backend->logicalDevice, pyramidImage, nullptr);
+    m_backend->allocator->free(pyramidImageAllocation);
+}
+
+void PixelCullingPipeline::createPyramid() {
+
+    //level 0 is the depth buffer rounded down to a power of two so each level halves exactly
+    uint32_t depthWidth = m_depthImage->getWidth();
+    uint32_t depthHeight = m_depthImage->getHeight();
+    pyramidExtent.width = 1;
+    while(pyramidExtent.width * 2 <= depthWidth)
+    {
+        pyramidExtent.width *= 2;
+    }
+    pyramidExtent.height = 1;
+    while(pyramidExtent.height * 2 <= depthHeight)
+    {
+        pyramidExtent.height *= 2;
+    }
+
+    pyramidLevelCount = 1;
+    while((std::max(pyramidExtent.width, pyramidExtent.height) >> pyramidLevelCount) > 0)
+    {
+        pyramidLevelCount++;
+    }
+
+    VkImageCreateInfo imageCreateInfo{};
+    imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.extent.width = pyramidExtent.width;
+    imageCreateInfo.extent.height = pyramidExtent.height;
+    imageCreateInfo.extent.depth = 1;
+    imageCreateInfo.mipLevels = pyramidLevelCount;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageCreateInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkResult result = vkCreateImage(m_backend->logicalDevice, &imageCreateInfo, nullptr, &pyramidImage);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create the depth pyramid image");
+    }
+    m_backend->allocator->bindImage(pyramidImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, &pyramidImageAllocation);
+
+    VkImageViewCreateInfo viewCreateInfo{};
+    viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewCreateInfo.image = pyramidImage;
+    viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewCreateInfo.format = VK_FORMAT_R32_SFLOAT;
+    viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewCreateInfo.subresourceRange.baseMipLevel = 0;
+    viewCreateInfo.subresourceRange.levelCount = pyramidLevelCount;
+    viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+    viewCreateInfo.subresourceRange.layerCount = 1;
+
+    result = vkCreateImageView(m_backend->logicalDevice, &viewCreateInfo, nullptr, &pyramidView);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create the depth pyramid image view");
+    }
+
+    pyramidLevelViews.resize(pyramidLevelCount);
+    for(uint32_t level = 0; level < pyramidLevelCount; level++)
+    {
+        viewCreateInfo.subresourceRange.baseMipLevel = level;
+        viewCreateInfo.subresourceRange.levelCount = 1;
+        result = vkCreateImageView(m_backend->logicalDevice, &viewCreateInfo, nullptr, &pyramidLevelViews[level]);
+        if(result != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create a depth pyramid level view");
+        }
+    }
+
+    //nearest so a sample returns the exact farthest depth of a texel
+    VkSamplerCreateInfo samplerCreateInfo{};
+    samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+    samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerCreateInfo.minLod = 0.0f;
+    samplerCreateInfo.maxLod = static_cast<float>(pyramidLevelCount);
+    samplerCreateInfo.anisotropyEnable = VK_FALSE;
+
+    result = vkCreateSampler(m_backend->logicalDevice, &samplerCreateInfo, nullptr, &pyramidSampler);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create the depth pyramid sampler");
+    }
+}
+
+void PixelCullingPipeline::createDescriptorSetLayouts() {
+
+    //culling pass: object table, candidates, commands, counts, stats, depth pyramid, cull data
+    std::array<VkDescriptorSetLayoutBinding, 7> cullBindings{};
+    for(uint32_t i = 0; i < cullBindings.size(); i++)
+    {
+        cullBindings[i].binding = i;
+        cullBindings[i].descriptorCount = 1;
+        cullBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        cullBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        cullBindings[i].pImmutableSamplers = nullptr;
+    }
+    cullBindings[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    cullBindings[6].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(cullBindings.size());
+    layoutInfo.pBindings = cullBindings.data();
+
+    if (vkCreateDescriptorSetLayout(m_backend->logicalDevice, &layoutInfo, nullptr, &cullDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create culling descriptor set layout!");
+    }
+
+    //pyramid reduction: the level above (or the depth buffer) and the level written
+    std::array<VkDescriptorSetLayoutBinding, 2> pyramidBindings{};
+    pyramidBindings[0].binding = 0;
+    pyramidBindings[0].descriptorCount = 1;
+    pyramidBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pyramidBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    pyramidBindings[1].binding = 1;
+    pyramidBindings[1].descriptorCount = 1;
+    pyramidBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    pyramidBindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    layoutInfo.bindingCount = static_cast<uint32_t>(pyramidBindings.size());
+    layoutInfo.pBindings = pyramidBindings.data();
+
+    if (vkCreateDescriptorSetLayout(m_backend->logicalDevice, &layoutInfo, nullptr, &pyramidDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid descriptor set layout!");
+    }
+}
+
+void PixelCullingPipeline::createDescriptorPool() {
+
+    VkDescriptorPoolSize storageBufferPoolSize{};
+    storageBufferPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    storageBufferPoolSize.descriptorCount = 5 * m_frameCount;
+
+    VkDescriptorPoolSize uniformPoolSize{};
+    uniformPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uniformPoolSize.descriptorCount = m_frameCount;
+
+    VkDescriptorPoolSize samplerPoolSize{};
+    samplerPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    samplerPoolSize.descriptorCount = m_frameCount + pyramidLevelCount;
+
+    VkDescriptorPoolSize storageImagePoolSize{};
+    storageImagePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    storageImagePoolSize.descriptorCount = pyramidLevelCount;
+
+    std::array<VkDescriptorPoolSize, 4> poolSizes = {storageBufferPoolSize, uniformPoolSize, samplerPoolSize, storageImagePoolSize};
+
+    VkDescriptorPoolCreateInfo poolCreateInfo{};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolCreateInfo.maxSets = m_frameCount + pyramidLevelCount;
+    poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolCreateInfo.pPoolSizes = poolSizes.data();
+
+    VkResult result = vkCreateDescriptorPool(m_backend->logicalDevice, &poolCreateInfo, nullptr, &descriptorPool);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create descriptor pool for the culling pipeline");
+    }
+}
+
+void PixelCullingPipeline::createDescriptorSets() {
+
+    std::vector<VkDescriptorSetLayout> cullSetLayouts(m_frameCount, cullDescriptorSetLayout);
+    cullDescriptorSets.resize(m_frameCount);
+
+    VkDescriptorSetAllocateInfo setAllocateInfo{};
+    setAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setAllocateInfo.descriptorPool = descriptorPool;
+    setAllocateInfo.descriptorSetCount = m_frameCount;
+    setAllocateInfo.pSetLayouts = cullSetLayouts.data();
+
+    VkResult result = vkAllocateDescriptorSets(m_backend->logicalDevice, &setAllocateInfo, cullDescriptorSets.data());
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate culling descriptor sets");
+    }
+
+    std::vector<VkDescriptorSetLayout> pyramidSetLayouts(pyramidLevelCount, pyramidDescriptorSetLayout);
+    pyramidDescriptorSets.resize(pyramidLevelCount);
+
+    setAllocateInfo.descriptorSetCount = pyramidLevelCount;
+    setAllocateInfo.pSetLayouts = pyramidSetLayouts.data();
+
+    result = vkAllocateDescriptorSets(m_backend->logicalDevice, &setAllocateInfo, pyramidDescriptorSets.data());
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate depth pyramid descriptor sets");
+    }
+
+    //the parts of the culling sets that never change
+    for(uint32_t i = 0; i < m_frameCount; i++)
+    {
+        VkDescriptorBufferInfo statsBufferInfo{statsBuffers[i], 0, sizeof(CullStats)};
+        VkDescriptorImageInfo pyramidImageInfo{pyramidSampler, pyramidView, VK_IMAGE_LAYOUT_GENERAL};
+        VkDescriptorBufferInfo cullDataBufferInfo{cullDataBuffers[i], 0, sizeof(CullData)};
+
+        std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+        for(auto& descriptorWrite : descriptorWrites)
+        {
+            descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrite.dstSet = cullDescriptorSets[i];
+            descriptorWrite.descriptorCount = 1;
+        }
+
+        descriptorWrites[0].dstBinding = 4;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[0].pBufferInfo = &statsBufferInfo;
+
+        descriptorWrites[1].dstBinding = 5;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[1].pImageInfo = &pyramidImageInfo;
+
+        descriptorWrites[2].dstBinding = 6;
+        descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrites[2].pBufferInfo = &cullDataBufferInfo;
+
+        vkUpdateDescriptorSets(m_backend->logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+
+    //level 0 reads the depth buffer, every other level reads the one above it
+    for(uint32_t level = 0; level < pyramidLevelCount; level++)
+    {
+        VkDescriptorImageInfo inputImageInfo{};
+        inputImageInfo.sampler = pyramidSampler;
+        inputImageInfo.imageView = level == 0 ? m_depthImage->getImageView() : pyramidLevelViews[level - 1];
+        inputImageInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+        VkDescriptorImageInfo outputImageInfo{};
+        outputImageInfo.imageView = pyramidLevelViews[level];
+        outputImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = pyramidDescriptorSets[level];
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pImageInfo = &inputImageInfo;
+
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = pyramidDescriptorSets[level];
+        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pImageInfo = &outputImageInfo;
+
+        vkUpdateDescriptorSets(m_backend->logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+void PixelCullingPipeline::createPipelines() {
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &cullDescriptorSetLayout;
+
+    if (vkCreatePipelineLayout(m_backend->logicalDevice, &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create culling pipeline layout!");
+    }
+
+    pipelineLayoutInfo.pSetLayouts = &pyramidDescriptorSetLayout;
+
+    if (vkCreatePipelineLayout(m_backend->logicalDevice, &pipelineLayoutInfo, nullptr, &pyramidPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid pipeline layout!");
+    }
+
+    VkPipelineShaderStageCreateInfo shaderStageInfo{};
+    shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    shaderStageInfo.pName = "main"; //the entry point of the shader
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+
+    shaderStageInfo.module = addShaderModule(m_backend->logicalDevice, "shaders/cull.spv");
+    pipelineInfo.layout = cullPipelineLayout;
+    pipelineInfo.stage = shaderStageInfo;
+
+    VkResult result = vkCreateComputePipelines(m_backend->logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &cullPipeline);
+    vkDestroyShaderModule(m_backend->logicalDevice, shaderStageInfo.module, nullptr);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create the culling pipeline");
+    }
+
+    shaderStageInfo.module = addShaderModule(m_backend->logicalDevice, "shaders/depthPyramid.spv");
+    pipelineInfo.layout = pyramidPipelineLayout;
+    pipelineInfo.stage = shaderStageInfo;
+
+    result = vkCreateComputePipelines(m_backend->logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pyramidPipeline);
+    vkDestroyShaderModule(m_backend->logicalDevice, shaderStageInfo.module, nullptr);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create the depth pyramid pipeline");
+    }
+}
+
+glm::mat4 PixelCullingPipeline::getCullProjection(const glm::mat4& P) {
+
+    //same flip as the scene's uniform buffer, the depth buffer and the pyramid have their first row at the top
+    glm::mat4 cullProjection = P;
+    cullProjection[1][1] *= -1;
+    return cullProjection;
+}
+
+void PixelCullingPipeline::getOcclusionRect(const glm::mat4& cullProjection, glm::vec3 center, float radius, glm::vec2& minUV, glm::vec2& maxUV) {
+
+    minUV = glm::vec2(1.0f);
+    maxUV = glm::vec2(0.0f);
+    for(int i = 0; i < 8; i++)
+    {
+        glm::vec3 corner = center + radius * glm::vec3((i & 1) != 0 ? 1.0f : -1.0f, (i & 2) != 0 ? 1.0f : -1.0f, (i & 4) != 0 ? 1.0f : -1.0f);
+        glm::vec4 clip = cullProjection * glm::vec4(corner, 1.0f);
+        glm::vec2 uv = glm::vec2(clip) / clip.w * 0.5f + 0.5f;
+        minUV = glm::min(minUV, uv);
+        maxUV = glm::max(maxUV, uv);
+    }
+    minUV = glm::clamp(minUV, 0.0f, 1.0f);
+    maxUV = glm::clamp(maxUV, 0.0f, 1.0f);
+}
+
+void PixelCullingPipeline::collectStats(uint32_t frameIndex) {
+    memcpy(&m_stats, statsBufferAllocations[frameIndex].mappedData, sizeof(CullStats));
+}
+
+void PixelCullingPipeline::update(uint32_t frameIndex, PixelScene* scene, bool compactDraws) {
+
+    writeCullDescriptorSet(frameIndex, scene);
+
+    PixelScene::UboVP sceneVP = scene->getSceneVP();
+
+    CullData cullData{};
+    cullData.V = sceneVP.V;
+    cullData.P = getCullProjection(sceneVP.P);
+
+    //frustum planes from the rows of the view projection (depth from 0 to 1)
+    glm::mat4 VP = glm::transpose(cullData.P * sceneVP.V);
+    cullData.frustumPlanes[0] = VP[3] + VP[0]; //left
+    cullData.frustumPlanes[1] = VP[3] - VP[0]; //right
+    cullData.frustumPlanes[2] = VP[3] + VP[1]; //top or bottom, depends on the y direction of P
+    cullData.frustumPlanes[3] = VP[3] - VP[1];
+    cullData.frustumPlanes[4] = VP[2];         //near
+    cullData.frustumPlanes[5] = VP[3] - VP[2]; //far
+    for(auto& plane : cullData.frustumPlanes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    cullData.pyramidSize = glm::vec4(pyramidExtent.width, pyramidExtent.height, pyramidLevelCount, 0.0f);
+    cullData.candidateCount = scene->getDrawCandidateCount();
+    cullData.compactDraws = compactDraws ? 1 : 0;
+    cullData.occlusionEnabled = (m_occlusionEnabled && pyramidValid) ? 1 : 0;
+
+    memcpy(cullDataBufferAllocations[frameIndex].mappedData, &cullData, sizeof(CullData));
+}
+
+void PixelCullingPipeline::writeCullDescriptorSet(uint32_t frameIndex, PixelScene* scene) {
+
+    CullBindings bindings{};
+    bindings.objectBuffer = *scene->getObjectBuffers(static_cast<int>(frameIndex));
+    bindings.candidateBuffer = *scene->getDrawCandidateBuffers(static_cast<int>(frameIndex));
+    bindings.indirectBuffer = *scene->getIndirectBuffers(static_cast<int>(frameIndex));
+    bindings.countBuffer = *scene->getDrawCountBuffers(static_cast<int>(frameIndex));
+
+    CullBindings& written = writtenCullBindings[frameIndex];
+    if(written.objectBuffer == bindings.objectBuffer && written.candidateBuffer == bindings.candidateBuffer &&
+       written.indirectBuffer == bindings.indirectBuffer && written.countBuffer == bindings.countBuffer)
+    {
+        return;
+    }
+
+    //the frame's fence was waited on, nothing in flight uses this set
+    std::array<VkDescriptorBufferInfo, 4> bufferInfos{};
+    bufferInfos[0] = {bindings.objectBuffer, 0, VK_WHOLE_SIZE};
+    bufferInfos[1] = {bindings.candidateBuffer, 0, VK_WHOLE_SIZE};
+    bufferInfos[2] = {bindings.indirectBuffer, 0, VK_WHOLE_SIZE};
+    bufferInfos[3] = {bindings.countBuffer, 0, VK_WHOLE_SIZE};
+
+    std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+    for(uint32_t i = 0; i < descriptorWrites.size(); i++)
+    {
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].dstSet = cullDescriptorSets[frameIndex];
+        descriptorWrites[i].dstBinding = i;
+        descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+    }
+
+    vkUpdateDescriptorSets(m_backend->logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    written = bindings;
+}
+
+void PixelCullingPipeline::recordCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex, PixelScene* scene) {
+
+    //the pyramid is bound even when occlusion is off, give it a valid layout once
+    if(!pyramidInitialized)
+    {
+        VkImageMemoryBarrier pyramidBarrier{};
+        pyramidBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        pyramidBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        pyramidBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        pyramidBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        pyramidBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        pyramidBarrier.image = pyramidImage;
+        pyramidBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramidLevelCount, 0, 1};
+        pyramidBarrier.srcAccessMask = 0;
+        pyramidBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &pyramidBarrier);
+        pyramidInitialized = true;
+    }
+
+    //reset the counts and the counters. the previous draws reading these buffers must be done first
+    VkMemoryBarrier clearBarrier{};
+    clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clearBarrier.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    clearBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+    vkCmdFillBuffer(commandBuffer, *scene->getDrawCountBuffers(static_cast<int>(frameIndex)), 0, VK_WHOLE_SIZE, 0);
+    vkCmdFillBuffer(commandBuffer, statsBuffers[frameIndex], 0, VK_WHOLE_SIZE, 0);
+
+    VkMemoryBarrier cullBarrier{};
+    cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cullBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    cullBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+
+    uint32_t candidateCount = scene->getDrawCandidateCount();
+    if(candidateCount > 0)
+    {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1,
+                                &cullDescriptorSets[frameIndex], 0, nullptr);
+        vkCmdDispatch(commandBuffer, (candidateCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    }
+
+    //the draws read the commands and counts written by the pass
+    VkMemoryBarrier drawBarrier{};
+    drawBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    drawBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                         0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+}
+
+void PixelCullingPipeline::recordDepthPyramid(VkCommandBuffer commandBuffer) {
+
+    VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if(m_depthImage->getFormat() == VK_FORMAT_D32_SFLOAT_S8_UINT || m_depthImage->getFormat() == VK_FORMAT_D24_UNORM_S8_UINT)
+    {
+        depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+
+    //depth writes done -> sampled by the first reduction
+    VkImageMemoryBarrier depthBarrier{};
+    depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    depthBarrier.image = m_depthImage->getImage();
+    depthBarrier.subresourceRange = {depthAspect, 0, 1, 0, 1};
+    depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    //this frame's culling pass read the pyramid we are about to overwrite
+    VkMemoryBarrier pyramidBarrier{};
+    pyramidBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    pyramidBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    pyramidBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &pyramidBarrier, 0, nullptr, 1, &depthBarrier);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramidPipeline);
+
+    //each level keeps the farthest depth of its footprint in the level above
+    for(uint32_t level = 0; level < pyramidLevelCount; level++)
+    {
+        uint32_t levelWidth = std::max(pyramidExtent.width >> level, 1u);
+        uint32_t levelHeight = std::max(pyramidExtent.height >> level, 1u);
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramidPipelineLayout, 0, 1,
+                                &pyramidDescriptorSets[level], 0, nullptr);
+        vkCmdDispatch(commandBuffer, (levelWidth + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+                      (levelHeight + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+
+        VkMemoryBarrier levelBarrier{};
+        levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    //the next renderpass clears and writes the depth buffer again
+    depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+
+    pyramidValid = true;
+}
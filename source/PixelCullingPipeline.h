@@ -0,0 +1,120 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#ifndef PIXELENGINE_PIXELCULLINGPIPELINE_H
+#define PIXELENGINE_PIXELCULLINGPIPELINE_H
+
+#include "PixelImage.h"
+#include "PixelScene.h"
+#include "glm/glm.hpp"
+
+//gpu driven visibility. a compute pass tests every draw candidate of a scene against the camera frustum and against
+//a hierarchical depth pyramid built from the previous frame's depth buffer, and writes the survivors in the scene's
+//indirect buffer. the pyramid is rebuilt at the end of every frame.
+class PixelCullingPipeline {
+public:
+    PixelCullingPipeline() = default;
+
+    //written by the culling pass, layout must match CullStats in cull.comp
+    struct CullStats{
+        uint32_t tested = 0;
+        uint32_t frustumCulled = 0;
+        uint32_t occlusionCulled = 0;
+        uint32_t drawn = 0;
+    };
+
+    //per frame uniform of the culling pass, layout must match CullData in cull.comp (std140)
+    struct CullData{
+        glm::mat4 V;
+        glm::mat4 P;
+        glm::vec4 frustumPlanes[6]; //world space, xyz normal pointing inside, w distance
+        glm::vec4 pyramidSize; //width, height, mip count
+        uint32_t candidateCount;
+        uint32_t compactDraws; //1: survivors are packed and counted, 0: culled draws keep their slot with no instance
+        uint32_t occlusionEnabled;
+        uint32_t padding;
+    };
+
+    void init(PixBackend* backend, PixelImage* depthImage, uint32_t frameCount);
+    void cleanUp();
+
+    //read back the counters of the last frame that used this index. its fence must have been waited on
+    void collectStats(uint32_t frameIndex);
+    //camera and buffers of the scene to cull this frame
+    void update(uint32_t frameIndex, PixelScene* scene, bool compactDraws);
+
+    //record before the renderpass that consumes the indirect buffer
+    void recordCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex, PixelScene* scene);
+    //record after the last renderpass writing the depth buffer
+    void recordDepthPyramid(VkCommandBuffer commandBuffer);
+
+    //getters
+    CullStats getStats(){return m_stats;}
+    bool isOcclusionEnabled(){return m_occlusionEnabled;}
+
+    //setters
+    void setOcclusionEnabled(bool enabled){m_occlusionEnabled = enabled;}
+
+    //the scene's projection with the y flip its uniform is rendered with, so the depth pyramid rows match cull.comp's uv
+    static glm::mat4 getCullProjection(const glm::mat4& P);
+    //pyramid uv rectangle of a view space sphere, the same way isOccluded() in cull.comp computes it
+    static void getOcclusionRect(const glm::mat4& cullProjection, glm::vec3 center, float radius, glm::vec2& minUV, glm::vec2& maxUV);
+
+private:
+
+    void createPyramid();
+    void createDescriptorSetLayouts();
+    void createDescriptorPool();
+    void createDescriptorSets();
+    void createPipelines();
+    void writeCullDescriptorSet(uint32_t frameIndex, PixelScene* scene);
+
+    PixBackend* m_backend{};
+    PixelImage* m_depthImage{};
+    uint32_t m_frameCount = 0;
+
+    //culling pass
+    VkDescriptorSetLayout cullDescriptorSetLayout{};
+    VkPipelineLayout cullPipelineLayout{};
+    VkPipeline cullPipeline{};
+    std::vector<VkDescriptorSet> cullDescriptorSets;
+    std::vector<VkBuffer> cullDataBuffers;
+    std::vector<PixAllocation> cullDataBufferAllocations;
+    std::vector<VkBuffer> statsBuffers;
+    std::vector<PixAllocation> statsBufferAllocations;
+
+    //what each culling descriptor set points to, rewritten when the scene's buffers change (the object table grows)
+    struct CullBindings
+    {
+        VkBuffer objectBuffer = VK_NULL_HANDLE;
+        VkBuffer candidateBuffer = VK_NULL_HANDLE;
+        VkBuffer indirectBuffer = VK_NULL_HANDLE;
+        VkBuffer countBuffer = VK_NULL_HANDLE;
+    };
+    std::vector<CullBindings> writtenCullBindings;
+
+    //depth pyramid, every level keeps the farthest depth of the texels it covers
+    VkImage pyramidImage{};
+    PixAllocation pyramidImageAllocation{};
+    VkImageView pyramidView{}; //every level, sampled by the culling pass
+    std::vector<VkImageView> pyramidLevelViews; //one level each, written by the reduction
+    VkSampler pyramidSampler{};
+    VkExtent2D pyramidExtent{};
+    uint32_t pyramidLevelCount = 0;
+    bool pyramidInitialized = false; //layout moved to general
+    bool pyramidValid = false; //holds a depth buffer
+
+    VkDescriptorSetLayout pyramidDescriptorSetLayout{};
+    VkPipelineLayout pyramidPipelineLayout{};
+    VkPipeline pyramidPipeline{};
+    std::vector<VkDescriptorSet> pyramidDescriptorSets; //one per level
+
+    VkDescriptorPool descriptorPool{};
+
+    bool m_occlusionEnabled = true;
+    CullStats m_stats{};
+};
+
+
+#endif //PIXELENGINE_PIXELCULLINGPIPELINE_H
@@ -6,6 +6,28 @@
 
 #include <array>
 
+//format and offset of every attribute, per vertex format. the packed formats are converted to floats by the input
+//assembly, the vertex shader finishes the dequantization (bounds, octahedral normal)
+struct VertexAttributeLayout
+{
+    VkFormat format;
+    uint32_t offset;
+};
+static const VertexAttributeLayout vertexAttributeLayouts[PixelObject::VERTEX_FORMAT_COUNT][PixelObject::ATTRIBUTECOUNT] = {
+        { //VERTEX_FORMAT_FULL
+                {VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(PixelObject::Vertex, position))},
+                {VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(PixelObject::Vertex, normal))},
+                {VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(PixelObject::Vertex, color))},
+                {VK_FORMAT_R32G32_SFLOAT, static_cast<uint32_t>(offsetof(PixelObject::Vertex, texUV))}
+        },
+        { //VERTEX_FORMAT_PACKED
+                {VK_FORMAT_R16G16B16A16_SNORM, static_cast<uint32_t>(offsetof(PixelObject::PackedVertex, position))},
+                {VK_FORMAT_R16G16_SNORM, static_cast<uint32_t>(offsetof(PixelObject::PackedVertex, normal))},
+                {VK_FORMAT_R8G8B8A8_UNORM, static_cast<uint32_t>(offsetof(PixelObject::PackedVertex, color))},
+                {VK_FORMAT_R16G16_SFLOAT, static_cast<uint32_t>(offsetof(PixelObject::PackedVertex, texUV))}
+        }
+};
+
 void PixelGraphicsPipeline::addVertexShader(const std::string &filename) {
     vertexShaderModule = addShaderModule(m_device, filename);
 }
@@ -152,7 +174,7 @@ VkRenderPass PixelGraphicsPipeline::getRenderPass() {
     return renderPass;
 }
 
-void PixelGraphicsPipeline::populateGraphicsPipelineInfo() {
+void PixelGraphicsPipeline::populateGraphicsPipelineInfo(PixelObject::VertexFormat vertexFormat) {
     //Vertex-Stage creation
     vertexCreateShaderInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertexCreateShaderInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -169,32 +191,20 @@ void PixelGraphicsPipeline::populateGraphicsPipelineInfo() {
     //How data for a single vertex is laid out
 
     inputBindingDescription.binding = 0;
-    inputBindingDescription.stride = sizeof(PixelObject::Vertex);
+    inputBindingDescription.stride = static_cast<uint32_t>(PixelObject::getVertexStride(vertexFormat));
     inputBindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX; //how to move between data after each vertex
                                                                      //VK_VERTEX_INPUT_RATE_VERTEX : Move on to the next vertex
                                                                      //VK_VERTEX_INPUT_RATE_INSTANCE : Move on to the next instance
 
     //How the data within a vertex is descripted
     //fills in each Vertex Input Attribute Description struct for each attributes in the Vertex Object (position, color etc...)
-    inputAttributeDescription[PixelObject::POSITION_ATTRIBUTEINDEX].binding = 0; //matches the layout(binding = 0)
-    inputAttributeDescription[PixelObject::POSITION_ATTRIBUTEINDEX].location = static_cast<uint32_t>(PixelObject::POSITION_ATTRIBUTEINDEX); //matches the layout(location = 0)
-    inputAttributeDescription[PixelObject::POSITION_ATTRIBUTEINDEX].format = VK_FORMAT_R32G32B32A32_SFLOAT; //the format of the attribute (vec3)
-    inputAttributeDescription[PixelObject::POSITION_ATTRIBUTEINDEX].offset = static_cast<uint32_t>(offsetof(PixelObject::Vertex, position)); //each vec4 has 16 bytes. so the offset into the struct shifts by 16 bytes per vec4
-
-    inputAttributeDescription[PixelObject::NORMAL_ATTRIBUTEINDEX].binding = 0; //matches the layout(binding = 0)
-    inputAttributeDescription[PixelObject::NORMAL_ATTRIBUTEINDEX].location = static_cast<uint32_t>(PixelObject::NORMAL_ATTRIBUTEINDEX); //matches the layout(location = 0)
-    inputAttributeDescription[PixelObject::NORMAL_ATTRIBUTEINDEX].format = VK_FORMAT_R32G32B32A32_SFLOAT; //the format of the attribute (vec3)
-    inputAttributeDescription[PixelObject::NORMAL_ATTRIBUTEINDEX].offset = static_cast<uint32_t>(offsetof(PixelObject::Vertex, normal)); //each vec4 has 16 bytes. so the offset into the struct shifts by 16 bytes per vec4
-
-    inputAttributeDescription[PixelObject::COLOR_ATTRIBUTEINDEX].binding = 0; //matches the layout(binding = 0)
-    inputAttributeDescription[PixelObject::COLOR_ATTRIBUTEINDEX].location = static_cast<uint32_t>(PixelObject::COLOR_ATTRIBUTEINDEX); //matches the layout(location = 0)
-    inputAttributeDescription[PixelObject::COLOR_ATTRIBUTEINDEX].format = VK_FORMAT_R32G32B32A32_SFLOAT; //the format of the attribute (vec3)
-    inputAttributeDescription[PixelObject::COLOR_ATTRIBUTEINDEX].offset = static_cast<uint32_t>(offsetof(PixelObject::Vertex, color)); //each vec4 has 16 bytes. so the offset into the struct shifts by 16 bytes per vec4
-
-    inputAttributeDescription[PixelObject::TEXUV_ATTRIBUTEINDEX].binding = 0; //matches the layout(binding = 0)
-    inputAttributeDescription[PixelObject::TEXUV_ATTRIBUTEINDEX].location = static_cast<uint32_t>(PixelObject::TEXUV_ATTRIBUTEINDEX); //matches the layout(location = 0)
-    inputAttributeDescription[PixelObject::TEXUV_ATTRIBUTEINDEX].format = VK_FORMAT_R32G32_SFLOAT; //the format of the attribute (vec3)
-    inputAttributeDescription[PixelObject::TEXUV_ATTRIBUTEINDEX].offset = static_cast<uint32_t>(offsetof(PixelObject::Vertex, texUV)); //each vec4 has 16 bytes. so the offset into the struct shifts by 16 bytes per vec4
+    for(uint32_t attribute = 0; attribute < PixelObject::ATTRIBUTECOUNT; attribute++)
+    {
+        inputAttributeDescription[attribute].binding = 0; //matches the layout(binding = 0)
+        inputAttributeDescription[attribute].location = attribute; //matches the layout(location = x)
+        inputAttributeDescription[attribute].format = vertexAttributeLayouts[vertexFormat][attribute].format;
+        inputAttributeDescription[attribute].offset = vertexAttributeLayouts[vertexFormat][attribute].offset;
+    }
 
     vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     vertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
@@ -331,7 +341,7 @@ void PixelGraphicsPipeline::addRenderpassDepthAttachment(VkFormat depthImageForm
     renderPassDepthAttachment.attachmentDescription.format = depthImageFormat;
     renderPassDepthAttachment.attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
     renderPassDepthAttachment.attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; //this clears the buffer when we start the renderpass
-    renderPassDepthAttachment.attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; //we want to present the result so we keep it
+    renderPassDepthAttachment.attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE; //kept for the depth pyramid of the culling pass
     renderPassDepthAttachment.attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     renderPassDepthAttachment.attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     renderPassDepthAttachment.attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; //renderpass (before the subpasses) layout, default = VK_IMAGE_LAYOUT_UNDEFINED
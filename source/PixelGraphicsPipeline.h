@@ -15,7 +15,7 @@ public:
     //PixelGraphicsPipeline(const PixelGraphicsPipeline&) = delete;
     void addVertexShader(const std::string& filename);
     void addFragmentShader(const std::string& filename);
-    void populateGraphicsPipelineInfo();
+    void populateGraphicsPipelineInfo(PixelObject::VertexFormat vertexFormat = PixelObject::VERTEX_FORMAT_FULL);
     void populatePipelineLayout(PixelScene* scene);
     void createGraphicsPipeline(const VkRenderPass& inputRenderPass);
     void addRenderpassColorAttachment(VkFormat imageFormat, VkImageLayout initialLayout, VkImageLayout finalLayout, VkAttachmentStoreOp attachmentStoreOp, VkImageLayout attachmentReferenceLayout);
@@ -3,6 +3,8 @@
 //
 
 #include "PixelImage.h"
+#include "PixelImageDecoder.h"
+#include "PixelUploadBatcher.h"
 
 PixelImage::PixelImage(PixBackend* device, uint32_t width, uint32_t height, bool isSwapChainImage) : m_device(device), m_width(width), m_height(height), m_IsSwapChainImage(isSwapChainImage) {
     if (m_device == VK_NULL_HANDLE)
@@ -23,7 +25,7 @@ void PixelImage::cleanUp()
     if(!m_IsSwapChainImage)
     {
         vkDestroyImage(m_device->logicalDevice, m_image, nullptr); //if swapchain image. it will be destroyed by the swapchain (just like it was created by the swapchain)
-        vkFreeMemory(m_device->logicalDevice, m_imageMemory, nullptr);
+        m_device->allocator->free(m_imageAllocation);
     }
 
     m_ressourcesCleaned = true;
@@ -48,7 +50,7 @@ void PixelImage::createImageView(VkFormat format, VkImageAspectFlags aspectFlags
     //Subresource allow the view to view only a part of an image
     imageViewCreateInfo.subresourceRange.aspectMask = aspectFlags; //which aspect of image to use (color bit for viewing color)
     imageViewCreateInfo.subresourceRange.baseMipLevel = 0; //start mip map level to view from
-    imageViewCreateInfo.subresourceRange.levelCount = 1; //levels of mip map to view
+    imageViewCreateInfo.subresourceRange.levelCount = m_mipLevels; //levels of mip map to view
     imageViewCreateInfo.subresourceRange.baseArrayLayer = 0; //start array level to view from
     imageViewCreateInfo.subresourceRange.layerCount = 1; //layers to view
 
@@ -83,8 +85,9 @@ void PixelImage::createDepthBufferImage()
     m_format = chooseSupportedFormat(m_device->physicalDevice,
                                      {VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D32_SFLOAT, VK_FORMAT_D24_UNORM_S8_UINT}, //depth buffer at 32bit and stencil buffer at 8bit ideally
                                      VK_IMAGE_TILING_OPTIMAL,
-                                      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
-    createImage(VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                                      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+    //sampled by the depth pyramid reduction of the culling pass
+    createImage(VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
     createImageView(m_format, VK_IMAGE_ASPECT_DEPTH_BIT);
 }
 
@@ -96,7 +99,7 @@ void PixelImage::createImage(VkImageTiling imageTiling, VkImageUsageFlags useFla
     imageCreateInfo.extent.width = m_width;
     imageCreateInfo.extent.height = m_height;
     imageCreateInfo.extent.depth = 1; //no 3D aspect
-    imageCreateInfo.mipLevels = 1; //TODO: implement mipmap
+    imageCreateInfo.mipLevels = m_mipLevels;
     imageCreateInfo.arrayLayers = 1;
     imageCreateInfo.format = m_format;
     imageCreateInfo.tiling = imageTiling;
@@ -111,55 +114,193 @@ void PixelImage::createImage(VkImageTiling imageTiling, VkImageUsageFlags useFla
         throw std::runtime_error("failed to create image");
     }
 
-    VkMemoryRequirements imageMemoryRequirements;
-    vkGetImageMemoryRequirements(m_device->logicalDevice, m_image, &imageMemoryRequirements);
+    //sub-allocate the image memory and connect image to memory
+    m_device->allocator->bindImage(m_image, propFlags, imageTiling == VK_IMAGE_TILING_LINEAR, &m_imageAllocation);
+}
 
-    VkMemoryAllocateInfo memoryAllocateInfo{};
-    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memoryAllocateInfo.allocationSize = imageMemoryRequirements.size;
-    memoryAllocateInfo.memoryTypeIndex = findMemoryTypeIndex(m_device->physicalDevice,
-                                                             imageMemoryRequirements.memoryTypeBits,
-                                                             propFlags);
+uint32_t PixelImage::fullMipLevelCount(uint32_t width, uint32_t height) {
 
-    result = vkAllocateMemory(m_device->logicalDevice, &memoryAllocateInfo, nullptr, &m_imageMemory);
-    if(result != VK_SUCCESS)
+    uint32_t levels = 1;
+    for(uint32_t size = std::max(width, height); size > 1; size >>= 1)
     {
-        throw std::runtime_error("failed to allocate memory for image");
+        levels++;
     }
+    return levels;
+}
+
+bool PixelImage::supportsBlitMipGeneration() {
 
-    //connect image to memory
-    vkBindImageMemory(m_device->logicalDevice, m_image, m_imageMemory, 0);
+    //software implementations may not filter (or blit) the format
+    VkFormatProperties formatProperties{};
+    vkGetPhysicalDeviceFormatProperties(m_device->physicalDevice, m_format, &formatProperties);
+
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (formatProperties.optimalTilingFeatures & required) == required;
 }
 
 VkFormat PixelImage::getFormat() {
     return m_format;
 }
 
-void PixelImage::loadTexture(std::string filename) {
-
-    int channels, width, height;
+void PixelImage::loadTexture(std::string filename, PixelUploadBatcher* uploadBatcher) {
 
     std::string fileLocation = "Textures/" + filename;
-    stbi_uc* image = stbi_load(fileLocation.c_str(), &width, &height, &channels, STBI_rgb_alpha);
 
-    m_width = (int)width;
-    m_height = (int) height;
+    //block compressed containers are used as they are
+    if(PixelTextureCompressor::isContainerFile(fileLocation))
+    {
+        PixelTextureCompressor::TextureData texture{};
+        if(!PixelTextureCompressor::loadContainer(fileLocation, texture))
+        {
+            throw std::runtime_error("Failed to load texture file: " + fileLocation);
+        }
+        if(PixelTextureCompressor::getBlockSize(texture.format) != 0 && !m_device->textureCompressionBC)
+        {
+            stbi_image_free(texture.data);
+            throw std::runtime_error("The device cannot sample the block compressed texture: " + fileLocation);
+        }
+        createFromTextureData(texture);
+        stageImageData(uploadBatcher);
+        return;
+    }
+
+    //the encoded copy next to the file skips the decode. it is written the first time the file is loaded
+    if(m_device->textureCompressionBC)
+    {
+        PixelTextureCompressor::TextureData texture{};
+        if(!PixelTextureCompressor::loadCompressedFile(fileLocation, texture))
+        {
+            throw std::runtime_error("Failed to load texture file: " + fileLocation);
+        }
+        createFromTextureData(texture);
+        stageImageData(uploadBatcher);
+        return;
+    }
+
+    std::vector<stbi_uc> file;
+    uint32_t width, height, channels;
+    stbi_uc* image = PixelImageDecoder::readFile(fileLocation, file) ? PixelImageDecoder::decodeNative(file, width, height, channels) : nullptr;
 
     if(!image)
     {
         throw std::runtime_error("Failed to load texture file: " + fileLocation);
     }
 
-    m_imageSize = m_width * m_height * 4;
-    m_imageData = image;
+    m_width = width;
+    m_height = height;
+    m_imageSize = static_cast<VkDeviceSize>(m_width) * m_height * 4;
 
     //now that the image data and the information about the imagefile has been stored, we create the VkImage and the VkImageView for our texture
     m_format = VK_FORMAT_R8G8B8A8_UNORM; //here we set the format manually, we do not need to check if it is compatible with other features
 
+    //full mip chain. the upload batcher blits the levels from the first one, or they are all downsampled here when
+    //the format cannot be blitted with a linear filter
+    m_mipLevels = fullMipLevelCount(m_width, m_height);
+    bool cpuMipChain = m_mipLevels > 1 && !supportsBlitMipGeneration();
+
+    createImage(VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    createImageView(m_format, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    if(uploadBatcher != nullptr && !cpuMipChain)
+    {
+        //the decoded pixels are expanded to rgba straight into the staging memory
+        size_t pixelCount = static_cast<size_t>(m_width) * m_height;
+        uploadBatcher->uploadImage(this, m_imageSize, [image, channels, pixelCount](void* staging){
+            PixelImageDecoder::expandToRGBA(image, channels, pixelCount, static_cast<stbi_uc*>(staging));
+        });
+        stbi_image_free(image);
+        m_uploadQueued = true;
+        return;
+    }
+
+    if(channels == 4)
+    {
+        m_imageData = image;
+    } else
+    {
+        m_imageData = static_cast<stbi_uc*>(malloc(static_cast<size_t>(m_imageSize)));
+        if(m_imageData != nullptr)
+        {
+            PixelImageDecoder::expandToRGBA(image, channels, static_cast<size_t>(m_width) * m_height, m_imageData);
+        }
+        stbi_image_free(image);
+        if(m_imageData == nullptr)
+        {
+            throw std::runtime_error("Failed to allocate the pixels of: " + fileLocation);
+        }
+    }
+
+    if(cpuMipChain)
+    {
+        PixelTextureCompressor::TextureData texture{};
+        texture.format = m_format;
+        texture.width = m_width;
+        texture.height = m_height;
+        texture.data = m_imageData;
+        texture.size = m_imageSize;
+        if(!PixelTextureCompressor::buildMipChain(texture))
+        {
+            throw std::runtime_error("Failed to allocate the mip chain of: " + fileLocation);
+        }
+
+        m_imageData = texture.data;
+        m_imageSize = texture.size;
+    }
+
+    stageImageData(uploadBatcher);
+}
+
+void PixelImage::stageImageData(PixelUploadBatcher* uploadBatcher) {
+
+    if(uploadBatcher == nullptr)
+    {
+        return; //uploaded later from getImageData()
+    }
+
+    //the staging memory holds a copy once the call returns, the gpu does not need ours
+    uploadBatcher->uploadImage(this, m_imageData, m_imageSize);
+    releaseImageData();
+    m_uploadQueued = true;
+}
+
+void PixelImage::releaseImageData() {
+    stbi_image_free(m_imageData);
+    m_imageData = nullptr;
+}
+
+void PixelImage::createFromTextureData(const PixelTextureCompressor::TextureData& texture) {
+
+    //every level is in the data, nothing is blitted
+    m_format = texture.format;
+    m_width = texture.width;
+    m_height = texture.height;
+    m_mipLevels = texture.mipLevels;
+    m_imageData = texture.data;
+    m_imageSize = texture.size;
+
     createImage(VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
     createImageView(m_format, VK_IMAGE_ASPECT_COLOR_BIT);
 }
 
+void PixelImage::createMipRange(const PixelTextureCompressor::TextureData& texture, uint32_t firstLevel) {
+
+    //levels [firstLevel, mipLevels) of the texture, its level firstLevel is the image's first
+    m_format = texture.format;
+    m_width = std::max(texture.width >> firstLevel, 1u);
+    m_height = std::max(texture.height >> firstLevel, 1u);
+    m_mipLevels = texture.mipLevels - firstLevel;
+    m_imageData = nullptr;
+    m_imageSize = 0;
+
+    //the image of the next mip range copies the levels it shares with this one
+    createImage(VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    createImageView(m_format, VK_IMAGE_ASPECT_COLOR_BIT);
+}
+
+VkDeviceSize PixelImage::getMipLevelSize(uint32_t level) {
+    return PixelTextureCompressor::getLevelSize(m_format, getMipWidth(level), getMipHeight(level));
+}
+
 void PixelImage::loadEmptyTexture() {
     m_width = 1;
     m_height = 1;
@@ -170,11 +311,20 @@ void PixelImage::loadEmptyTexture() {
     createImageView(m_format, VK_IMAGE_ASPECT_COLOR_BIT);
 }
 
-void PixelImage::loadEmptyTexture(uint32_t width, uint32_t height, VkImageUsageFlags flags) {
+void PixelImage::loadEmptyTexture(uint32_t width, uint32_t height, VkImageUsageFlags flags, VkFormat format) {
+    uint32_t pixelSize = 4;
+    if(format == VK_FORMAT_R16G16B16A16_SFLOAT)
+    {
+        pixelSize = 8;
+    } else if(format == VK_FORMAT_R32G32B32A32_SFLOAT)
+    {
+        pixelSize = 16;
+    }
+
     m_width = width;
     m_height = height;
-    m_imageSize = width * height * 4;
-    m_format = VK_FORMAT_R8G8B8A8_UNORM; //here we set the format manually, we do not need to check if it is compatible with other features
+    m_imageSize = width * height * pixelSize;
+    m_format = format; //here we set the format manually, we do not need to check if it is compatible with other features
 
     createImage(VK_IMAGE_TILING_OPTIMAL, flags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
     createImageView(m_format, VK_IMAGE_ASPECT_COLOR_BIT);
@@ -10,9 +10,14 @@
 #include <GLFW/glfw3.h>
 
 #include "stb_image.h"
+#include "PixelTextureCompressor.h"
 #include "Utility.h"
+#include "PixelMemoryAllocator.h"
 
 #include <iostream>
+#include <algorithm>
+
+class PixelUploadBatcher;
 
 class PixelImage {
 public:
@@ -39,19 +44,34 @@ public:
     uint32_t getHeight(){return m_height;}
     VkImage getImage() { return m_image;}
     VkImageView getImageView() {return m_imageView;}
-    VkDeviceMemory getImageDeviceMemory() {return m_imageMemory;}
+    PixAllocation* getImageAllocation() {return &m_imageAllocation;}
     VkFormat getFormat();
-    VkDeviceSize getImageBufferSize(){return m_imageSize;}
+    VkDeviceSize getImageBufferSize(){return m_imageSize;} //of every level in getImageData()
+    uint32_t getMipLevels(){return m_mipLevels;}
+    uint32_t getMipWidth(uint32_t level){return std::max(m_width >> level, 1u);}
+    uint32_t getMipHeight(uint32_t level){return std::max(m_height >> level, 1u);}
+    VkDeviceSize getMipLevelSize(uint32_t level); //in the image's format
     stbi_uc* getImageData(){return m_imageData;}
     bool hasBeenInitialized(){return m_ImageInitialized;}
     bool hasBeenCleaned(){return m_ressourcesCleaned;}
+    int getTextureIndex(){return m_textureIndex;}
+    void setTextureIndex(int textureIndex){m_textureIndex = textureIndex;}
+    bool isUploadQueued(){return m_uploadQueued;}
+    void setUploadQueued(bool uploadQueued){m_uploadQueued = uploadQueued;}
 
     //helper functions
+    static uint32_t fullMipLevelCount(uint32_t width, uint32_t height);
+    bool supportsBlitMipGeneration();
+    void createFromTextureData(const PixelTextureCompressor::TextureData& texture); //takes the data over
+    void createMipRange(const PixelTextureCompressor::TextureData& texture, uint32_t firstLevel); //the data stays with the caller
+    void releaseImageData(); //once the pixels were staged
 
     //loader functions
-    void loadTexture(std::string filename);
+    //with an upload batcher the pixels go to its staging memory as they are decoded and no cpu copy is kept,
+    //the upload is queued in the batcher's current batch
+    void loadTexture(std::string filename, PixelUploadBatcher* uploadBatcher = nullptr);
     void loadEmptyTexture();
-    void loadEmptyTexture(uint32_t width, uint32_t height, VkImageUsageFlags flags);
+    void loadEmptyTexture(uint32_t width, uint32_t height, VkImageUsageFlags flags, VkFormat format = VK_FORMAT_R8G8B8A8_UNORM); //rgba8 or float rgba
 
 private:
 
@@ -65,6 +85,9 @@ private:
     bool m_IsSwapChainImage = false;
     bool m_ImageInitialized = false;
     bool m_ressourcesCleaned = false;
+    int m_textureIndex = -1; //global index in the texture table, -1 when not registered
+    uint32_t m_mipLevels = 1;
+    bool m_uploadQueued = false; //the pixels were already handed to the upload batcher while loading
 
     //vulkan components
     PixBackend* m_device;
@@ -72,7 +95,10 @@ private:
     VkDeviceSize m_imageSize{};
     VkImage m_image = VK_NULL_HANDLE;
     VkImageView m_imageView = VK_NULL_HANDLE;
-    VkDeviceMemory m_imageMemory = VK_NULL_HANDLE; //only applicable if PixelImage is used for depth buffer
+    PixAllocation m_imageAllocation{}; //not applicable to swapchain images
+
+    //helper functions
+    void stageImageData(PixelUploadBatcher* uploadBatcher);
 };
 
 
@@ -0,0 +1,452 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#include "PixelImageDecoder.h"
+
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cstdio>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#define PIXELENGINE_DECODER_X86
+#endif
+
+//the simd functions are compiled for their instruction set whatever the target of the rest of the file,
+//they are only called once the cpu is known to support it
+#if defined(PIXELENGINE_DECODER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define PIXELENGINE_TARGET(instructionSet) __attribute__((target(instructionSet)))
+#else
+#define PIXELENGINE_TARGET(instructionSet)
+#endif
+
+static PixelImageDecoder::SimdLevel detectSimdLevel()
+{
+#if defined(PIXELENGINE_DECODER_X86) && defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    bool ssse3 = (info[2] & (1 << 9)) != 0;
+    bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+
+    bool avx2 = false;
+    if(maxLeaf >= 7 && osSavesAvx)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+
+    if(avx2) return PixelImageDecoder::SIMD_AVX2;
+    if(ssse3) return PixelImageDecoder::SIMD_SSSE3;
+    if(sse2) return PixelImageDecoder::SIMD_SSE2;
+    return PixelImageDecoder::SIMD_NONE;
+#elif defined(PIXELENGINE_DECODER_X86)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) return PixelImageDecoder::SIMD_AVX2;
+    if(__builtin_cpu_supports("ssse3")) return PixelImageDecoder::SIMD_SSSE3;
+    if(__builtin_cpu_supports("sse2")) return PixelImageDecoder::SIMD_SSE2;
+    return PixelImageDecoder::SIMD_NONE;
+#else
+    return PixelImageDecoder::SIMD_NONE;
+#endif
+}
+
+static PixelImageDecoder::SimdLevel& activeSimdLevel()
+{
+    static PixelImageDecoder::SimdLevel level = PixelImageDecoder::getSupportedSimdLevel();
+    return level;
+}
+
+PixelImageDecoder::SimdLevel PixelImageDecoder::getSupportedSimdLevel() {
+    static SimdLevel supportedLevel = detectSimdLevel();
+    return supportedLevel;
+}
+
+PixelImageDecoder::SimdLevel PixelImageDecoder::getSimdLevel() {
+    return activeSimdLevel();
+}
+
+const char* PixelImageDecoder::getSimdLevelName(SimdLevel level) {
+    switch(level)
+    {
+        case SIMD_SSE2: return "SSE2";
+        case SIMD_SSSE3: return "SSSE3";
+        case SIMD_AVX2: return "AVX2";
+        default: return "scalar";
+    }
+}
+
+void PixelImageDecoder::setSimdLevel(SimdLevel level) {
+    activeSimdLevel() = std::min(level, getSupportedSimdLevel());
+}
+
+//channel expansion. every path ends with the scalar loop for the pixels that do not fill a vector
+
+static void expandScalar(const stbi_uc* source, uint32_t channels, size_t first, size_t pixelCount, stbi_uc* destination)
+{
+    for(size_t i = first; i < pixelCount; i++)
+    {
+        const stbi_uc* pixel = source + i * channels;
+        stbi_uc* texel = destination + i * 4;
+        switch(channels)
+        {
+            case 1: texel[0] = texel[1] = texel[2] = pixel[0]; texel[3] = 255; break;
+            case 2: texel[0] = texel[1] = texel[2] = pixel[0]; texel[3] = pixel[1]; break;
+            case 3: texel[0] = pixel[0]; texel[1] = pixel[1]; texel[2] = pixel[2]; texel[3] = 255; break;
+            default: memcpy(texel, pixel, 4); break;
+        }
+    }
+}
+
+#ifdef PIXELENGINE_DECODER_X86
+
+PIXELENGINE_TARGET("sse2")
+static size_t expandGreySSE2(const stbi_uc* source, size_t pixelCount, stbi_uc* destination)
+{
+    //16 pixels per iteration, each grey byte repeated 4 times and the alpha set
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    size_t i = 0;
+    for(; i + 16 <= pixelCount; i += 16)
+    {
+        __m128i grey = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        __m128i greyLow = _mm_unpacklo_epi8(grey, grey);
+        __m128i greyHigh = _mm_unpackhi_epi8(grey, grey);
+
+        __m128i* texels = reinterpret_cast<__m128i*>(destination + i * 4);
+        _mm_storeu_si128(texels + 0, _mm_or_si128(_mm_unpacklo_epi16(greyLow, greyLow), alpha));
+        _mm_storeu_si128(texels + 1, _mm_or_si128(_mm_unpackhi_epi16(greyLow, greyLow), alpha));
+        _mm_storeu_si128(texels + 2, _mm_or_si128(_mm_unpacklo_epi16(greyHigh, greyHigh), alpha));
+        _mm_storeu_si128(texels + 3, _mm_or_si128(_mm_unpackhi_epi16(greyHigh, greyHigh), alpha));
+    }
+    return i;
+}
+
+PIXELENGINE_TARGET("ssse3")
+static size_t expandRGBSSSE3(const stbi_uc* source, size_t pixelCount, stbi_uc* destination)
+{
+    //4 pixels per load of 12 bytes. the loads read 4 bytes past their pixels, the last iteration stays 4 bytes clear of the end
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    size_t i = 0;
+    for(; i + 18 <= pixelCount; i += 16)
+    {
+        const stbi_uc* pixels = source + i * 3;
+        __m128i* texels = reinterpret_cast<__m128i*>(destination + i * 4);
+        for(int part = 0; part < 4; part++)
+        {
+            __m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + part * 12));
+            _mm_storeu_si128(texels + part, _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+        }
+    }
+    return i;
+}
+
+PIXELENGINE_TARGET("ssse3")
+static size_t expandGreyAlphaSSSE3(const stbi_uc* source, size_t pixelCount, stbi_uc* destination)
+{
+    const __m128i shuffleLow = _mm_setr_epi8(0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7);
+    const __m128i shuffleHigh = _mm_setr_epi8(8, 8, 8, 9, 10, 10, 10, 11, 12, 12, 12, 13, 14, 14, 14, 15);
+    size_t i = 0;
+    for(; i + 8 <= pixelCount; i += 8)
+    {
+        __m128i greyAlpha = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 2));
+        __m128i* texels = reinterpret_cast<__m128i*>(destination + i * 4);
+        _mm_storeu_si128(texels + 0, _mm_shuffle_epi8(greyAlpha, shuffleLow));
+        _mm_storeu_si128(texels + 1, _mm_shuffle_epi8(greyAlpha, shuffleHigh));
+    }
+    return i;
+}
+
+PIXELENGINE_TARGET("avx2")
+static size_t expandGreyAVX2(const stbi_uc* source, size_t pixelCount, stbi_uc* destination)
+{
+    //the shuffle works within each 128 bit lane: both lanes get the 16 grey bytes, pixels 0-3 and 4-7 of 8
+    const __m256i shuffleLow = _mm256_setr_epi8(0, 0, 0, -1, 1, 1, 1, -1, 2, 2, 2, -1, 3, 3, 3, -1,
+                                                4, 4, 4, -1, 5, 5, 5, -1, 6, 6, 6, -1, 7, 7, 7, -1);
+    const __m256i shuffleHigh = _mm256_setr_epi8(8, 8, 8, -1, 9, 9, 9, -1, 10, 10, 10, -1, 11, 11, 11, -1,
+                                                 12, 12, 12, -1, 13, 13, 13, -1, 14, 14, 14, -1, 15, 15, 15, -1);
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+    size_t i = 0;
+    for(; i + 16 <= pixelCount; i += 16)
+    {
+        __m256i grey = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)));
+        __m256i* texels = reinterpret_cast<__m256i*>(destination + i * 4);
+        _mm256_storeu_si256(texels + 0, _mm256_or_si256(_mm256_shuffle_epi8(grey, shuffleLow), alpha));
+        _mm256_storeu_si256(texels + 1, _mm256_or_si256(_mm256_shuffle_epi8(grey, shuffleHigh), alpha));
+    }
+    return i;
+}
+
+PIXELENGINE_TARGET("avx2")
+static size_t expandRGBAVX2(const stbi_uc* source, size_t pixelCount, stbi_uc* destination)
+{
+    //8 pixels per vector, 4 in each lane. the loads read 4 bytes past their pixels like the SSSE3 path
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                             0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+    size_t i = 0;
+    for(; i + 34 <= pixelCount; i += 32)
+    {
+        const stbi_uc* pixels = source + i * 3;
+        __m256i* texels = reinterpret_cast<__m256i*>(destination + i * 4);
+        for(int part = 0; part < 4; part++)
+        {
+            __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + part * 24));
+            __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + part * 24 + 12));
+            __m256i rgb = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+            _mm256_storeu_si256(texels + part, _mm256_or_si256(_mm256_shuffle_epi8(rgb, shuffle), alpha));
+        }
+    }
+    return i;
+}
+
+PIXELENGINE_TARGET("avx2")
+static size_t expandGreyAlphaAVX2(const stbi_uc* source, size_t pixelCount, stbi_uc* destination)
+{
+    const __m256i shuffle = _mm256_setr_epi8(0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7,
+                                             8, 8, 8, 9, 10, 10, 10, 11, 12, 12, 12, 13, 14, 14, 14, 15);
+    size_t i = 0;
+    for(; i + 16 <= pixelCount; i += 16)
+    {
+        //pixels 0-7 in both lanes then 8-15, the low lane expands the first half of them
+        __m128i greyAlpha0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 2));
+        __m128i greyAlpha1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 2 + 16));
+        __m256i* texels = reinterpret_cast<__m256i*>(destination + i * 4);
+        _mm256_storeu_si256(texels + 0, _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(greyAlpha0), shuffle));
+        _mm256_storeu_si256(texels + 1, _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(greyAlpha1), shuffle));
+    }
+    return i;
+}
+
+#endif
+
+void PixelImageDecoder::expandToRGBA(const stbi_uc* source, uint32_t channels, size_t pixelCount, stbi_uc* destination) {
+
+    if(channels == 4)
+    {
+        memcpy(destination, source, pixelCount * 4);
+        return;
+    }
+
+    size_t expanded = 0;
+#ifdef PIXELENGINE_DECODER_X86
+    SimdLevel level = getSimdLevel();
+    if(level >= SIMD_AVX2)
+    {
+        switch(channels)
+        {
+            case 1: expanded = expandGreyAVX2(source, pixelCount, destination); break;
+            case 2: expanded = expandGreyAlphaAVX2(source, pixelCount, destination); break;
+            case 3: expanded = expandRGBAVX2(source, pixelCount, destination); break;
+            default: break;
+        }
+    } else if(level >= SIMD_SSSE3)
+    {
+        switch(channels)
+        {
+            case 1: expanded = expandGreySSE2(source, pixelCount, destination); break;
+            case 2: expanded = expandGreyAlphaSSSE3(source, pixelCount, destination); break;
+            case 3: expanded = expandRGBSSSE3(source, pixelCount, destination); break;
+            default: break;
+        }
+    } else if(level >= SIMD_SSE2 && channels == 1)
+    {
+        expanded = expandGreySSE2(source, pixelCount, destination); //the other shuffles need SSSE3
+    }
+#endif
+    expandScalar(source, channels, expanded, pixelCount, destination);
+}
+
+//decoding
+
+static bool isJPEG(const std::vector<stbi_uc>& file)
+{
+    return file.size() >= 2 && file[0] == 0xFF && file[1] == 0xD8;
+}
+
+stbi_uc* PixelImageDecoder::decodeNative(const std::vector<stbi_uc>& file, uint32_t& width, uint32_t& height, uint32_t& channels) {
+
+    //JPEGs come out as rgba, stb_image converts their colors straight to 4 channels with SSE2
+    int fileWidth, fileHeight, fileChannels;
+    bool jpeg = isJPEG(file);
+    stbi_uc* pixels = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &fileWidth, &fileHeight, &fileChannels,
+                                            jpeg ? STBI_rgb_alpha : 0);
+    if(pixels == nullptr)
+    {
+        return nullptr;
+    }
+
+    width = static_cast<uint32_t>(fileWidth);
+    height = static_cast<uint32_t>(fileHeight);
+    channels = jpeg ? 4 : static_cast<uint32_t>(fileChannels);
+    return pixels;
+}
+
+bool PixelImageDecoder::readFile(const std::string& path, std::vector<stbi_uc>& file) {
+
+    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+    if(!stream.is_open())
+    {
+        return false;
+    }
+
+    auto size = static_cast<size_t>(stream.tellg());
+    file.resize(size);
+    stream.seekg(0);
+    return static_cast<bool>(stream.read(reinterpret_cast<char*>(file.data()), static_cast<std::streamsize>(size)));
+}
+
+bool PixelImageDecoder::getInfo(const std::vector<stbi_uc>& file, uint32_t& width, uint32_t& height) {
+
+    int fileWidth, fileHeight, fileChannels;
+    if(!stbi_info_from_memory(file.data(), static_cast<int>(file.size()), &fileWidth, &fileHeight, &fileChannels))
+    {
+        return false;
+    }
+
+    width = static_cast<uint32_t>(fileWidth);
+    height = static_cast<uint32_t>(fileHeight);
+    return true;
+}
+
+bool PixelImageDecoder::decodeRGBA(const std::vector<stbi_uc>& file, stbi_uc* destination) {
+
+    uint32_t width, height, channels;
+    stbi_uc* pixels = decodeNative(file, width, height, channels);
+    if(pixels == nullptr)
+    {
+        return false;
+    }
+
+    expandToRGBA(pixels, channels, static_cast<size_t>(width) * height, destination);
+    stbi_image_free(pixels);
+    return true;
+}
+
+stbi_uc* PixelImageDecoder::loadRGBA(const std::string& path, uint32_t& width, uint32_t& height) {
+
+    std::vector<stbi_uc> file;
+    if(!readFile(path, file))
+    {
+        return nullptr;
+    }
+
+    uint32_t channels;
+    stbi_uc* pixels = decodeNative(file, width, height, channels);
+    if(pixels == nullptr || channels == 4)
+    {
+        return pixels;
+    }
+
+    auto texels = static_cast<stbi_uc*>(malloc(static_cast<size_t>(width) * height * 4));
+    if(texels != nullptr)
+    {
+        expandToRGBA(pixels, channels, static_cast<size_t>(width) * height, texels);
+    }
+    stbi_image_free(pixels);
+    return texels;
+}
+
+//benchmark
+
+void PixelImageDecoder::runBenchmark(const std::string& directory, uint32_t iterations) {
+
+    std::vector<std::string> paths;
+    std::error_code error;
+    for(const auto& entry : std::filesystem::directory_iterator(directory, error))
+    {
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+        if(entry.is_regular_file() && (extension == ".png" || extension == ".jpg" || extension == ".jpeg"))
+        {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    iterations = std::max(iterations, 1u);
+    SimdLevel supportedLevel = getSupportedSimdLevel();
+    SimdLevel previousLevel = getSimdLevel();
+    printf("Decode benchmark: %zu images, %u iterations, %s supported\n", paths.size(), iterations, getSimdLevelName(supportedLevel));
+
+    //the files are read once, only the decode is timed. the best of the iterations is kept
+    std::vector<double> totalMs(supportedLevel + 2, 0.0);
+    double totalMegapixels = 0.0;
+    for(const auto& path : paths)
+    {
+        std::vector<stbi_uc> file;
+        uint32_t width, height;
+        if(!readFile(path, file) || !getInfo(file, width, height))
+        {
+            printf("  could not read %s\n", path.c_str());
+            continue;
+        }
+        double megapixels = static_cast<double>(width) * height / 1000000.0;
+        totalMegapixels += megapixels;
+
+        std::vector<stbi_uc> reference(static_cast<size_t>(width) * height * 4);
+        std::vector<stbi_uc> texels(reference.size());
+        printf("  %s (%ux%u)\n", path.c_str(), width, height);
+
+        //stb_image's own conversion to 4 channels first, then ours at every level
+        for(int method = -1; method <= static_cast<int>(supportedLevel); method++)
+        {
+            if(method >= 0)
+            {
+                setSimdLevel(static_cast<SimdLevel>(method));
+            }
+
+            double bestMs = 0.0;
+            bool matches = true;
+            for(uint32_t i = 0; i < iterations; i++)
+            {
+                auto startTime = std::chrono::high_resolution_clock::now();
+                bool decoded;
+                if(method < 0)
+                {
+                    int fileWidth, fileHeight, fileChannels;
+                    stbi_uc* pixels = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &fileWidth, &fileHeight, &fileChannels, STBI_rgb_alpha);
+                    decoded = pixels != nullptr;
+                    if(decoded)
+                    {
+                        memcpy(reference.data(), pixels, reference.size()); //the copy into the staging memory it replaces
+                        stbi_image_free(pixels);
+                    }
+                } else
+                {
+                    decoded = decodeRGBA(file, texels.data());
+                    matches = matches && decoded && texels == reference;
+                }
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+                bestMs = i == 0 ? ms : std::min(bestMs, ms);
+            }
+
+            totalMs[method + 1] += bestMs;
+            printf("    %-10s %8.2f ms %8.1f MP/s%s\n", method < 0 ? "stb rgba" : getSimdLevelName(static_cast<SimdLevel>(method)),
+                   bestMs, bestMs > 0.0 ? megapixels * 1000.0 / bestMs : 0.0, matches ? "" : "  MISMATCH");
+        }
+    }
+
+    printf("  total:\n");
+    for(size_t method = 0; method < totalMs.size(); method++)
+    {
+        printf("    %-10s %8.2f ms %8.1f MP/s (%.2fx)\n", method == 0 ? "stb rgba" : getSimdLevelName(static_cast<SimdLevel>(method - 1)),
+               totalMs[method], totalMs[method] > 0.0 ? totalMegapixels * 1000.0 / totalMs[method] : 0.0,
+               totalMs[method] > 0.0 ? totalMs[0] / totalMs[method] : 0.0);
+    }
+    fflush(stdout);
+
+    setSimdLevel(previousLevel);
+}
@@ -0,0 +1,53 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#ifndef PIXELENGINE_PIXELIMAGEDECODER_H
+#define PIXELENGINE_PIXELIMAGEDECODER_H
+
+#include "stb_image.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//decodes image files to rgba8 into memory the caller provides. JPEGs are decoded straight to rgba by stb_image, which
+//runs its IDCT, chroma upsampling and color conversion with SSE2. other formats are decoded with their own channel
+//count and expanded to rgba with the widest instruction set the cpu has, picked at runtime
+class PixelImageDecoder {
+public:
+
+    enum SimdLevel{
+        SIMD_NONE = 0,
+        SIMD_SSE2,
+        SIMD_SSSE3,
+        SIMD_AVX2
+    };
+
+    //runtime cpu detection, done once
+    static SimdLevel getSupportedSimdLevel();
+    static SimdLevel getSimdLevel();
+    static const char* getSimdLevelName(SimdLevel level);
+    //clamped to the supported level. lets the benchmark compare the paths
+    static void setSimdLevel(SimdLevel level);
+
+    //an encoded file in memory
+    static bool readFile(const std::string& path, std::vector<stbi_uc>& file);
+    static bool getInfo(const std::vector<stbi_uc>& file, uint32_t& width, uint32_t& height);
+    //pixels with the channels of the file (rgba for JPEGs), released with stbi_image_free. expandToRGBA() finishes them
+    static stbi_uc* decodeNative(const std::vector<stbi_uc>& file, uint32_t& width, uint32_t& height, uint32_t& channels);
+    //destination holds width * height * 4 bytes, the size getInfo gives
+    static bool decodeRGBA(const std::vector<stbi_uc>& file, stbi_uc* destination);
+    //malloc'd like stbi_load(..., STBI_rgb_alpha), released with stbi_image_free
+    static stbi_uc* loadRGBA(const std::string& path, uint32_t& width, uint32_t& height);
+
+    //1 (grey), 2 (grey, alpha), 3 (rgb) or 4 channels to rgba. the missing alpha is opaque
+    static void expandToRGBA(const stbi_uc* source, uint32_t channels, size_t pixelCount, stbi_uc* destination);
+
+    //decode every png/jpg of the directory with stb_image's rgba conversion and with each supported simd level
+    static void runBenchmark(const std::string& directory, uint32_t iterations);
+};
+
+
+#endif //PIXELENGINE_PIXELIMAGEDECODER_H
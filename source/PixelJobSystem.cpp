@@ -0,0 +1,129 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#include "PixelJobSystem.h"
+
+#include <cstdio>
+#include <memory>
+#include <exception>
+
+void PixelJobSystem::init(uint32_t workerCount) {
+
+    printf("Creating Job System (%u workers)\n", workerCount);
+    fflush(stdout);
+
+    m_stopping = false;
+    m_workers.reserve(workerCount);
+    for(uint32_t i = 0; i < workerCount; i++)
+    {
+        m_workers.emplace_back(&PixelJobSystem::workerLoop, this);
+    }
+}
+
+void PixelJobSystem::cleanUp() {
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_jobAvailable.notify_all();
+
+    for(auto& worker : m_workers)
+    {
+        worker.join();
+    }
+    m_workers.clear();
+    m_jobs.clear();
+}
+
+std::future<void> PixelJobSystem::submit(std::function<void()> job) {
+
+    //the task is shared so the queue can hold it in a copyable std::function
+    auto task = std::make_shared<std::packaged_task<void()>>(std::move(job));
+    std::future<void> future = task->get_future();
+
+    if(m_workers.empty())
+    {
+        (*task)(); //no worker to hand it to
+        return future;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.emplace_back([task](){ (*task)(); });
+    }
+    m_jobAvailable.notify_one();
+
+    return future;
+}
+
+void PixelJobSystem::parallelFor(uint32_t count, uint32_t rangeCount,
+                                 const std::function<void(uint32_t, uint32_t, uint32_t)>& job) {
+
+    if(rangeCount == 0)
+    {
+        return;
+    }
+
+    auto rangeBegin = [count, rangeCount](uint32_t rangeIndex){
+        return static_cast<uint32_t>((static_cast<uint64_t>(count) * rangeIndex) / rangeCount);
+    };
+
+    std::vector<std::future<void>> pending;
+    pending.reserve(rangeCount - 1);
+    for(uint32_t rangeIndex = 1; rangeIndex < rangeCount; rangeIndex++)
+    {
+        uint32_t begin = rangeBegin(rangeIndex);
+        uint32_t end = rangeBegin(rangeIndex + 1);
+        pending.push_back(submit([&job, rangeIndex, begin, end](){ job(rangeIndex, begin, end); }));
+    }
+
+    //the other ranges reference the job, every one of them has to finish before an error is passed on
+    std::exception_ptr error;
+    try {
+        job(0, 0, rangeBegin(1));
+    }
+    catch(...)
+    {
+        error = std::current_exception();
+    }
+
+    for(auto& future : pending)
+    {
+        try {
+            future.get();
+        }
+        catch(...)
+        {
+            if(!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    }
+
+    if(error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void PixelJobSystem::workerLoop() {
+
+    while(true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobAvailable.wait(lock, [this](){ return m_stopping || !m_jobs.empty(); });
+            if(m_stopping && m_jobs.empty())
+            {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
@@ -0,0 +1,53 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#ifndef PIXELENGINE_PIXELJOBSYSTEM_H
+#define PIXELENGINE_PIXELJOBSYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <cstdint>
+
+//fixed set of worker threads pulling jobs from one queue. used to record command buffers in parallel
+class PixelJobSystem {
+public:
+    PixelJobSystem() = default;
+    PixelJobSystem(const PixelJobSystem&) = delete;
+    PixelJobSystem& operator=(const PixelJobSystem&) = delete;
+    ~PixelJobSystem(){cleanUp();}
+
+    //with no worker, every job runs on the calling thread
+    void init(uint32_t workerCount);
+    void cleanUp();
+
+    //run a job on a worker
+    std::future<void> submit(std::function<void()> job);
+
+    //split [0, count) in rangeCount contiguous ranges and call job(rangeIndex, begin, end) once per range, empty ranges
+    //included. the calling thread takes the first range and returns once every range is done
+    void parallelFor(uint32_t count, uint32_t rangeCount,
+                     const std::function<void(uint32_t rangeIndex, uint32_t begin, uint32_t end)>& job);
+
+    //getters
+    uint32_t getWorkerCount() const {return static_cast<uint32_t>(m_workers.size());}
+    uint32_t getThreadCount() const {return getWorkerCount() + 1;} //workers and the calling thread
+
+private:
+
+    void workerLoop();
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_jobAvailable;
+    bool m_stopping = false;
+};
+
+
+#endif //PIXELENGINE_PIXELJOBSYSTEM_H
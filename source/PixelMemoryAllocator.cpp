@@ -0,0 +1,340 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#include "PixelMemoryAllocator.h"
+
+#include <algorithm>
+
+void PixelMemoryAllocator::init(PixBackend* backend, VkDeviceSize preferredBlockSize) {
+
+    printf("Creating Memory Allocator\n");
+    fflush(stdout);
+
+    m_backend = backend;
+    m_preferredBlockSize = preferredBlockSize;
+
+    vkGetPhysicalDeviceMemoryProperties(m_backend->physicalDevice, &m_memoryProperties);
+
+    m_linearPools.resize(m_memoryProperties.memoryTypeCount);
+    m_optimalPools.resize(m_memoryProperties.memoryTypeCount);
+}
+
+void PixelMemoryAllocator::cleanUp() {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    PixMemoryStats stats{};
+    for(auto* pools : {&m_linearPools, &m_optimalPools})
+    {
+        for(auto& pool : *pools)
+        {
+            for(auto& block : pool)
+            {
+                stats.allocationCount += block->allocationCount;
+                destroyBlock(block.get());
+            }
+            pool.clear();
+        }
+    }
+
+    if(stats.allocationCount > 0)
+    {
+        printf("WARNING: %u allocations were still alive when the memory allocator was destroyed\n", stats.allocationCount);
+        fflush(stdout);
+    }
+}
+
+PixAllocation PixelMemoryAllocator::allocate(const VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags propertyFlags, bool linearResource) {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t memoryTypeIndex = findMemoryType(memoryRequirements.memoryTypeBits, propertyFlags);
+    auto& pool = linearResource ? m_linearPools[memoryTypeIndex] : m_optimalPools[memoryTypeIndex];
+
+    PixAllocation allocation{};
+
+    //first fit through the existing blocks of that memory type
+    for(auto& block : pool)
+    {
+        if(allocateFromBlock(block.get(), memoryRequirements.size, memoryRequirements.alignment, &allocation))
+        {
+            return allocation;
+        }
+    }
+
+    //no room left, grab a new block. resources bigger than half a block get a block of their own
+    VkDeviceSize blockSize = m_preferredBlockSize;
+    if(memoryRequirements.size > m_preferredBlockSize / 2)
+    {
+        blockSize = memoryRequirements.size;
+    }
+
+    PixMemoryBlock* newBlock = createBlock(memoryTypeIndex, blockSize, linearResource);
+    if(!allocateFromBlock(newBlock, memoryRequirements.size, memoryRequirements.alignment, &allocation))
+    {
+        throw std::runtime_error("failed to sub-allocate from a newly created memory block");
+    }
+
+    return allocation;
+}
+
+void PixelMemoryAllocator::free(PixAllocation& allocation) {
+
+    if(allocation.block == nullptr)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    PixMemoryBlock* block = allocation.block;
+    auto& regions = block->freeRegions;
+
+    //find where the region goes and refuse double frees (the range would overlap a free region)
+    auto next = std::lower_bound(regions.begin(), regions.end(), allocation.offset,
+                                 [](const PixMemoryBlock::FreeRegion& region, VkDeviceSize offset){ return region.offset < offset; });
+    bool overlapsNext = next != regions.end() && next->offset < allocation.offset + allocation.size;
+    bool overlapsPrevious = next != regions.begin() && std::prev(next)->offset + std::prev(next)->size > allocation.offset;
+    if(overlapsNext || overlapsPrevious)
+    {
+        printf("WARNING: memory region at offset %llu was freed twice\n", (unsigned long long)allocation.offset);
+        fflush(stdout);
+        allocation = {};
+        return;
+    }
+
+    next = regions.insert(next, {allocation.offset, allocation.size});
+
+    //merge with the following region
+    auto following = std::next(next);
+    if(following != regions.end() && next->offset + next->size == following->offset)
+    {
+        next->size += following->size;
+        regions.erase(following);
+    }
+
+    //merge with the preceding region
+    if(next != regions.begin())
+    {
+        auto previous = std::prev(next);
+        if(previous->offset + previous->size == next->offset)
+        {
+            previous->size += next->size;
+            regions.erase(next);
+        }
+    }
+
+    block->bytesInUse -= allocation.size;
+    block->allocationCount--;
+
+    //give empty blocks back to the driver, but keep one standard block per pool around to avoid thrashing
+    if(block->allocationCount == 0)
+    {
+        auto& pool = block->linearResources ? m_linearPools[block->memoryTypeIndex] : m_optimalPools[block->memoryTypeIndex];
+        if(pool.size() > 1 || block->size != m_preferredBlockSize)
+        {
+            destroyBlock(block);
+            pool.erase(std::remove_if(pool.begin(), pool.end(),
+                                      [block](const std::unique_ptr<PixMemoryBlock>& poolBlock){ return poolBlock.get() == block; }),
+                       pool.end());
+        }
+    }
+
+    allocation = {};
+}
+
+void PixelMemoryAllocator::createBuffer(VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsageFlags, VkMemoryPropertyFlags bufferProperties,
+                                        VkBuffer* buffer, PixAllocation* allocation) {
+
+    //does not have any memory, just a header
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = bufferSize;
+    bufferInfo.usage = bufferUsageFlags;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkResult result = vkCreateBuffer(m_backend->logicalDevice, &bufferInfo, nullptr, buffer);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create buffer");
+    }
+
+    //get buffer memory requirements (size rounded up and alignment for this usage)
+    VkMemoryRequirements memoryRequirements{};
+    vkGetBufferMemoryRequirements(m_backend->logicalDevice, *buffer, &memoryRequirements);
+
+    *allocation = allocate(memoryRequirements, bufferProperties, true);
+
+    result = vkBindBufferMemory(m_backend->logicalDevice, *buffer, allocation->memory, allocation->offset);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to bind buffer memory");
+    }
+}
+
+void PixelMemoryAllocator::destroyBuffer(VkBuffer* buffer, PixAllocation* allocation) {
+
+    vkDestroyBuffer(m_backend->logicalDevice, *buffer, nullptr);
+    *buffer = VK_NULL_HANDLE;
+    free(*allocation);
+}
+
+void PixelMemoryAllocator::bindImage(VkImage image, VkMemoryPropertyFlags propertyFlags, bool linearTiling, PixAllocation* allocation) {
+
+    VkMemoryRequirements memoryRequirements{};
+    vkGetImageMemoryRequirements(m_backend->logicalDevice, image, &memoryRequirements);
+
+    *allocation = allocate(memoryRequirements, propertyFlags, linearTiling);
+
+    //connect image to memory
+    VkResult result = vkBindImageMemory(m_backend->logicalDevice, image, allocation->memory, allocation->offset);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to bind image memory");
+    }
+}
+
+PixMemoryStats PixelMemoryAllocator::getStats() {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    PixMemoryStats stats{};
+    VkDeviceSize totalFree = 0;
+
+    for(auto* pools : {&m_linearPools, &m_optimalPools})
+    {
+        for(auto& pool : *pools)
+        {
+            for(auto& block : pool)
+            {
+                stats.blockCount++;
+                stats.allocationCount += block->allocationCount;
+                stats.bytesReserved += block->size;
+                stats.bytesInUse += block->bytesInUse;
+                stats.freeRegionCount += static_cast<uint32_t>(block->freeRegions.size());
+
+                for(const auto& region : block->freeRegions)
+                {
+                    totalFree += region.size;
+                    stats.largestFreeRegion = std::max(stats.largestFreeRegion, region.size);
+                }
+            }
+        }
+    }
+
+    if(totalFree > 0)
+    {
+        stats.fragmentation = 1.0f - (float)stats.largestFreeRegion / (float)totalFree;
+    }
+
+    return stats;
+}
+
+uint32_t PixelMemoryAllocator::findMemoryType(uint32_t allowedTypes, VkMemoryPropertyFlags propertyFlags) {
+
+    uint32_t memoryTypeIndex = findMemoryTypeIndex(m_backend->physicalDevice, allowedTypes, propertyFlags);
+
+    //findMemoryTypeIndex falls back to 0 when nothing matches, make sure we did not get that fallback
+    if( !(allowedTypes & (1 << memoryTypeIndex)) ||
+        (m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & propertyFlags) != propertyFlags )
+    {
+        throw std::runtime_error("failed to find a memory type matching the requested properties");
+    }
+
+    return memoryTypeIndex;
+}
+
+PixMemoryBlock* PixelMemoryAllocator::createBlock(uint32_t memoryTypeIndex, VkDeviceSize blockSize, bool linearResources) {
+
+    auto block = std::make_unique<PixMemoryBlock>();
+    block->size = blockSize;
+    block->memoryTypeIndex = memoryTypeIndex;
+    block->linearResources = linearResources;
+    block->freeRegions.push_back({0, blockSize});
+
+    VkMemoryAllocateInfo allocateInfo{};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.allocationSize = blockSize;
+    allocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+    VkResult result = vkAllocateMemory(m_backend->logicalDevice, &allocateInfo, nullptr, &block->memory);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate device memory block");
+    }
+
+    //map host visible memory once, sub-allocations only hand out pointers inside the mapping
+    if(m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        result = vkMapMemory(m_backend->logicalDevice, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mappedData);
+        if(result != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to map device memory block");
+        }
+    }
+
+    auto& pool = linearResources ? m_linearPools[memoryTypeIndex] : m_optimalPools[memoryTypeIndex];
+    pool.push_back(std::move(block));
+
+    return pool.back().get();
+}
+
+void PixelMemoryAllocator::destroyBlock(PixMemoryBlock* block) {
+
+    if(block->mappedData != nullptr)
+    {
+        vkUnmapMemory(m_backend->logicalDevice, block->memory);
+        block->mappedData = nullptr;
+    }
+
+    vkFreeMemory(m_backend->logicalDevice, block->memory, nullptr);
+    block->memory = VK_NULL_HANDLE;
+}
+
+bool PixelMemoryAllocator::allocateFromBlock(PixMemoryBlock* block, VkDeviceSize size, VkDeviceSize alignment, PixAllocation* allocation) {
+
+    alignment = std::max<VkDeviceSize>(alignment, 1);
+
+    for(auto region = block->freeRegions.begin(); region != block->freeRegions.end(); ++region)
+    {
+        VkDeviceSize alignedOffset = (region->offset + alignment - 1) / alignment * alignment;
+        VkDeviceSize padding = alignedOffset - region->offset;
+
+        if(region->size < padding + size)
+        {
+            continue;
+        }
+
+        allocation->memory = block->memory;
+        allocation->offset = alignedOffset;
+        allocation->size = size;
+        allocation->mappedData = block->mappedData != nullptr ? static_cast<char*>(block->mappedData) + alignedOffset : nullptr;
+        allocation->block = block;
+
+        if(padding > 0)
+        {
+            //the alignment padding in front of the allocation stays a free region of its own
+            VkDeviceSize regionEnd = region->offset + region->size;
+            region->size = padding;
+            if(regionEnd > alignedOffset + size)
+            {
+                block->freeRegions.insert(std::next(region), {alignedOffset + size, regionEnd - (alignedOffset + size)});
+            }
+        } else if(region->size == size)
+        {
+            block->freeRegions.erase(region);
+        } else
+        {
+            region->offset += size;
+            region->size -= size;
+        }
+
+        block->bytesInUse += size;
+        block->allocationCount++;
+
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,97 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#ifndef PIXELENGINE_PIXELMEMORYALLOCATOR_H
+#define PIXELENGINE_PIXELMEMORYALLOCATOR_H
+
+#include "Utility.h"
+
+#include <memory>
+#include <mutex>
+
+//one vkAllocateMemory worth of device memory. allocations are carved out of it using a free list
+struct PixMemoryBlock
+{
+    struct FreeRegion
+    {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    VkDeviceSize bytesInUse = 0;
+    uint32_t memoryTypeIndex = 0;
+    uint32_t allocationCount = 0;
+    bool linearResources = true; //which pool the block belongs to
+    void* mappedData = nullptr; //host visible blocks stay mapped for their whole lifetime
+    std::vector<FreeRegion> freeRegions; //sorted by offset, adjacent regions are always merged
+};
+
+//a sub-allocation inside a PixMemoryBlock. bind the resource with (memory, offset)
+struct PixAllocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mappedData = nullptr; //points at offset inside the mapped block, null if the memory is not host visible
+    PixMemoryBlock* block = nullptr;
+};
+
+struct PixMemoryStats
+{
+    uint32_t blockCount = 0; //live vkAllocateMemory calls made by the allocator
+    uint32_t allocationCount = 0; //live sub-allocations
+    VkDeviceSize bytesReserved = 0; //device memory owned by the blocks
+    VkDeviceSize bytesInUse = 0; //requested sizes of the live allocations, the alignment padding in front of them stays free
+    uint32_t freeRegionCount = 0;
+    VkDeviceSize largestFreeRegion = 0;
+    float fragmentation = 0.0f; //0 when all free memory is contiguous, close to 1 when it is scattered in small holes
+};
+
+class PixelMemoryAllocator {
+public:
+    PixelMemoryAllocator() = default;
+    PixelMemoryAllocator(const PixelMemoryAllocator&) = delete;
+    PixelMemoryAllocator& operator=(const PixelMemoryAllocator&) = delete;
+
+    void init(PixBackend* backend, VkDeviceSize preferredBlockSize = DEFAULT_BLOCK_SIZE);
+    void cleanUp();
+
+    //raw memory
+    PixAllocation allocate(const VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags propertyFlags, bool linearResource);
+    void free(PixAllocation& allocation);
+
+    //resource helpers, create the resource and bind it to a sub-allocation
+    void createBuffer(VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsageFlags, VkMemoryPropertyFlags bufferProperties,
+                      VkBuffer* buffer, PixAllocation* allocation);
+    void destroyBuffer(VkBuffer* buffer, PixAllocation* allocation);
+    void bindImage(VkImage image, VkMemoryPropertyFlags propertyFlags, bool linearTiling, PixAllocation* allocation);
+
+    //getters
+    PixMemoryStats getStats();
+
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+private:
+
+    PixBackend* m_backend{};
+    VkDeviceSize m_preferredBlockSize = DEFAULT_BLOCK_SIZE;
+    VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+
+    //buffers and linear images never share a block with optimal images so bufferImageGranularity never has to be checked
+    std::vector<std::vector<std::unique_ptr<PixMemoryBlock>>> m_linearPools;
+    std::vector<std::vector<std::unique_ptr<PixMemoryBlock>>> m_optimalPools;
+
+    std::mutex m_mutex;
+
+    //helper functions
+    uint32_t findMemoryType(uint32_t allowedTypes, VkMemoryPropertyFlags propertyFlags);
+    PixMemoryBlock* createBlock(uint32_t memoryTypeIndex, VkDeviceSize blockSize, bool linearResources);
+    void destroyBlock(PixMemoryBlock* block);
+    static bool allocateFromBlock(PixMemoryBlock* block, VkDeviceSize size, VkDeviceSize alignment, PixAllocation* allocation);
+};
+
+
+#endif //PIXELENGINE_PIXELMEMORYALLOCATOR_H
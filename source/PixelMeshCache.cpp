@@ -0,0 +1,258 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#include "PixelMeshCache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <atomic>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const char MESH_CACHE_MAGIC[4] = {'P', 'X', 'M', 'C'};
+
+//read only view of a whole file, unmapped when it goes out of scope
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path)
+    {
+#ifdef _WIN32
+        fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(fileHandle == INVALID_HANDLE_VALUE)
+        {
+            return;
+        }
+        LARGE_INTEGER fileSize{};
+        if(!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+        {
+            return;
+        }
+        mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(mappingHandle == nullptr)
+        {
+            return;
+        }
+        m_data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+        m_size = m_data != nullptr ? static_cast<size_t>(fileSize.QuadPart) : 0;
+#else
+        fileDescriptor = open(path.c_str(), O_RDONLY);
+        if(fileDescriptor < 0)
+        {
+            return;
+        }
+        struct stat fileStat{};
+        if(fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+        {
+            return;
+        }
+        void* mapped = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        if(mapped == MAP_FAILED)
+        {
+            return;
+        }
+        m_data = mapped;
+        m_size = static_cast<size_t>(fileStat.st_size);
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if(m_data != nullptr) UnmapViewOfFile(m_data);
+        if(mappingHandle != nullptr) CloseHandle(mappingHandle);
+        if(fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+#else
+        if(m_data != nullptr) munmap(m_data, m_size);
+        if(fileDescriptor >= 0) close(fileDescriptor);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const {return static_cast<const unsigned char*>(m_data);}
+    size_t size() const {return m_size;}
+
+private:
+    void* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = nullptr;
+#else
+    int fileDescriptor = -1;
+#endif
+};
+
+std::string PixelMeshCache::getCachePath(const std::string& sourcePath) {
+    return sourcePath + ".pxmesh";
+}
+
+bool PixelMeshCache::writeCacheFile(const std::string& cachePath, const Header& header, const std::vector<Section>& sections) {
+
+    //written aside and renamed, a crash never leaves a half written cache behind. the temporary name is unique to the
+    //process and the call, loaders writing the same cache at once each rename a complete file
+    static std::atomic<uint32_t> temporaryCounter{0};
+#ifdef _WIN32
+    unsigned long processId = GetCurrentProcessId();
+#else
+    unsigned long processId = static_cast<unsigned long>(getpid());
+#endif
+    std::string temporaryPath = cachePath + "." + std::to_string(processId) + "." + std::to_string(temporaryCounter++) + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if(!file)
+        {
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        for(const Section& section : sections)
+        {
+            file.write(static_cast<const char*>(section.data), static_cast<std::streamsize>(section.size));
+        }
+        if(!file)
+        {
+            file.close();
+            std::error_code error;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, cachePath, error);
+    if(error)
+    {
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
+
+uint64_t PixelMeshCache::hashFile(const std::string& path) {
+
+    MappedFile file(path);
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t i = 0; i < file.size(); i++)
+    {
+        hash = (hash ^ file.data()[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+bool PixelMeshCache::load(const std::string& sourcePath,
+                          std::vector<PixelObject::Vertex>& vertices, std::vector<uint32_t>& indices,
+                          std::vector<PixelObject::Submesh>& submeshes, glm::vec4& boundingSphere) {
+
+    std::string cachePath = getCachePath(sourcePath);
+    std::error_code error;
+    if(!std::filesystem::exists(cachePath, error))
+    {
+        return false;
+    }
+
+    Header header{};
+    bool sourceTouched = false;
+    {
+        MappedFile file(cachePath);
+        if(file.size() < sizeof(Header))
+        {
+            return false;
+        }
+
+        memcpy(&header, file.data(), sizeof(Header));
+        if(memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0 ||
+           header.version != MESH_CACHE_VERSION || header.vertexStride != sizeof(PixelObject::Vertex))
+        {
+            printf("Mesh cache %s was written by another version, importing again\n", cachePath.c_str());
+            return false;
+        }
+
+        size_t vertexBytes = sizeof(PixelObject::Vertex) * static_cast<size_t>(header.vertexCount);
+        size_t indexBytes = sizeof(uint32_t) * static_cast<size_t>(header.indexCount);
+        size_t submeshBytes = sizeof(PixelObject::Submesh) * static_cast<size_t>(header.submeshCount);
+        if(file.size() != sizeof(Header) + vertexBytes + indexBytes + submeshBytes)
+        {
+            printf("Mesh cache %s is truncated, importing again\n", cachePath.c_str());
+            return false;
+        }
+
+        //a source without a change of size or timestamp is not read at all. otherwise its content decides
+        if(std::filesystem::exists(sourcePath, error))
+        {
+            auto sourceSize = static_cast<uint64_t>(std::filesystem::file_size(sourcePath, error));
+            auto sourceTime = static_cast<int64_t>(std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count());
+            if(sourceSize != header.sourceSize || sourceTime != header.sourceTime)
+            {
+                if(hashFile(sourcePath) != header.sourceHash)
+                {
+                    printf("Mesh cache %s is older than its source, importing again\n", cachePath.c_str());
+                    return false;
+                }
+                header.sourceSize = sourceSize;
+                header.sourceTime = sourceTime;
+                sourceTouched = true;
+            }
+        }
+
+        const unsigned char* payload = file.data() + sizeof(Header);
+        vertices.resize(header.vertexCount);
+        memcpy(vertices.data(), payload, vertexBytes);
+        indices.resize(header.indexCount);
+        memcpy(indices.data(), payload + vertexBytes, indexBytes);
+        submeshes.resize(header.submeshCount);
+        memcpy(submeshes.data(), payload + vertexBytes + indexBytes, submeshBytes);
+        boundingSphere = header.boundingSphere;
+    }
+
+    //same content, only touched. the new size and timestamp are recorded so the next load skips the hash. written once
+    //the cache is unmapped, a mapped file cannot be replaced on windows
+    if(sourceTouched)
+    {
+        writeCacheFile(cachePath, header, {
+                {vertices.data(), sizeof(PixelObject::Vertex) * vertices.size()},
+                {indices.data(), sizeof(uint32_t) * indices.size()},
+                {submeshes.data(), sizeof(PixelObject::Submesh) * submeshes.size()}});
+    }
+
+    return true;
+}
+
+bool PixelMeshCache::save(const std::string& sourcePath,
+                          const std::vector<PixelObject::Vertex>& vertices, const std::vector<uint32_t>& indices,
+                          const std::vector<PixelObject::Submesh>& submeshes, glm::vec4 boundingSphere) {
+
+    std::error_code error;
+    Header header{};
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    header.version = MESH_CACHE_VERSION;
+    header.vertexStride = sizeof(PixelObject::Vertex);
+    header.vertexCount = static_cast<uint32_t>(vertices.size());
+    header.indexCount = static_cast<uint32_t>(indices.size());
+    header.submeshCount = static_cast<uint32_t>(submeshes.size());
+    header.sourceSize = static_cast<uint64_t>(std::filesystem::file_size(sourcePath, error));
+    header.sourceTime = static_cast<int64_t>(std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count());
+    header.sourceHash = hashFile(sourcePath);
+    header.boundingSphere = boundingSphere;
+
+    return writeCacheFile(getCachePath(sourcePath), header, {
+            {vertices.data(), sizeof(PixelObject::Vertex) * vertices.size()},
+            {indices.data(), sizeof(uint32_t) * indices.size()},
+            {submeshes.data(), sizeof(PixelObject::Submesh) * submeshes.size()}});
+}
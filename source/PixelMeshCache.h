@@ -0,0 +1,59 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#ifndef PIXELENGINE_PIXELMESHCACHE_H
+#define PIXELENGINE_PIXELMESHCACHE_H
+
+#include "PixelObject.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+const uint32_t MESH_CACHE_VERSION = 1; //bump when the vertex layout or the import processing changes
+
+//binary copy of an imported mesh (post processed vertices, indices, bounds and submeshes) written next to its source
+//asset. the cache file is memory mapped on load and copied straight into the object, assimp is not involved.
+//a cache is stale when the source's size and timestamp changed and its content hash does not match anymore
+class PixelMeshCache {
+public:
+
+    //header at the start of a cache file
+    struct Header{
+        char magic[4];
+        uint32_t version;
+        uint32_t vertexStride; //sizeof(PixelObject::Vertex) when written
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t submeshCount;
+        uint64_t sourceSize;
+        int64_t sourceTime; //last write time of the source, in file clock ticks
+        uint64_t sourceHash; //FNV-1a of the source's bytes
+        glm::vec4 boundingSphere;
+    };
+    //followed by vertexCount vertices, indexCount indices and submeshCount submeshes
+
+    //cache file of a source asset
+    static std::string getCachePath(const std::string& sourcePath);
+
+    //false if there is no cache or it is stale, the outputs are then left untouched
+    static bool load(const std::string& sourcePath,
+                     std::vector<PixelObject::Vertex>& vertices, std::vector<uint32_t>& indices,
+                     std::vector<PixelObject::Submesh>& submeshes, glm::vec4& boundingSphere);
+    static bool save(const std::string& sourcePath,
+                     const std::vector<PixelObject::Vertex>& vertices, const std::vector<uint32_t>& indices,
+                     const std::vector<PixelObject::Submesh>& submeshes, glm::vec4 boundingSphere);
+
+private:
+    struct Section{
+        const void* data;
+        size_t size;
+    };
+
+    static uint64_t hashFile(const std::string& path);
+    static bool writeCacheFile(const std::string& cachePath, const Header& header, const std::vector<Section>& sections);
+};
+
+
+#endif //PIXELENGINE_PIXELMESHCACHE_H
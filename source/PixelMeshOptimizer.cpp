@@ -0,0 +1,312 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#include "PixelMeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+//scoring of the vertex cache optimisation, the values from Forsyth's article
+static const int FORSYTH_CACHE_SIZE = 32; //lru cache modelled while optimizing
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+static const uint32_t MIN_OVERDRAW_CLUSTER = 64; //triangles before a cluster may be split on a partial cache miss
+
+static float vertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+    if(remainingTriangles == 0)
+    {
+        return -1.0f; //no triangle left to draw with this vertex
+    }
+
+    float score = 0.0f;
+    if(cachePosition >= 0)
+    {
+        if(cachePosition < 3)
+        {
+            //used by the last triangle. a fixed score so the next triangle does not just reuse the same edge
+            score = LAST_TRIANGLE_SCORE;
+        } else
+        {
+            float scaler = 1.0f / static_cast<float>(FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.0f - static_cast<float>(cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+        }
+    }
+
+    //vertices with few triangles left get a boost, so they are finished and do not linger
+    score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+    return score;
+}
+
+PixelMeshOptimizer::CacheStats PixelMeshOptimizer::analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize) {
+
+    CacheStats stats{};
+    if(indices.size() < 3 || vertexCount == 0)
+    {
+        return stats;
+    }
+
+    //a vertex is in the fifo if fewer than cacheSize vertices were added after it
+    std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+    uint32_t timestamp = cacheSize + 1;
+    size_t transformedCount = 0;
+    for(uint32_t index : indices)
+    {
+        if(timestamp - cacheTimestamps[index] > cacheSize)
+        {
+            cacheTimestamps[index] = timestamp++;
+            transformedCount++;
+        }
+    }
+
+    stats.acmr = static_cast<float>(transformedCount) / static_cast<float>(indices.size() / 3);
+    stats.atvr = static_cast<float>(transformedCount) / static_cast<float>(vertexCount);
+    return stats;
+}
+
+void PixelMeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount) {
+
+    size_t triangleCount = indices.size() / 3;
+    if(triangleCount == 0 || vertexCount == 0)
+    {
+        return;
+    }
+
+    //triangles using each vertex. the first remainingTriangles[v] entries of a vertex's list are not emitted yet
+    std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+    for(size_t i = 0; i < triangleCount * 3; i++)
+    {
+        remainingTriangles[indices[i]]++;
+    }
+
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    std::partial_sum(remainingTriangles.begin(), remainingTriangles.end(), adjacencyOffsets.begin() + 1);
+
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for(size_t i = 0; i < triangleCount * 3; i++)
+    {
+        adjacency[adjacencyFill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> scores(vertexCount);
+    for(size_t v = 0; v < vertexCount; v++)
+    {
+        scores[v] = vertexScore(-1, remainingTriangles[v]);
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> newCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    std::vector<uint32_t> optimizedIndices;
+    optimizedIndices.reserve(triangleCount * 3);
+
+    int64_t bestTriangle = -1;
+    size_t scanCursor = 0;
+    for(size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+        if(bestTriangle < 0)
+        {
+            //nothing left around the cache, restart from the first triangle not emitted yet
+            while(emitted[scanCursor])
+            {
+                scanCursor++;
+            }
+            bestTriangle = static_cast<int64_t>(scanCursor);
+        }
+
+        auto triangle = static_cast<uint32_t>(bestTriangle);
+        emitted[triangle] = true;
+
+        newCache.clear();
+        for(int k = 0; k < 3; k++)
+        {
+            uint32_t vertex = indices[triangle * 3 + k];
+            optimizedIndices.push_back(vertex);
+
+            //move the triangle past the live part of the vertex's list
+            uint32_t* triangles = &adjacency[adjacencyOffsets[vertex]];
+            uint32_t liveCount = remainingTriangles[vertex];
+            for(uint32_t i = 0; i < liveCount; i++)
+            {
+                if(triangles[i] == triangle)
+                {
+                    std::swap(triangles[i], triangles[liveCount - 1]);
+                    remainingTriangles[vertex]--;
+                    break;
+                }
+            }
+
+            if(std::find(newCache.begin(), newCache.end(), vertex) == newCache.end())
+            {
+                newCache.push_back(vertex);
+            }
+        }
+
+        //the triangle's vertices go to the front of the lru cache
+        for(uint32_t vertex : cache)
+        {
+            if(std::find(newCache.begin(), newCache.end(), vertex) == newCache.end())
+            {
+                newCache.push_back(vertex);
+            }
+        }
+
+        for(size_t i = 0; i < newCache.size(); i++)
+        {
+            uint32_t vertex = newCache[i];
+            cachePositions[vertex] = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1; //pushed out
+            scores[vertex] = vertexScore(cachePositions[vertex], remainingTriangles[vertex]);
+        }
+        newCache.resize(std::min<size_t>(newCache.size(), FORSYTH_CACHE_SIZE));
+        std::swap(cache, newCache);
+
+        //the next triangle is the best one touching the cache
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for(uint32_t vertex : cache)
+        {
+            const uint32_t* triangles = &adjacency[adjacencyOffsets[vertex]];
+            for(uint32_t i = 0; i < remainingTriangles[vertex]; i++)
+            {
+                uint32_t candidate = triangles[i];
+                float score = scores[indices[candidate * 3]] + scores[indices[candidate * 3 + 1]] + scores[indices[candidate * 3 + 2]];
+                if(score > bestScore)
+                {
+                    bestScore = score;
+                    bestTriangle = candidate;
+                }
+            }
+        }
+    }
+
+    indices = std::move(optimizedIndices);
+}
+
+void PixelMeshOptimizer::optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<PixelObject::Vertex>& vertices, float threshold) {
+
+    size_t triangleCount = indices.size() / 3;
+    if(triangleCount < 2 || threshold <= 0.0f)
+    {
+        return;
+    }
+
+    //clusters start where the cache is cold: every vertex missed, or most of them once the cluster is large enough
+    std::vector<uint32_t> clusterStarts;
+    std::vector<uint32_t> cacheTimestamps(vertices.size(), 0);
+    uint32_t timestamp = VERTEX_CACHE_SIZE + 1;
+    for(uint32_t triangle = 0; triangle < triangleCount; triangle++)
+    {
+        int misses = 0;
+        for(int k = 0; k < 3; k++)
+        {
+            uint32_t vertex = indices[triangle * 3 + k];
+            if(timestamp - cacheTimestamps[vertex] > VERTEX_CACHE_SIZE)
+            {
+                cacheTimestamps[vertex] = timestamp++;
+                misses++;
+            }
+        }
+
+        if(clusterStarts.empty() || misses == 3 || (misses >= 2 && triangle - clusterStarts.back() >= MIN_OVERDRAW_CLUSTER))
+        {
+            clusterStarts.push_back(triangle);
+        }
+    }
+    if(clusterStarts.size() < 2)
+    {
+        return;
+    }
+    clusterStarts.push_back(static_cast<uint32_t>(triangleCount));
+
+    //area weighted centroid and normal of the mesh and of each cluster
+    size_t clusterCount = clusterStarts.size() - 1;
+    std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for(size_t cluster = 0; cluster < clusterCount; cluster++)
+    {
+        float clusterArea = 0.0f;
+        for(uint32_t triangle = clusterStarts[cluster]; triangle < clusterStarts[cluster + 1]; triangle++)
+        {
+            glm::vec3 p0 = glm::vec3(vertices[indices[triangle * 3]].position);
+            glm::vec3 p1 = glm::vec3(vertices[indices[triangle * 3 + 1]].position);
+            glm::vec3 p2 = glm::vec3(vertices[indices[triangle * 3 + 2]].position);
+
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0); //length is twice the area
+            float area = glm::length(normal);
+            glm::vec3 centroid = (p0 + p1 + p2) / 3.0f;
+
+            clusterCentroids[cluster] += centroid * area;
+            clusterNormals[cluster] += normal;
+            clusterArea += area;
+        }
+
+        meshCentroid += clusterCentroids[cluster];
+        meshArea += clusterArea;
+        clusterCentroids[cluster] = clusterArea > 0.0f ? clusterCentroids[cluster] / clusterArea : glm::vec3(vertices[indices[clusterStarts[cluster] * 3]].position);
+    }
+    meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : glm::vec3(0.0f);
+
+    //the further a cluster faces away from the center, the more likely it hides the others
+    std::vector<float> clusterSortKeys(clusterCount, 0.0f);
+    for(size_t cluster = 0; cluster < clusterCount; cluster++)
+    {
+        float normalLength = glm::length(clusterNormals[cluster]);
+        if(normalLength > 0.0f)
+        {
+            clusterSortKeys[cluster] = glm::dot(clusterCentroids[cluster] - meshCentroid, clusterNormals[cluster] / normalLength);
+        }
+    }
+
+    std::vector<uint32_t> clusterOrder(clusterCount);
+    std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+    std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&clusterSortKeys](uint32_t a, uint32_t b){
+        return clusterSortKeys[a] > clusterSortKeys[b];
+    });
+
+    std::vector<uint32_t> sortedIndices;
+    sortedIndices.reserve(triangleCount * 3);
+    for(uint32_t cluster : clusterOrder)
+    {
+        sortedIndices.insert(sortedIndices.end(), indices.begin() + clusterStarts[cluster] * 3, indices.begin() + clusterStarts[cluster + 1] * 3);
+    }
+
+    //keep the new order only if it does not cost too many vertex transforms
+    CacheStats originalStats = analyzeVertexCache(indices, vertices.size());
+    CacheStats sortedStats = analyzeVertexCache(sortedIndices, vertices.size());
+    if(sortedStats.acmr <= originalStats.acmr * threshold)
+    {
+        indices = std::move(sortedIndices);
+    }
+}
+
+void PixelMeshOptimizer::optimizeVertexFetch(std::vector<PixelObject::Vertex>& vertices, std::vector<uint32_t>& indices) {
+
+    const uint32_t unused = UINT32_MAX;
+    std::vector<uint32_t> remap(vertices.size(), unused);
+
+    std::vector<PixelObject::Vertex> orderedVertices;
+    orderedVertices.reserve(vertices.size());
+    for(auto& index : indices)
+    {
+        if(remap[index] == unused)
+        {
+            remap[index] = static_cast<uint32_t>(orderedVertices.size());
+            orderedVertices.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(orderedVertices);
+}
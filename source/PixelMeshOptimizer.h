@@ -0,0 +1,42 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#ifndef PIXELENGINE_PIXELMESHOPTIMIZER_H
+#define PIXELENGINE_PIXELMESHOPTIMIZER_H
+
+#include "PixelObject.h"
+
+#include <vector>
+#include <cstdint>
+
+const uint32_t VERTEX_CACHE_SIZE = 16; //fifo post transform cache the statistics are measured with
+const float OVERDRAW_ACMR_THRESHOLD = 1.05f; //the overdraw sort is kept if it raises the ACMR by at most this factor. 0 skips it
+
+//reorders the triangles and vertices of indexed triangle lists so the gpu transforms fewer vertices and fetches them
+//in order. run the passes in order: vertex cache, overdraw, vertex fetch
+class PixelMeshOptimizer {
+public:
+
+    struct CacheStats{
+        float acmr = 0.0f; //vertices transformed per triangle, 0.5 at best and 3 without any reuse
+        float atvr = 0.0f; //vertices transformed per vertex, 1 at best
+    };
+
+    //simulate a fifo cache of cacheSize entries over the index buffer
+    static CacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+    //Tom Forsyth's linear-speed vertex cache optimisation: greedily emit the triangle whose vertices score highest,
+    //favouring vertices recently used and vertices with few triangles left
+    static void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+    //split the triangles in clusters where the cache restarts and draw the outward facing clusters first, so they occlude
+    //the rest of the mesh. the new order is dropped if the ACMR grows by more than threshold
+    static void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<PixelObject::Vertex>& vertices, float threshold);
+
+    //store the vertices in the order the index buffer first uses them. unreferenced vertices are dropped
+    static void optimizeVertexFetch(std::vector<PixelObject::Vertex>& vertices, std::vector<uint32_t>& indices);
+};
+
+
+#endif //PIXELENGINE_PIXELMESHOPTIMIZER_H
@@ -3,31 +3,47 @@
 //
 
 #include "PixelObject.h"
+#include "PixelTextureTable.h"
+#include "PixelMeshOptimizer.h"
+#include "PixelMeshCache.h"
 
 #include <utility>
 #include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/packing.hpp>
+#include <cstring>
+#include <unordered_map>
+#include <atomic>
+
+static std::atomic<uint32_t> versionCounter{1};
+
+uint32_t PixelObject::nextVersion() {
+    //unique over all objects, so an object replacing another at the same scene index never matches its old version
+    return versionCounter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
 
 
 PixelObject::PixelObject(PixBackend* device, std::vector<Vertex> vertices, std::vector<uint32_t> indices): m_device(device), m_vertices(std::move(vertices)), m_indices(std::move(indices)) {
     //create the vertex buffer form the vertices
     printf("PixelObject user constructed\n");
     //createVertexBuffer(vertices);
+    computeBoundingSphere();
 }
 
 void PixelObject::cleanup() {
 
     for(auto texture : m_textures)
     {
+        if(texture.getTextureIndex() >= 0)
+        {
+            m_device->textureTable->removeTexture(texture.getTextureIndex());
+        }
         if(!texture.hasBeenCleaned())
         {
             texture.cleanUp();
         }
     }
-
-    vkFreeMemory(m_device->logicalDevice, vertexBufferMemory, nullptr);
-    vkDestroyBuffer(m_device->logicalDevice, vertexBuffer, nullptr);
-    vkFreeMemory(m_device->logicalDevice, indexBufferMemory, nullptr);
-    vkDestroyBuffer(m_device->logicalDevice, indexBuffer, nullptr);
 }
 
 std::vector<PixelObject::Vertex>* PixelObject::getVertices() {
@@ -39,15 +55,19 @@ int PixelObject::getVertexCount() {
 }
 
 VkDeviceSize PixelObject::getVertexBufferSize() {
-    return (sizeof(Vertex) * m_vertices.size());
+    return (getVertexStride(m_vertexFormat) * m_vertices.size());
 }
 
-VkBuffer* PixelObject::getVertexBuffer() {
-    return &vertexBuffer;
+const void* PixelObject::getVertexData() {
+    if(m_vertexFormat == VERTEX_FORMAT_PACKED)
+    {
+        return m_packedVertices.data();
+    }
+    return m_vertices.data();
 }
 
-VkDeviceMemory *PixelObject::getVertexBufferMemory() {
-    return &vertexBufferMemory;
+VkDeviceSize PixelObject::getVertexStride(VertexFormat vertexFormat) {
+    return vertexFormat == VERTEX_FORMAT_PACKED ? sizeof(PackedVertex) : sizeof(Vertex);
 }
 
 std::vector<uint32_t> *PixelObject::getIndices() {
@@ -62,31 +82,178 @@ VkDeviceSize PixelObject::getIndexBufferSize() {
     return (sizeof(uint32_t) * m_indices.size());
 }
 
-VkBuffer *PixelObject::getIndexBuffer() {
-    return &indexBuffer;
+void PixelObject::setGraphicsPipelineIndex(int pipelineIndx) {
+    if(graphicsPipelineIndex != pipelineIndx)
+    {
+        graphicsPipelineIndex = pipelineIndx;
+        drawStateVersion = nextVersion();
+    }
+}
+
+void PixelObject::setVertexFormat(VertexFormat vertexFormat) {
+    if(m_vertexFormat == vertexFormat)
+    {
+        return;
+    }
+
+    m_vertexFormat = vertexFormat;
+    if(m_vertexFormat == VERTEX_FORMAT_PACKED)
+    {
+        packVertices();
+    } else
+    {
+        m_packedVertices.clear();
+        m_packedVertices.shrink_to_fit();
+    }
+
+    m_objectData.vertexFormat = m_vertexFormat;
+    objectDataVersion = nextVersion();
+    drawStateVersion = nextVersion(); //drawn by another pipeline
 }
 
-VkDeviceMemory *PixelObject::getIndexBufferMemory() {
-    return &indexBufferMemory;
+void PixelObject::hide() {
+    if(!m_isHidden)
+    {
+        m_isHidden = true;
+        drawStateVersion = nextVersion();
+    }
 }
 
-void PixelObject::setDynamicUBObj(DynamicUBObj pushObjData) {
-    dynamicUBO = pushObjData;
+void PixelObject::unhide() {
+    if(m_isHidden)
+    {
+        m_isHidden = false;
+        drawStateVersion = nextVersion();
+    }
 }
 
-PixelObject::PObj* PixelObject::getPushObj() {
-    return &pushObj;
+void PixelObject::setObjectData(ObjectData objectData) {
+    objectData.boundingSphere = m_objectData.boundingSphere; //the bounds come from the mesh
+    objectData.vertexFormat = m_objectData.vertexFormat;
+    m_objectData = objectData;
+    objectDataVersion = nextVersion();
 }
 
-PixelObject::PixelObject(PixBackend *device, std::string filename) : m_device(device){
+PixelObject::PixelObject(PixBackend *device, std::string filename, bool useMeshCache) : m_device(device){
+
+    //the binary cache next to the asset skips assimp and the mesh processing
+    std::string fileLocation = "objects/" + filename;
+    if(useMeshCache && PixelMeshCache::load(fileLocation, m_vertices, m_indices, m_submeshes, m_objectData.boundingSphere))
+    {
+        printf("Loaded %s from its mesh cache: %zu vertices, %zu triangles\n", filename.c_str(), m_vertices.size(), m_indices.size() / 3);
+        fflush(stdout);
+        objectDataVersion = nextVersion();
+        return;
+    }
+
     importFile(filename);
+    computeBoundingSphere();
+
+    if(useMeshCache && !PixelMeshCache::save(fileLocation, m_vertices, m_indices, m_submeshes, m_objectData.boundingSphere))
+    {
+        printf("Could not write the mesh cache of %s\n", filename.c_str());
+        fflush(stdout);
+    }
 }
 
-void PixelObject::importFile(const std::string& filename) {
+void PixelObject::computeBoundingSphere() {
+
+    if(m_vertices.empty())
+    {
+        m_objectData.boundingSphere = glm::vec4(0.0f);
+        objectDataVersion = nextVersion();
+        return;
+    }
+
+    //center of the bounding box, radius to the farthest vertex
+    glm::vec3 minCorner = glm::vec3(m_vertices[0].position);
+    glm::vec3 maxCorner = minCorner;
+    for(const auto& vertex : m_vertices)
+    {
+        minCorner = glm::min(minCorner, glm::vec3(vertex.position));
+        maxCorner = glm::max(maxCorner, glm::vec3(vertex.position));
+    }
+
+    glm::vec3 center = (minCorner + maxCorner) * 0.5f;
+    float radiusSquared = 0.0f;
+    for(const auto& vertex : m_vertices)
+    {
+        glm::vec3 offset = glm::vec3(vertex.position) - center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+
+    m_objectData.boundingSphere = glm::vec4(center, std::sqrt(radiusSquared));
+    objectDataVersion = nextVersion();
+
+    //packed positions are relative to the bounds
+    if(m_vertexFormat == VERTEX_FORMAT_PACKED)
+    {
+        packVertices();
+    }
+}
+
+static int16_t quantizeSnorm16(float value)
+{
+    return static_cast<int16_t>(std::lround(glm::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+static uint8_t quantizeUnorm8(float value)
+{
+    return static_cast<uint8_t>(std::lround(glm::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+//unit vector to the [-1,1] square: project on the octahedron, fold the lower half over the upper one
+static glm::vec2 encodeOctahedral(glm::vec3 normal)
+{
+    float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if(length == 0.0f)
+    {
+        return glm::vec2(0.0f);
+    }
+
+    glm::vec2 encoded = glm::vec2(normal.x, normal.y) / length;
+    if(normal.z < 0.0f)
+    {
+        glm::vec2 folded = 1.0f - glm::abs(glm::vec2(encoded.y, encoded.x));
+        encoded.x = encoded.x >= 0.0f ? folded.x : -folded.x;
+        encoded.y = encoded.y >= 0.0f ? folded.y : -folded.y;
+    }
+    return encoded;
+}
+
+void PixelObject::packVertices() {
+
+    glm::vec3 center = glm::vec3(m_objectData.boundingSphere);
+    float radius = m_objectData.boundingSphere.w;
+    float invRadius = radius > 0.0f ? 1.0f / radius : 0.0f;
+
+    m_packedVertices.resize(m_vertices.size());
+    for(size_t i = 0; i < m_vertices.size(); i++)
+    {
+        const Vertex& vertex = m_vertices[i];
+        PackedVertex& packed = m_packedVertices[i];
 
+        glm::vec3 position = (glm::vec3(vertex.position) - center) * invRadius;
+        packed.position[0] = quantizeSnorm16(position.x);
+        packed.position[1] = quantizeSnorm16(position.y);
+        packed.position[2] = quantizeSnorm16(position.z);
+        packed.position[3] = quantizeSnorm16(1.0f);
 
+        glm::vec2 normal = encodeOctahedral(glm::vec3(vertex.normal));
+        packed.normal[0] = quantizeSnorm16(normal.x);
+        packed.normal[1] = quantizeSnorm16(normal.y);
+
+        for(int c = 0; c < 4; c++)
+        {
+            packed.color[c] = quantizeUnorm8(vertex.color[c]);
+        }
+
+        packed.texUV[0] = glm::packHalf1x16(vertex.texUV.x);
+        packed.texUV[1] = glm::packHalf1x16(vertex.texUV.y);
+    }
+}
 
-    enum Point {POSITION, TEXTURE, NORMAL};
+void PixelObject::importFile(const std::string& filename) {
 
     std::string fileLocation = "objects/" + filename;
 
@@ -95,44 +262,65 @@ void PixelObject::importFile(const std::string& filename) {
     const aiScene* scene = importer.ReadFile( fileLocation,
                                               aiProcess_CalcTangentSpace       |
                                               aiProcess_Triangulate|
+                                              aiProcess_JoinIdenticalVertices|
                                               aiProcess_FlipUVs);
 
     if (nullptr == scene) {
         throw std::runtime_error( importer.GetErrorString());
     }
 
-    int vertCounter = 0;
-    int indxCounter = 0;
-    for(int m = 0; m < scene->mNumMeshes; m++)
+    uint32_t vertCounter = 0;
+    uint32_t indxCounter = 0;
+    for(uint32_t m = 0; m < scene->mNumMeshes; m++)
     {
-        vertCounter+=scene->mMeshes[m]->mNumVertices;
-        indxCounter+= (scene->mMeshes[m]->mNumFaces * 3);
+        vertCounter += scene->mMeshes[m]->mNumVertices;
+        indxCounter += (scene->mMeshes[m]->mNumFaces * 3);
     }
+    m_vertices.reserve(vertCounter);
+    m_indices.reserve(indxCounter);
 
-    for(int m = 0; m < scene->mNumMeshes; m++)
+    //the meshes are appended one after the other, their face indices are offset by the vertices already added
+    for(uint32_t m = 0; m < scene->mNumMeshes; m++)
     {
-        for(int f = 0; f < scene->mMeshes[m]->mNumFaces; f++)
+        const aiMesh* mesh = scene->mMeshes[m];
+        auto baseVertex = static_cast<uint32_t>(m_vertices.size());
+
+        Submesh submesh{};
+        submesh.firstIndex = static_cast<uint32_t>(m_indices.size());
+        submesh.materialIndex = mesh->mMaterialIndex;
+
+        for(uint32_t f = 0; f < mesh->mNumFaces; f++)
         {
-            for(int i = 0; i < scene->mMeshes[m]->mFaces[f].mNumIndices; i++)
+            //points and lines are left out, the pipelines draw triangle lists
+            if(mesh->mFaces[f].mNumIndices != 3)
             {
-                m_indices.push_back(m_indices.size());
+                continue;
+            }
+            for(uint32_t i = 0; i < 3; i++)
+            {
+                m_indices.push_back(baseVertex + mesh->mFaces[f].mIndices[i]);
             }
         }
+        submesh.indexCount = static_cast<uint32_t>(m_indices.size()) - submesh.firstIndex;
+        m_submeshes.push_back(submesh);
 
-        for(int i = 0; i<scene->mMeshes[m]->mNumVertices; i++)
+        for(uint32_t i = 0; i < mesh->mNumVertices; i++)
         {
             Vertex v;
-            v.position = glm::vec4(scene->mMeshes[m]->mVertices[i].x,
-                                   scene->mMeshes[m]->mVertices[i].y,
-                                   scene->mMeshes[m]->mVertices[i].z,1.0f);
-            v.normal = glm::vec4(scene->mMeshes[m]->mNormals[i].x,
-                                 scene->mMeshes[m]->mNormals[i].y,
-                                 scene->mMeshes[m]->mNormals[i].z,0.0f);
-
-            if(scene->mMeshes[m]->HasTextureCoords(0))
+            v.position = glm::vec4(mesh->mVertices[i].x,
+                                   mesh->mVertices[i].y,
+                                   mesh->mVertices[i].z,1.0f);
+            if(mesh->HasNormals())
             {
-                v.texUV = glm::vec2(scene->mMeshes[m]->mTextureCoords[0][i].x,
-                                    scene->mMeshes[m]->mTextureCoords[0][i].y);
+                v.normal = glm::vec4(mesh->mNormals[i].x,
+                                     mesh->mNormals[i].y,
+                                     mesh->mNormals[i].z,0.0f);
+            }
+
+            if(mesh->HasTextureCoords(0))
+            {
+                v.texUV = glm::vec2(mesh->mTextureCoords[0][i].x,
+                                    mesh->mTextureCoords[0][i].y);
             }
 
             v.color = glm::vec4(1.0f, 0.0f, 1.0f, 1.0f);
@@ -141,25 +329,101 @@ void PixelObject::importFile(const std::string& filename) {
         }
     }
 
+    //assimp only joins vertices inside a mesh, the ones shared between meshes are welded here
+    size_t importedVertexCount = m_vertices.size();
+    weldVertices();
+
+    printf("Imported %s: %zu face corners, %zu vertices from assimp, %zu after welding, %zu triangles\n",
+           filename.c_str(), m_indices.size(), importedVertexCount, m_vertices.size(), m_indices.size() / 3);
 
+    optimizeMesh(filename);
+    fflush(stdout);
 }
 
-void PixelObject::addTransform(glm::mat4 matTransform) {
-    pushObj.M = matTransform * pushObj.M;
-    pushObj.MinvT = glm::transpose(glm::inverse(pushObj.M));
+void PixelObject::optimizeMesh(const std::string& meshName) {
+
+    PixelMeshOptimizer::CacheStats before = PixelMeshOptimizer::analyzeVertexCache(m_indices, m_vertices.size());
+
+    //triangles are only reordered inside their submesh so the submesh table stays valid
+    std::vector<uint32_t> submeshIndices;
+    for(const auto& submesh : m_submeshes)
+    {
+        auto first = m_indices.begin() + submesh.firstIndex;
+        submeshIndices.assign(first, first + submesh.indexCount);
+        PixelMeshOptimizer::optimizeVertexCache(submeshIndices, m_vertices.size());
+        PixelMeshOptimizer::optimizeOverdraw(submeshIndices, m_vertices, OVERDRAW_ACMR_THRESHOLD);
+        std::copy(submeshIndices.begin(), submeshIndices.end(), first);
+    }
+    PixelMeshOptimizer::optimizeVertexFetch(m_vertices, m_indices); //last, the triangle order is final
+
+    PixelMeshOptimizer::CacheStats after = PixelMeshOptimizer::analyzeVertexCache(m_indices, m_vertices.size());
+    printf("Optimized %s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%u entry fifo)\n",
+           meshName.c_str(), before.acmr, after.acmr, before.atvr, after.atvr, VERTEX_CACHE_SIZE);
 }
 
-void PixelObject::setTransform(glm::mat4 matTransform) {
-    pushObj.M = matTransform;
-    pushObj.MinvT = glm::transpose(glm::inverse(pushObj.M));
+void PixelObject::weldVertices() {
+
+    //vertices are compared bit for bit. the struct has no padding (vec4, vec4, vec4, vec2)
+    struct VertexHash
+    {
+        size_t operator()(const Vertex& vertex) const
+        {
+            //FNV-1a over the bytes of the vertex
+            const auto* bytes = reinterpret_cast<const unsigned char*>(&vertex);
+            uint64_t hash = 14695981039346656037ull;
+            for(size_t i = 0; i < sizeof(Vertex); i++)
+            {
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            }
+            return static_cast<size_t>(hash);
+        }
+    };
+    struct VertexEqual
+    {
+        bool operator()(const Vertex& a, const Vertex& b) const
+        {
+            return memcmp(&a, &b, sizeof(Vertex)) == 0;
+        }
+    };
+
+    std::unordered_map<Vertex, uint32_t, VertexHash, VertexEqual> uniqueVertices;
+    uniqueVertices.reserve(m_vertices.size());
+
+    std::vector<Vertex> weldedVertices;
+    weldedVertices.reserve(m_vertices.size());
+    std::vector<uint32_t> remap(m_vertices.size());
+
+    for(size_t i = 0; i < m_vertices.size(); i++)
+    {
+        auto inserted = uniqueVertices.emplace(m_vertices[i], static_cast<uint32_t>(weldedVertices.size()));
+        if(inserted.second)
+        {
+            weldedVertices.push_back(m_vertices[i]);
+        }
+        remap[i] = inserted.first->second;
+    }
+
+    for(auto& index : m_indices)
+    {
+        index = remap[index];
+    }
+    m_vertices = std::move(weldedVertices);
+}
+
+void PixelObject::addTransform(glm::mat4 matTransform) {
+    m_objectData.M = matTransform * m_objectData.M;
+    m_objectData.MinvT = glm::transpose(glm::inverse(m_objectData.M));
+    objectDataVersion = nextVersion();
 }
 
-void PixelObject::setPushObj(PixelObject::PObj pushObjData) {
-    pushObj = PObj(pushObjData);
+void PixelObject::setTransform(glm::mat4 matTransform) {
+    m_objectData.M = matTransform;
+    m_objectData.MinvT = glm::transpose(glm::inverse(m_objectData.M));
+    objectDataVersion = nextVersion();
 }
 
-PixelObject::DynamicUBObj* PixelObject::getDynamicUBObj() {
-    return &dynamicUBO;
+const PixelObject::ObjectData* PixelObject::getObjectData() {
+    return &m_objectData;
 }
 
 void PixelObject::addTexture(std::string textureFile) {
@@ -21,16 +21,27 @@
 class PixelObject {
 public:
 
-    // this should noe change every frame, but can change per individual object/mesh.
-    //Dynamic Uniform Buffer Object
-    struct DynamicUBObj{
-        glm::mat4 M{};
-        glm::mat4 MinvT{};
+    //how the vertices of an object are stored in the vertex buffer
+    enum VertexFormat
+    {
+        VERTEX_FORMAT_FULL, //Vertex
+        VERTEX_FORMAT_PACKED, //PackedVertex
+        VERTEX_FORMAT_COUNT
+    };
+
+    //per object record of the scene's object table (storage buffer), indexed by the instance index of the draw.
+    //layout must match ObjectData in the vertex shaders (std430)
+    struct ObjectData{
+        glm::mat4 M = glm::mat4(1.0f);
+        glm::mat4 MinvT = glm::mat4(1.0f);
+        glm::vec4 boundingSphere = glm::vec4(0.0f); //object space center (xyz) and radius (w), used by the culling pass
         int texIndex = -1;
+        int materialIndex = 0;
+        int vertexFormat = VERTEX_FORMAT_FULL; //tells the vertex shader how to read the attributes
+        int padding{};
     };
 
-    // this can change every frame, and can change per individual object/mesh.
-    //Dynamic Uniform Buffer Object
+    //push constant block, only used by pipelines that draw without the object table (grid)
     struct PObj{
         glm::mat4 M{};
         glm::mat4 MinvT{};
@@ -45,6 +56,23 @@ public:
         glm::vec2 texUV{};
     };
 
+    //quantized copy of a Vertex, 20 bytes instead of 56. the vertex shader dequantizes it
+    struct PackedVertex
+    {
+        int16_t position[4]; //snorm16, relative to the bounding sphere (center + position * radius), w is 1
+        int16_t normal[2]; //snorm16, octahedral encoding of the unit normal
+        uint8_t color[4]; //unorm8
+        uint16_t texUV[2]; //half float
+    };
+
+    //triangles of one mesh of an imported file
+    struct Submesh
+    {
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        uint32_t materialIndex = 0; //material of the source file
+    };
+
     enum vertexAttributes
     {
         POSITION_ATTRIBUTEINDEX,
@@ -56,30 +84,35 @@ public:
 
 
     PixelObject(PixBackend* device, std::vector<Vertex> vertices, std::vector<uint32_t> indices);
-    PixelObject(PixBackend* device, std::string filename);
+    PixelObject(PixBackend* device, std::string filename, bool useMeshCache = true);
 
     //getters
     int getVertexCount();
     std::vector<Vertex>* getVertices();
-    VkDeviceSize getVertexBufferSize();
-    VkBuffer* getVertexBuffer();
-    VkDeviceMemory* getVertexBufferMemory();
+    VkDeviceSize getVertexBufferSize(); //of the vertices in the object's format
+    const void* getVertexData(); //vertices in the object's format
+    VertexFormat getVertexFormat(){return m_vertexFormat;}
+    static VkDeviceSize getVertexStride(VertexFormat vertexFormat);
     int getIndexCount();
     std::vector<uint32_t>* getIndices();
     VkDeviceSize getIndexBufferSize();
-    VkBuffer* getIndexBuffer();
-    VkDeviceMemory* getIndexBufferMemory();
-    PObj* getPushObj();
-    DynamicUBObj* getDynamicUBObj();
-    std::vector<PixelImage> getTextures(){return m_textures;}
+    uint32_t getFirstIndex(){return m_firstIndex;}
+    int32_t getVertexOffset(){return m_vertexOffset;}
+    const ObjectData* getObjectData();
+    uint32_t getObjectDataVersion(){return objectDataVersion;};
+    uint32_t getDrawStateVersion(){return drawStateVersion;};
+    std::vector<PixelImage>* getTextures(){return &m_textures;}
+    std::vector<Submesh>* getSubmeshes(){return &m_submeshes;}
     int getGraphicsPipelineIndex(){return graphicsPipelineIndex;};
     static constexpr VkPushConstantRange pushConstantRange {VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PObj)};
 
     //setters
-    void setDynamicUBObj(DynamicUBObj pushObjData);
-    void setTexID(int texID){dynamicUBO.texIndex = texID;};
-    void setPushObj(PObj pushObjData);
-    void setGraphicsPipelineIndex(int pipelineIndx){graphicsPipelineIndex = pipelineIndx;};
+    void setObjectData(ObjectData objectData);
+    void setTexID(int texID){m_objectData.texIndex = texID; objectDataVersion = nextVersion();};
+    void setMaterialIndex(int materialIndex){m_objectData.materialIndex = materialIndex; objectDataVersion = nextVersion();};
+    void setGraphicsPipelineIndex(int pipelineIndx);
+    void setVertexFormat(VertexFormat vertexFormat); //before the scene's geometry buffers are created
+    void setGeometryOffsets(uint32_t firstIndex, int32_t vertexOffset){m_firstIndex = firstIndex; m_vertexOffset = vertexOffset;};
 
     //cleanup
     void cleanup();
@@ -88,14 +121,17 @@ public:
     //helper functions
     //returns the number of members of the Vertex Struct
     void importFile(const std::string& filename);
+    void weldVertices(); //merges identical vertices and remaps the indices
+    void optimizeMesh(const std::string& meshName); //reorders triangles and vertices for the post transform cache
+    void computeBoundingSphere();
+    void packVertices();
     void setGenericColor(glm::vec4 color);
     void addTransform(glm::mat4 matTransform);
     void setTransform(glm::mat4 matTransform);
     void addTexture(std::string textureFile);
     void addTexture(PixelImage* pixImage);
-    void setTextureIDOffset(int offset){texIDOffset = offset;};
-    void hide(){m_isHidden = true;};
-    void unhide(){m_isHidden = false;};
+    void hide();
+    void unhide();
     bool isHidden(){return m_isHidden;};
 
 
@@ -103,26 +139,31 @@ private:
     //member variables
     std::vector<Vertex> m_vertices{};
     std::vector<uint32_t> m_indices{};
+    std::vector<PackedVertex> m_packedVertices{}; //only filled with the packed format
+    std::vector<Submesh> m_submeshes{};
+    VertexFormat m_vertexFormat = VERTEX_FORMAT_FULL;
     std::string name{};
     bool m_isHidden = false;
 
     //transforms
-    DynamicUBObj dynamicUBO = {};
-    PObj pushObj = {glm::mat4(1.0f)};
+    ObjectData m_objectData = {};
+    //bumped on every change so the scene only rewrites objects that changed. taken from a counter shared by all objects
+    static uint32_t nextVersion();
+    uint32_t objectDataVersion = nextVersion();
+    uint32_t drawStateVersion = nextVersion(); //bumped when the recorded draws change (visibility, pipeline)
 
     //vulkan components
     PixBackend* m_device = VK_NULL_HANDLE;
-    VkBuffer vertexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
-    VkBuffer indexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+
+    //where the mesh lives in the scene's shared vertex and index buffers
+    uint32_t m_firstIndex = 0;
+    int32_t m_vertexOffset = 0;
 
     //texture used
     std::vector<PixelImage> m_textures;
-    int texIDOffset = 0;
 
     //pipeline used
-    int graphicsPipelineIndex;
+    int graphicsPipelineIndex = 0;
 };
 
 
@@ -3,6 +3,9 @@
 #include "PixelRenderer.h"
 
 #include <cmath>
+#include <chrono>
+#include <filesystem>
+#include <cctype>
 #include <cstdio>
 #include <glm/gtc/matrix_transform.hpp>
 #include "kb_input.h"
@@ -44,27 +47,74 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 int PixelRenderer::initRenderer()
 {
 	pixWindow.initWindow("PixelRenderer", 960, 480);
+	return initVulkan();
+}
+
+int PixelRenderer::initHeadlessRenderer(uint32_t width, uint32_t height)
+{
+    //no window, no surface and no swapchain. frames are rendered to offscreen images and read back to host memory
+    headless = true;
+    headlessExtent = {width, height};
+
+    //the swapchain extension is not needed (and might not be exposed by a software ICD such as lavapipe)
+    deviceExtensions.erase(std::remove_if(deviceExtensions.begin(), deviceExtensions.end(),
+                                          [](const char* extension){ return strcmp(extension, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0; }),
+                           deviceExtensions.end());
+
+    return initVulkan();
+}
+
+int PixelRenderer::initBenchmarkRenderer(uint32_t width, uint32_t height, uint32_t objectCount)
+{
+    //headless, with objectCount more objects in the default scene
+    benchmarkObjectCount = objectCount;
+    return initHeadlessRenderer(width, height);
+}
+
+int PixelRenderer::initVulkan()
+{
 	try {
         createInstance();
-		createSurface();
+        if(!headless)
+        {
+            createSurface();
+        }
 		setupDebugMessenger();
 		setupPhysicalDevice();
 		createLogicalDevice();
-        createSwapChain();
+        memoryAllocator.init(&mainDevice);
+        mainDevice.allocator = &memoryAllocator;
+        if(headless)
+        {
+            createOffscreenTargets();
+        } else
+        {
+            createSwapChain();
+        }
         createDepthBuffer();
-        createCommandPools();
+        jobSystem.init(std::min(MAX_RECORDING_THREADS, std::max(std::thread::hardware_concurrency(), 1u)) - 1); //the main thread records too
+        createCommandPools(); //one recording pool per job system thread
+        uploadBatcher.init(&mainDevice, graphicsQueue, setupQueueFamilies(mainDevice.physicalDevice).graphicsFamily);
+        assetLoader.init(&mainDevice, &jobSystem, &uploadBatcher);
         createTextureSampler();
+        textureTable.init(&mainDevice, imageSampler, MAX_FRAME_DRAWS);
+        mainDevice.textureTable = &textureTable;
+        textureStreamer.init(&mainDevice, &uploadBatcher, &textureTable, MAX_FRAME_DRAWS);
         createCommandBuffers();
         createComputeCommandBuffers();
-        init_compute();
         createDefaultGridScene();
         createScene();
+        init_compute(); //traces an object of the scene
         initializeScenes();
+        init_culling(); //needs the depth buffer
         createGraphicsPipelines(); //needs the descriptor set layout of the scene
         createFramebuffers(); //need the renderbuffer for the graphics pipeline
         createSynchronizationObjects();
-        init_io();
-        init_imgui();
+        if(!headless)
+        {
+            init_io();
+            init_imgui();
+        }
 	}
 	catch(const std::runtime_error &e)
 	{
@@ -83,11 +133,13 @@ bool PixelRenderer::windowShouldClose()
 void PixelRenderer::cleanup()
 {
     vkDeviceWaitIdle(mainDevice.logicalDevice); //wait that no action is running before destroying the objects
+    uploadBatcher.cleanUp();
 
     vkDestroySampler(mainDevice.logicalDevice, imageSampler, nullptr);
 
     emptyTexture.cleanUp();
     computePipeline.cleanUp();
+    cullingPipeline.cleanUp();
 
     for(auto scene : scenes)
     {
@@ -95,9 +147,17 @@ void PixelRenderer::cleanup()
     }
 
     defaultGridScene.cleanup();
+    textureStreamer.cleanUp();
+    textureTable.cleanUp();
 
-    vkDestroyDescriptorPool(mainDevice.logicalDevice, imguiPool, nullptr);
-    ImGui_ImplVulkan_Shutdown();
+    if(headless)
+    {
+        memoryAllocator.destroyBuffer(&readbackBuffer, &readbackBufferAllocation);
+    } else
+    {
+        vkDestroyDescriptorPool(mainDevice.logicalDevice, imguiPool, nullptr);
+        ImGui_ImplVulkan_Shutdown();
+    }
 
     for(size_t i = 0; i<MAX_FRAME_DRAWS; i++)
     {
@@ -110,6 +170,11 @@ void PixelRenderer::cleanup()
 
     vkDestroyCommandPool(mainDevice.logicalDevice, graphicsCommandPool, nullptr);
     vkDestroyCommandPool(mainDevice.logicalDevice, computeCommandPool, nullptr);
+    for(auto recordingCommandPool : recordingCommandPools)
+    {
+        vkDestroyCommandPool(mainDevice.logicalDevice, recordingCommandPool, nullptr);
+    }
+    jobSystem.cleanUp();
 
     for (auto frameBuffer : swapchainFramebuffers)
     {
@@ -120,6 +185,10 @@ void PixelRenderer::cleanup()
     {
         graphicsPipeline->cleanUp();
     }
+    for (const auto& graphicsPipeline : packedGraphicsPipelines)
+    {
+        graphicsPipeline->cleanUp();
+    }
 
     defaultGridGraphicsPipeline->cleanUp();
 
@@ -130,8 +199,12 @@ void PixelRenderer::cleanup()
 		image.cleanUp();
 	}
 
-	vkDestroySwapchainKHR(mainDevice.logicalDevice, swapChain, nullptr);
-	vkDestroySurfaceKHR(instance, surface, nullptr);
+    if(!headless)
+    {
+        vkDestroySwapchainKHR(mainDevice.logicalDevice, swapChain, nullptr);
+        vkDestroySurfaceKHR(instance, surface, nullptr);
+    }
+    memoryAllocator.cleanUp();
 	vkDestroyDevice(mainDevice.logicalDevice, nullptr);
 	if (enableValidationLayers) {
 		DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
@@ -162,8 +235,8 @@ void PixelRenderer::createInstance()
 #endif
 	createInfo.pApplicationInfo = &appInfo;
 
-	// create list to hold instance extension
-	std::vector<const char*> instanceExtensions = getRequiredExtensions();
+	// create list to hold instance extension (glfw is not initialized when running headless)
+	std::vector<const char*> instanceExtensions = headless ? std::vector<const char*>{} : getRequiredExtensions();
 
     if (enableValidationLayers) {
         instanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -233,7 +306,7 @@ void PixelRenderer::setupPhysicalDevice()
 	{
 		if (checkIfPhysicalDeviceSuitable(device))
 		{
-			mainDevice.physicalDevice = deviceList[0];
+			mainDevice.physicalDevice = device;
 			break;
 		}
 	}
@@ -284,8 +357,58 @@ void PixelRenderer::createLogicalDevice()
         deviceFeatures.samplerAnisotropy = VK_TRUE; //enable the anisotropy filtering
     }
 
+    //scene objects are drawn with indirect commands. the object index goes through the command's first instance
+    if(supportedDeviceFeatures.drawIndirectFirstInstance != VK_TRUE)
+    {
+        throw std::runtime_error("the device does not support a first instance in indirect draws");
+    }
+    deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+
+    //the fragment shaders report the mip levels they sample for the texture streamer
+    if(supportedDeviceFeatures.fragmentStoresAndAtomics != VK_TRUE)
+    {
+        throw std::runtime_error("the device does not support stores and atomics in fragment shaders");
+    }
+    deviceFeatures.fragmentStoresAndAtomics = VK_TRUE;
+    deviceFeatures.multiDrawIndirect = supportedDeviceFeatures.multiDrawIndirect;
+    multiDrawIndirectSupported = (supportedDeviceFeatures.multiDrawIndirect == VK_TRUE);
+
+    //block compressed textures, they are uploaded as rgba8 without it
+    deviceFeatures.textureCompressionBC = supportedDeviceFeatures.textureCompressionBC;
+    mainDevice.textureCompressionBC = (supportedDeviceFeatures.textureCompressionBC == VK_TRUE);
+
     deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 
+    //descriptor indexing (core in 1.2) for the bindless texture table
+    VkPhysicalDeviceVulkan12Features supportedVulkan12Features{};
+    supportedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceFeatures2 supportedDeviceFeatures2{};
+    supportedDeviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedDeviceFeatures2.pNext = &supportedVulkan12Features;
+    vkGetPhysicalDeviceFeatures2(mainDevice.physicalDevice, &supportedDeviceFeatures2);
+
+    if(supportedVulkan12Features.runtimeDescriptorArray != VK_TRUE ||
+       supportedVulkan12Features.descriptorBindingPartiallyBound != VK_TRUE ||
+       supportedVulkan12Features.descriptorBindingSampledImageUpdateAfterBind != VK_TRUE ||
+       supportedVulkan12Features.descriptorBindingUpdateUnusedWhilePending != VK_TRUE ||
+       supportedVulkan12Features.shaderSampledImageArrayNonUniformIndexing != VK_TRUE)
+    {
+        throw std::runtime_error("the device does not support the descriptor indexing features needed for the texture table");
+    }
+
+    enabledVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    enabledVulkan12Features.runtimeDescriptorArray = VK_TRUE;
+    enabledVulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+    enabledVulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    enabledVulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    enabledVulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+
+    //the draw count of indirect draws can come from a buffer when supported, the cpu count is used otherwise
+    enabledVulkan12Features.drawIndirectCount = supportedVulkan12Features.drawIndirectCount;
+    drawIndirectCountSupported = (supportedVulkan12Features.drawIndirectCount == VK_TRUE);
+    deviceCreateInfo.pNext = &enabledVulkan12Features;
+
 	//create logical device for the given phyisical device
 	VkResult result = vkCreateDevice(mainDevice.physicalDevice, &deviceCreateInfo, nullptr, &mainDevice.logicalDevice);
 	if (result != VK_SUCCESS)
@@ -397,6 +520,29 @@ void PixelRenderer::createSwapChain()
     //now that we swapchain image have been
 }
 
+void PixelRenderer::createOffscreenTargets()
+{
+    printf("Creating Offscreen Render Targets\n");
+    fflush(stdout);
+
+    //the offscreen images stand in for the swapchain images. everything sized on the swapchain (framebuffers, command buffers, uniform buffers) is reused as is
+    swapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    swapChainExtent = headlessExtent;
+
+    for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+    {
+        PixelImage offscreenImage = {&mainDevice, swapChainExtent.width, swapChainExtent.height, false};
+        offscreenImage.loadEmptyTexture(swapChainExtent.width, swapChainExtent.height,
+                                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+        swapChainImages.push_back(offscreenImage);
+    }
+
+    //host visible buffer the rendered frames are copied into
+    createBuffer(swapChainImages[0].getImageBufferSize(),
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 &readbackBuffer, &readbackBufferAllocation);
+}
+
 void PixelRenderer::setupDebugMessenger()
 {
     printf("Creating Vulkan Debug Messenger\n");
@@ -438,9 +584,16 @@ QueueFamilyIndices PixelRenderer::setupQueueFamilies(VkPhysicalDevice device)
             indices.computeFamily = i;
         }
 
-		//check if queue family supports presentation
+		//check if queue family supports presentation. there is nothing to present to when running headless
 		VkBool32 presentationSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentationSupport);
+		if (headless)
+		{
+			presentationSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		}
+		else
+		{
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentationSupport);
+		}
 
 		if (queueFamilyCount > 0 && presentationSupport)
 		{
@@ -471,8 +624,8 @@ bool PixelRenderer::checkIfPhysicalDeviceSuitable(VkPhysicalDevice device)
 	QueueFamilyIndices indices = setupQueueFamilies(device);
 
 	bool extensionsSupported = checkDeviceExtensionSupport(device);
-	bool swapChainValid = false;
-	if (extensionsSupported)
+	bool swapChainValid = headless; //offscreen targets do not depend on a surface
+	if (extensionsSupported && !headless)
 	{
         SwapchainDetails swapChainDetails = getSwapChainDetails(device);
         swapChainValid = !swapChainDetails.format.empty() && !swapChainDetails.presentationMode.empty();
@@ -586,8 +739,10 @@ void PixelRenderer::createGraphicsPipelines() {
     graphicsPipeline1->addVertexShader("shaders/vert.spv");
     graphicsPipeline1->addFragmentShader("shaders/frag.spv");
     graphicsPipeline1->populateGraphicsPipelineInfo();
+    //offscreen targets are copied back to the host instead of being presented
+    VkImageLayout colorFinalLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
     graphicsPipeline1->addRenderpassColorAttachment(swapChainImages[0].getFormat(),
-                                                   VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                                   VK_IMAGE_LAYOUT_UNDEFINED, colorFinalLayout,
                                                    VK_ATTACHMENT_STORE_OP_STORE,
                                                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
     graphicsPipeline1->addRenderpassDepthAttachment(depthImage.getFormat());
@@ -606,7 +761,18 @@ void PixelRenderer::createGraphicsPipelines() {
 
     defaultGridGraphicsPipeline->createGraphicsPipeline(graphicsPipeline1->getRenderPass()); //creates a renderpass if none were provided
 
+    //same pipeline reading packed vertices, it draws in the same renderpass
+    auto packedGraphicsPipeline1 = std::make_unique<PixelGraphicsPipeline>(mainDevice.logicalDevice, swapChainExtent);
+    packedGraphicsPipeline1->addVertexShader("shaders/vert.spv");
+    packedGraphicsPipeline1->addFragmentShader("shaders/frag.spv");
+    packedGraphicsPipeline1->populateGraphicsPipelineInfo(PixelObject::VERTEX_FORMAT_PACKED);
+    packedGraphicsPipeline1->addRenderpassDepthAttachment(depthImage.getFormat());
+    packedGraphicsPipeline1->populatePipelineLayout(&scenes[0]);
+
+    packedGraphicsPipeline1->createGraphicsPipeline(graphicsPipeline1->getRenderPass());
+
     graphicsPipelines.push_back(std::move(graphicsPipeline1));
+    packedGraphicsPipelines.push_back(std::move(packedGraphicsPipeline1));
 
 }
 
@@ -669,6 +835,18 @@ void PixelRenderer::createCommandPools() {
     {
         throw std::runtime_error("Failed to create Compute Command Pool");
     }
+
+    //command pools are not thread safe, every thread recording the scene gets its own
+    recordingCommandPools.resize(jobSystem.getThreadCount());
+    for(auto& recordingCommandPool : recordingCommandPools)
+    {
+        result = vkCreateCommandPool(mainDevice.logicalDevice, &poolCreateInfo, nullptr, &recordingCommandPool);
+        if(result != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create Recording Command Pool");
+        }
+    }
+    recordingThreadCount = static_cast<uint32_t>(recordingCommandPools.size());
 }
 
 void PixelRenderer::createCommandBuffers() {
@@ -689,9 +867,49 @@ void PixelRenderer::createCommandBuffers() {
     {
         throw std::runtime_error("failed to allocate command buffers");
     }
+    //the gui is recorded on its own every frame so it does not force the scene to be recorded again
+    guiCommandBuffers.resize(swapChainImages.size());
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    commandBufferAllocateInfo.commandBufferCount = static_cast<uint32_t>(guiCommandBuffers.size());
+
+    result = vkAllocateCommandBuffers(mainDevice.logicalDevice, &commandBufferAllocateInfo, guiCommandBuffers.data());
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate gui command buffers");
+    }
     //no need to dealocate or destroyed the command buffers. they are destroy along the command pool
 }
 
+void PixelRenderer::createSceneCommandBuffers() {
+
+    //one secondary command buffer per scene, swapchain image and recording thread, recorded when the scene changes.
+    //each thread records from its own pool
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY; //executed from the primary command buffer inside the renderpass
+    commandBufferAllocateInfo.commandBufferCount = 1;
+
+    while(sceneCommandBuffers.size() < scenes.size())
+    {
+        std::vector<std::vector<VkCommandBuffer>> sceneBuffers(swapChainImages.size(), std::vector<VkCommandBuffer>(recordingCommandPools.size()));
+        for(auto& imageBuffers : sceneBuffers)
+        {
+            for(size_t thread = 0; thread < recordingCommandPools.size(); thread++)
+            {
+                commandBufferAllocateInfo.commandPool = recordingCommandPools[thread];
+                VkResult result = vkAllocateCommandBuffers(mainDevice.logicalDevice, &commandBufferAllocateInfo, &imageBuffers[thread]);
+                if(result != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to allocate scene command buffers");
+                }
+            }
+        }
+
+        sceneCommandBuffers.push_back(sceneBuffers);
+        recordedSceneVersions.emplace_back(swapChainImages.size(), 0); //0 is never a valid version, every buffer gets recorded once
+    }
+}
+
 void PixelRenderer::createComputeCommandBuffers() {
 
     printf("Creating Vulkan Command Buffer for Compute Shader\n");
@@ -715,11 +933,34 @@ void PixelRenderer::createComputeCommandBuffers() {
 
 void PixelRenderer::recordCommands(uint32_t currentImageIndex) {
 
+    //the scene draws live in secondary command buffers that are kept until the scene changes
+    if(sceneCommandBuffers.size() < scenes.size())
+    {
+        createSceneCommandBuffers();
+    }
+
+    for(int sceneIndx = 0; sceneIndx < scenes.size(); sceneIndx++)
+    {
+        uint64_t drawStateVersion = scenes[sceneIndx].getDrawStateVersion() + defaultGridScene.getDrawStateVersion();
+        if(recordedSceneVersions[sceneIndx][currentImageIndex] != drawStateVersion)
+        {
+            recordSceneCommands(sceneIndx, currentImageIndex);
+            recordedSceneVersions[sceneIndx][currentImageIndex] = drawStateVersion;
+        }
+    }
+
+    //the gui changes every frame, it gets its own secondary command buffer
+    bool hasGui = draw_data != nullptr; //there is no gui when running headless
+    if(hasGui)
+    {
+        recordGuiCommands(currentImageIndex);
+    }
+
     //info about how to begin each command buffer
     VkCommandBufferBeginInfo bufferBeginInfo{};
     bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    //flag not needed because fences are now implemented; no commandbuffer for the same frame will be submitted twice.
-    //bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT; //if one of our command buffer is already on the queue, can it be in submitted again.
+    //the primary only holds a handful of commands, it is recorded again every frame
+    bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
     //the clear values for the renderpass attachment
     std::array<VkClearValue,2> clearValues = {};
@@ -745,88 +986,33 @@ void PixelRenderer::recordCommands(uint32_t currentImageIndex) {
          * Series of command to record
          * */
 
+        //cull the main scene's candidates into its indirect buffer before any renderpass reads it
+        cullingPipeline.recordCulling(commandBuffers[currentImageIndex], currentImageIndex, &scenes[0]);
+
         //one pipeline can be attached per subpass. if we say we need to go to another subpass, we need to bind another pipeline.
             //there is one graphics pipeline per scene
             for(int sceneIndx = 0; sceneIndx < scenes.size(); sceneIndx++)
             {
                 renderPassBeginInfo.renderPass = graphicsPipelines[sceneIndx]->getRenderPass();
 
-                //begin the renderpass
+                //begin the renderpass. everything inside comes from secondary command buffers
                 vkCmdBeginRenderPass(commandBuffers[currentImageIndex], &renderPassBeginInfo,
-                                     VK_SUBPASS_CONTENTS_INLINE); //our renderpass contains only primary commands
-
-                for(int objIndex = 0; objIndex < scenes[sceneIndx].getNumObjects(); objIndex++) {
-                    auto currentObject = scenes[sceneIndx].getObjectAt(objIndex);
-                    if(currentObject->isHidden())
-                    {
-                        continue;
-                    }
-                    VkPipeline currentGraphicsPipeline = graphicsPipelines[currentObject->getGraphicsPipelineIndex()]->getPipeline();
-                    VkPipelineLayout currentPipelineLayout = graphicsPipelines[currentObject->getGraphicsPipelineIndex()]->getPipelineLayout();
-
-                    //bind the pipeline
-                    vkCmdBindPipeline(commandBuffers[currentImageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                      currentGraphicsPipeline);
-
-
-                        VkBuffer vertexBuffers[] = {
-                                *(currentObject->getVertexBuffer())}; //buffers to bind
-                        VkBuffer indexBuffer = *currentObject->getIndexBuffer();
-                        VkDeviceSize offsets[] = {0};                                 //offsets into buffers
-                        vkCmdBindVertexBuffers(commandBuffers[currentImageIndex], 0, 1, vertexBuffers, offsets);
-                        vkCmdBindIndexBuffer(commandBuffers[currentImageIndex], indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-
-                        //bind the push constant
-                        vkCmdPushConstants(commandBuffers[currentImageIndex],
-                                           currentPipelineLayout,
-                                           VK_SHADER_STAGE_VERTEX_BIT,
-                                           0,
-                                           PixelObject::pushConstantRange.size,
-                                           currentObject->getPushObj());
-
-                        //dynamic offset ammount
-                        uint32_t dynamicOffset = static_cast<uint32_t>(scenes[sceneIndx].getMinAlignment()) * objIndex;
-
-                        std::array<VkDescriptorSet, 2> descriptorSets = {
-                                *scenes[sceneIndx].getUniformDescriptorSetAt(currentImageIndex),
-                                *scenes[sceneIndx].getTextureDescriptorSet()};
-
-                        //bind the descriptor sets
-                        vkCmdBindDescriptorSets(commandBuffers[currentImageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                                currentPipelineLayout,
-                                                0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(),
-                                                1, &dynamicOffset);
-                        //note here that we bound one descriptor set that contains both a static descriptor and a dynamic descriptor. Only the dynamic descriptors will be off-set for each object, not the static ones.
-
-                        //execute the pipeline
-                        vkCmdDrawIndexed(commandBuffers[currentImageIndex],
-                                         static_cast<uint32_t>(currentObject->getIndexCount()), 1, 0, 0, 0);
-                }
+                                     VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-                if(sceneIndx == 0)
+                std::vector<VkCommandBuffer> secondaryCommandBuffers(sceneCommandBuffers[sceneIndx][currentImageIndex].begin(),
+                                                                     sceneCommandBuffers[sceneIndx][currentImageIndex].begin() + recordingThreadCount);
+                if(sceneIndx == 0 && hasGui)
                 {
-                    ImGui_ImplVulkan_RenderDrawData(draw_data, commandBuffers[currentImageIndex]);
-                }
-
-                //get the grid object from the default scene
-                auto gridObject = defaultGridScene.getObjectAt(0);
-                if(!gridObject->isHidden())
-                {
-
-                    vkCmdBindPipeline(commandBuffers[currentImageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                      defaultGridGraphicsPipeline->getPipeline());
-
-
-                    vkCmdDrawIndexed(commandBuffers[currentImageIndex],
-                                     6, 1, 0, 0, 0);
-
+                    secondaryCommandBuffers.push_back(guiCommandBuffers[currentImageIndex]);
                 }
+                vkCmdExecuteCommands(commandBuffers[currentImageIndex], static_cast<uint32_t>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
 
                 //end the Renderpass
                 vkCmdEndRenderPass(commandBuffers[currentImageIndex]);
             }
 
-
+        //the depth of this frame is what the next frame's culling pass tests against
+        cullingPipeline.recordDepthPyramid(commandBuffers[currentImageIndex]);
 
         /*
          * End of the series of command to record
@@ -840,12 +1026,201 @@ void PixelRenderer::recordCommands(uint32_t currentImageIndex) {
 
 }
 
+void PixelRenderer::recordSceneCommands(int sceneIndx, uint32_t currentImageIndex) {
+
+    //the draws of the scene are split in contiguous ranges, one per thread, each recorded in its own secondary command buffer
+    uint32_t drawCount = 0;
+    for(const auto& group : *scenes[sceneIndx].getDrawGroups())
+    {
+        drawCount += group.drawCount;
+    }
+
+    jobSystem.parallelFor(drawCount, recordingThreadCount, [this, sceneIndx, currentImageIndex](uint32_t rangeIndex, uint32_t begin, uint32_t end){
+        recordSceneCommandRange(sceneIndx, currentImageIndex, rangeIndex, begin, end);
+    });
+}
+
+void PixelRenderer::recordSceneCommandRange(int sceneIndx, uint32_t currentImageIndex, uint32_t rangeIndex, uint32_t firstDraw, uint32_t endDraw) {
+
+    VkCommandBuffer commandBuffer = sceneCommandBuffers[sceneIndx][currentImageIndex][rangeIndex];
+
+    //the secondary runs inside the scene's renderpass on this image's framebuffer
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = graphicsPipelines[sceneIndx]->getRenderPass();
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = swapchainFramebuffers[currentImageIndex];
+
+    VkCommandBufferBeginInfo bufferBeginInfo{};
+    bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    bufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    VkResult result = vkBeginCommandBuffer(commandBuffer, &bufferBeginInfo);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to begin recording the scene commands");
+    }
+
+    PixelScene& currentScene = scenes[sceneIndx];
+
+    //every object of the scene lives in the same vertex and index buffers. state does not carry over between
+    //secondary command buffers, every range binds them again
+    vkCmdBindIndexBuffer(commandBuffer, *currentScene.getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+    VkBuffer indirectBuffer = *currentScene.getIndirectBuffers(currentImageIndex);
+    VkBuffer drawCountBuffer = *currentScene.getDrawCountBuffers(currentImageIndex);
+    bool countedDraws = drawIndirectCountSupported && !perObjectDraws;
+
+    //one indirect draw per pipeline. the commands of a group are contiguous, the culling pass writes them
+    std::vector<PixelScene::DrawGroup>* drawGroups = currentScene.getDrawGroups();
+    uint32_t groupFirstDraw = 0; //first draw of the group across the whole scene
+    for(size_t groupIndex = 0; groupIndex < drawGroups->size(); groupIndex++) {
+        const PixelScene::DrawGroup& group = (*drawGroups)[groupIndex];
+        uint32_t groupEndDraw = groupFirstDraw + group.drawCount;
+
+        //the part of the group that falls in this range. a counted draw can't be split, it goes to the range of its first draw
+        uint32_t rangeFirstDraw = std::max(firstDraw, groupFirstDraw);
+        uint32_t rangeEndDraw = std::min(endDraw, groupEndDraw);
+        if(countedDraws)
+        {
+            rangeFirstDraw = groupFirstDraw;
+            rangeEndDraw = (groupFirstDraw >= firstDraw && groupFirstDraw < endDraw) ? groupEndDraw : groupFirstDraw;
+        }
+        groupFirstDraw = groupEndDraw;
+        if(rangeFirstDraw >= rangeEndDraw)
+        {
+            continue;
+        }
+
+        PixelGraphicsPipeline* groupPipeline = group.vertexFormat == PixelObject::VERTEX_FORMAT_PACKED ?
+                packedGraphicsPipelines[group.pipelineIndex].get() : graphicsPipelines[group.pipelineIndex].get();
+        VkPipeline currentGraphicsPipeline = groupPipeline->getPipeline();
+        VkPipelineLayout currentPipelineLayout = groupPipeline->getPipelineLayout();
+
+        //the vertex offsets of the group count from the region of its vertex format
+        VkBuffer vertexBuffers[] = {*currentScene.getVertexBuffer()};                      //buffers to bind
+        VkDeviceSize offsets[] = {currentScene.getVertexRegionOffset(group.vertexFormat)}; //offsets into buffers
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+        //bind the pipeline
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          currentGraphicsPipeline);
+
+        std::array<VkDescriptorSet, 2> descriptorSets = {
+                *currentScene.getUniformDescriptorSetAt(currentImageIndex),
+                *currentScene.getTextureDescriptorSet()};
+
+        //bind the descriptor sets
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                currentPipelineLayout,
+                                0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(),
+                                0, nullptr);
+
+        //execute the pipeline. each command's first instance is the object's index in the object table (gl_InstanceIndex)
+        uint32_t commandIndex = group.firstCommand + (rangeFirstDraw - (groupEndDraw - group.drawCount));
+        VkDeviceSize commandOffset = commandIndex * sizeof(VkDrawIndexedIndirectCommand);
+        uint32_t rangeDrawCount = rangeEndDraw - rangeFirstDraw;
+        if(countedDraws)
+        {
+            //the culling pass packed the survivors and counted them
+            vkCmdDrawIndexedIndirectCount(commandBuffer,
+                                          indirectBuffer, commandOffset,
+                                          drawCountBuffer, groupIndex * sizeof(uint32_t),
+                                          group.drawCount, sizeof(VkDrawIndexedIndirectCommand));
+        } else if(multiDrawIndirectSupported && !perObjectDraws) //culled draws are left in place with no instance
+        {
+            vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, commandOffset,
+                                     rangeDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+        } else
+        {
+            //without multi draw indirect, the draw count has to be 0 or 1
+            for(uint32_t drawIndex = 0; drawIndex < rangeDrawCount; drawIndex++)
+            {
+                vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer,
+                                         commandOffset + drawIndex * sizeof(VkDrawIndexedIndirectCommand),
+                                         1, sizeof(VkDrawIndexedIndirectCommand));
+            }
+        }
+    }
+
+    //get the grid object from the default scene, the last range draws it so it still comes after the objects
+    auto gridObject = defaultGridScene.getObjectAt(0);
+    if(rangeIndex == recordingThreadCount - 1 && !gridObject->isHidden())
+    {
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          defaultGridGraphicsPipeline->getPipeline());
+
+        VkBuffer gridVertexBuffers[] = {*defaultGridScene.getVertexBuffer()};
+        VkDeviceSize gridOffsets[] = {0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, gridVertexBuffers, gridOffsets);
+        vkCmdBindIndexBuffer(commandBuffer, *defaultGridScene.getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+        //the grid is not in the object table, its transform goes through the push constant
+        PixelObject::PObj gridPushObj{glm::mat4(1.0f), glm::mat4(1.0f)};
+        vkCmdPushConstants(commandBuffer,
+                           defaultGridGraphicsPipeline->getPipelineLayout(),
+                           VK_SHADER_STAGE_VERTEX_BIT,
+                           0,
+                           PixelObject::pushConstantRange.size,
+                           &gridPushObj);
+
+
+        vkCmdDrawIndexed(commandBuffer,
+                         static_cast<uint32_t>(gridObject->getIndexCount()), 1,
+                         gridObject->getFirstIndex(), gridObject->getVertexOffset(), 0);
+
+    }
+
+    result = vkEndCommandBuffer(commandBuffer);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to end recording the scene commands");
+    }
+}
+
+void PixelRenderer::recordGuiCommands(uint32_t currentImageIndex) {
+
+    VkCommandBuffer commandBuffer = guiCommandBuffers[currentImageIndex];
+
+    //the gui is drawn in the first scene's renderpass
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = graphicsPipelines[0]->getRenderPass();
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = swapchainFramebuffers[currentImageIndex];
+
+    VkCommandBufferBeginInfo bufferBeginInfo{};
+    bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    bufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    VkResult result = vkBeginCommandBuffer(commandBuffer, &bufferBeginInfo);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to begin recording the gui commands");
+    }
+
+    ImGui_ImplVulkan_RenderDrawData(draw_data, commandBuffer);
+
+    result = vkEndCommandBuffer(commandBuffer);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to end recording the gui commands");
+    }
+}
+
 void PixelRenderer::draw() {
 
-    //time measurements
-    float deltaTime = (float)glfwGetTime() - currentTime;
-    currentTime = (float)glfwGetTime();
+    //time measurements. headless frames advance at a fixed rate so batch renders are deterministic
+    float frameTime = headless ? currentTime + 1.0f/60.0f : (float)glfwGetTime();
+    float deltaTime = frameTime - currentTime;
+    currentTime = frameTime;
 
+    //give the staging space of finished uploads back
+    uploadBatcher.poll();
+    textureTable.beginFrame();
 
 
     //get the next available image to draw to and set something to signal when we are finished with the image
@@ -854,6 +1229,16 @@ void PixelRenderer::draw() {
 
 
     // Compute submission
+    //the ray traced images follow the swapchain and the render scale. the other frame in flight may still use them
+    VkExtent2D computeExtent = getComputeExtent();
+    if(computeExtent.width != computePipeline.getExtent().width || computeExtent.height != computePipeline.getExtent().height)
+    {
+        vkQueueWaitIdle(computeQueue);
+        computePipeline.resize(computeExtent);
+    }
+
+    updateComputeScene();
+
     vkWaitForFences(mainDevice.logicalDevice, 1, &inFlightComputeFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
     vkResetFences(mainDevice.logicalDevice, 1, &inFlightComputeFences[currentFrame]);
 
@@ -873,14 +1258,25 @@ void PixelRenderer::draw() {
     //graphics submission
     //the only thing that will open this fence is the vkQueueSubmit
     vkWaitForFences(mainDevice.logicalDevice, 1, &inFlightDrawFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
-    vkResetFences(mainDevice.logicalDevice, 1, &inFlightDrawFences[currentFrame]);
 
     //Get index of the next image to draw to and signal semaphore
-    uint32_t imageIndex;
-    vkAcquireNextImageKHR(mainDevice.logicalDevice,
-                          swapChain,
-                          std::numeric_limits<uint64_t>::max(),
-                          imageAvailableSemaphore[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    uint32_t imageIndex = currentFrame; //one offscreen target per frame in flight
+    if(!headless)
+    {
+        vkAcquireNextImageKHR(mainDevice.logicalDevice,
+                              swapChain,
+                              std::numeric_limits<uint64_t>::max(),
+                              imageAvailableSemaphore[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    }
+
+    //the buffers and command buffers of the image are written below, the frame that last rendered it has to be done.
+    //the swapchain can hand out images in any order, so that is not always the frame waited on above
+    if(imagesInFlight[imageIndex] != VK_NULL_HANDLE)
+    {
+        vkWaitForFences(mainDevice.logicalDevice, 1, &imagesInFlight[imageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
+    }
+    imagesInFlight[imageIndex] = inFlightDrawFences[currentFrame];
+    vkResetFences(mainDevice.logicalDevice, 1, &inFlightDrawFences[currentFrame]);
 
 
     PixelScene::UboVP newVP1{};
@@ -904,8 +1300,29 @@ void PixelRenderer::draw() {
     //firstScene->getObjectAt(0)->addTransform({glm::rotate(glm::mat4(1.0f), currentTime,glm::vec3(0.0f,1.0f,0.0f))});
     //firstScene->getObjectAt(0)->addTransform({glm::rotate(glm::mat4(1.0f), glm::radians(45.0f),glm::vec3(1.0f,1.0f,0.0f))});
     //scenes[0]->getObjectAt(0)->setTransform({objTransform});
-    scenes[0].updateDynamicUniformBuffer(imageIndex);
+    if(animateSceneObject)
+    {
+        scenes[0].getObjectAt(0)->setTransform(objTransform); //the ray traced copy follows on the next frame
+    }
+    //stream texture levels from the sampling feedback of the finished frames. the objects follow the textures that moved
+    for(const auto& remap : textureStreamer.update())
+    {
+        remapTextureIndex(remap.oldIndex, remap.newIndex);
+    }
+    updateSceneGeometry(&scenes[0]);
+    uploadBatcher.flush(); //submitted on the graphics queue ahead of this frame's draws
+
+    //added, hidden, shown or re-assigned objects rebuild the draw groups and invalidate the recorded scene commands
+    scenes[0].refreshDrawState();
+    defaultGridScene.refreshDrawState();
+
+    scenes[0].updateObjectBuffer(imageIndex);
     scenes[0].updateUniformBuffer(imageIndex);
+    scenes[0].updateDrawCandidates(imageIndex);
+
+    //the fence of the frame that last rendered this image was waited on, its counters are final
+    cullingPipeline.collectStats(imageIndex);
+    cullingPipeline.update(imageIndex, &scenes[0], drawIndirectCountSupported && !perObjectDraws); //single draws need every slot written
 
     //we do not want to update all command buffers. only update the current command buffer being written to.
     recordCommands(imageIndex);
@@ -919,12 +1336,12 @@ void PixelRenderer::draw() {
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.waitSemaphoreCount = headless ? 1 : static_cast<uint32_t>(waitSemaphores.size()); //no image to acquire when headless, only wait on compute
     submitInfo.pWaitSemaphores = waitSemaphores.data(); //list of semaphores to wait on
     submitInfo.pWaitDstStageMask = waitStages; //stage to check semaphores at
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffers[imageIndex]; //command buffer to submit
-    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.signalSemaphoreCount = headless ? 0 : 1; //nothing waits on the render when there is no presentation
     submitInfo.pSignalSemaphores = &renderFinishedSemaphore[currentFrame]; //semaphores to signal when the command buffer is finished
 
     //submit this commandBuffer[imageIndex] to this graphicsQueue. it's essentially our execute function
@@ -934,6 +1351,14 @@ void PixelRenderer::draw() {
         throw std::runtime_error("failed to submit queue");
     }
 
+    lastRenderedImage = imageIndex;
+
+    if(headless)
+    {
+        currentFrame = ( currentFrame + 1 ) % MAX_FRAME_DRAWS;
+        return;
+    }
+
     //present the rendered image to the screen
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -976,6 +1401,251 @@ void PixelRenderer::run() {
 }
 
 
+void PixelRenderer::runHeadless(uint32_t frameCount) {
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    for(uint32_t i = 0; i < frameCount; i++)
+    {
+        draw();
+    }
+
+    vkDeviceWaitIdle(mainDevice.logicalDevice);
+    auto endTime = std::chrono::high_resolution_clock::now();
+
+    double totalMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+    printf("Rendered %u headless frames (%ux%u) in %.3f ms (%.3f ms/frame)\n",
+           frameCount, swapChainExtent.width, swapChainExtent.height, totalMs, frameCount > 0 ? totalMs / frameCount : 0.0);
+
+    PixMemoryStats memoryStats = memoryAllocator.getStats();
+    printf("GPU memory: %llu bytes in use, %llu bytes reserved in %u blocks for %u allocations (fragmentation %.1f%%)\n",
+           (unsigned long long)memoryStats.bytesInUse, (unsigned long long)memoryStats.bytesReserved,
+           memoryStats.blockCount, memoryStats.allocationCount, memoryStats.fragmentation * 100.0f);
+
+    PixelTextureStreamer::Stats streamingStats = textureStreamer.getStats();
+    printf("Texture streaming: %.2f / %.2f MB resident for %u textures, %u pending uploads, %llu levels streamed, %llu evicted\n",
+           (float)streamingStats.residentBytes / (1024.0f * 1024.0f), (float)streamingStats.budget / (1024.0f * 1024.0f),
+           streamingStats.textureCount, streamingStats.pendingUploads,
+           (unsigned long long)streamingStats.streamedLevels, (unsigned long long)streamingStats.evictedLevels);
+    fflush(stdout);
+}
+
+void PixelRenderer::setRecordingThreadCount(uint32_t threadCount) {
+
+    recordingThreadCount = std::max(1u, std::min(threadCount, static_cast<uint32_t>(recordingCommandPools.size())));
+
+    //the scenes are split differently, every secondary command buffer has to be recorded again
+    for(auto& sceneVersions : recordedSceneVersions)
+    {
+        std::fill(sceneVersions.begin(), sceneVersions.end(), 0);
+    }
+}
+
+void PixelRenderer::runRecordingBenchmark(uint32_t iterations) {
+
+    //time the recording of the main scene's secondary command buffers for every thread count, nothing is submitted
+    vkDeviceWaitIdle(mainDevice.logicalDevice);
+    if(sceneCommandBuffers.size() < scenes.size())
+    {
+        createSceneCommandBuffers();
+    }
+
+    uint32_t maxThreadCount = static_cast<uint32_t>(recordingCommandPools.size());
+    std::vector<uint32_t> threadCounts;
+    for(uint32_t threadCount = 1; threadCount < maxThreadCount; threadCount *= 2)
+    {
+        threadCounts.push_back(threadCount);
+    }
+    threadCounts.push_back(maxThreadCount);
+
+    printf("Recording benchmark: %d objects, %u iterations\n", scenes[0].getNumObjects(), iterations);
+    for(bool singleDraws : {false, true})
+    {
+        perObjectDraws = singleDraws;
+        double singleThreadMs = 0.0;
+        for(uint32_t threadCount : threadCounts)
+        {
+            setRecordingThreadCount(threadCount);
+            recordSceneCommands(0, 0); //warm up the pools
+
+            auto startTime = std::chrono::high_resolution_clock::now();
+            for(uint32_t i = 0; i < iterations; i++)
+            {
+                recordSceneCommands(0, 0);
+            }
+            auto endTime = std::chrono::high_resolution_clock::now();
+
+            double recordingMs = std::chrono::duration<double, std::milli>(endTime - startTime).count() / std::max(iterations, 1u);
+            if(threadCount == 1)
+            {
+                singleThreadMs = recordingMs;
+            }
+            printf("  %s, %2u threads: %.3f ms per recording (x%.2f)\n",
+                   singleDraws ? "per object draws" : "indirect draws  ", threadCount, recordingMs,
+                   recordingMs > 0.0 ? singleThreadMs / recordingMs : 0.0);
+        }
+    }
+    fflush(stdout);
+
+    perObjectDraws = false;
+    setRecordingThreadCount(maxThreadCount);
+}
+
+//every file of directory with one of the extensions, sorted by name
+static std::vector<std::string> listAssetFiles(const std::string& directory, const std::vector<std::string>& extensions)
+{
+    std::vector<std::string> files;
+    std::error_code error;
+    for(const auto& entry : std::filesystem::directory_iterator(directory, error))
+    {
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+        if(entry.is_regular_file() && std::find(extensions.begin(), extensions.end(), extension) != extensions.end())
+        {
+            files.push_back(entry.path().filename().string());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+void PixelRenderer::runLoadingBenchmark(uint32_t iterations) {
+
+    //load every mesh of objects/ and every texture of Textures/, on the calling thread and then on the job system.
+    //the mesh cache is skipped so both import the source files. a load ends when the textures are on the gpu
+    std::vector<std::string> meshFiles = listAssetFiles("objects", {".obj", ".fbx", ".gltf", ".glb", ".dae", ".3ds", ".ply"});
+    std::vector<std::string> textureFiles = listAssetFiles("Textures", {".jpg", ".jpeg", ".png", ".bmp", ".tga"});
+
+    printf("Loading benchmark: %zu meshes, %zu textures, %u iterations, %u threads\n",
+           meshFiles.size(), textureFiles.size(), iterations, jobSystem.getThreadCount());
+    if(meshFiles.empty() && textureFiles.empty())
+    {
+        printf("  no assets found\n");
+        fflush(stdout);
+        return;
+    }
+
+    assetLoader.setUseMeshCache(false);
+    double sequentialMs = 0.0;
+    for(bool parallel : {false, true})
+    {
+        assetLoader.setParallel(parallel);
+        double totalMs = 0.0;
+        for(uint32_t i = 0; i < iterations; i++)
+        {
+            auto startTime = std::chrono::high_resolution_clock::now();
+            for(const auto& meshFile : meshFiles)
+            {
+                assetLoader.requestMesh(meshFile);
+            }
+            for(const auto& textureFile : textureFiles)
+            {
+                assetLoader.requestTexture(textureFile);
+            }
+            assetLoader.waitAll();
+            uploadBatcher.waitIdle();
+            auto endTime = std::chrono::high_resolution_clock::now();
+            totalMs += std::chrono::duration<double, std::milli>(endTime - startTime).count();
+
+            for(uint32_t t = 0; t < assetLoader.getTextureCount(); t++)
+            {
+                assetLoader.getTexture(t)->cleanUp();
+            }
+            assetLoader.clear();
+        }
+
+        double loadingMs = totalMs / std::max(iterations, 1u);
+        if(!parallel)
+        {
+            sequentialMs = loadingMs;
+        }
+        printf("  %s: %.3f ms per load (x%.2f)\n", parallel ? "parallel  " : "sequential", loadingMs,
+               loadingMs > 0.0 ? sequentialMs / loadingMs : 0.0);
+    }
+    fflush(stdout);
+
+    assetLoader.setParallel(true);
+    assetLoader.setUseMeshCache(true);
+}
+
+void PixelRenderer::readbackFrame(std::vector<unsigned char>& pixels) {
+
+    if(!headless)
+    {
+        throw std::runtime_error("frame readback is only available when running headless");
+    }
+
+    //make sure the last submitted frame is done before copying it
+    vkWaitForFences(mainDevice.logicalDevice, static_cast<uint32_t>(inFlightDrawFences.size()), inFlightDrawFences.data(), VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+    PixelImage* frameImage = &swapChainImages[lastRenderedImage];
+
+    VkCommandBuffer commandBuffer = beginSingleUseCommandBuffer();
+
+    //the renderpass leaves the image in transfer src layout. we only need the color writes to be visible to the transfer
+    VkImageMemoryBarrier imageMemoryBarrier{};
+    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageMemoryBarrier.image = frameImage->getImage();
+    imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageMemoryBarrier.subresourceRange.layerCount = 1;
+    imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+    imageMemoryBarrier.subresourceRange.levelCount = 1;
+    imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+    imageMemoryBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0,
+                         0, nullptr,
+                         0, nullptr,
+                         1, &imageMemoryBarrier);
+
+    VkBufferImageCopy imageCopy{};
+    imageCopy.bufferOffset = 0;
+    imageCopy.bufferRowLength = 0; //tightly packed
+    imageCopy.bufferImageHeight = 0;
+    imageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageCopy.imageSubresource.layerCount = 1;
+    imageCopy.imageSubresource.baseArrayLayer = 0;
+    imageCopy.imageSubresource.mipLevel = 0;
+    imageCopy.imageOffset = {0,0,0};
+    imageCopy.imageExtent = {frameImage->getWidth(), frameImage->getHeight(), 1};
+
+    vkCmdCopyImageToBuffer(commandBuffer, frameImage->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &imageCopy);
+
+    submitAndEndSingleUseCommandBuffer(&commandBuffer);
+
+    pixels.resize(static_cast<size_t>(frameImage->getImageBufferSize()));
+
+    memcpy(pixels.data(), readbackBufferAllocation.mappedData, pixels.size());
+}
+
+void PixelRenderer::saveFrame(const std::string& filename) {
+
+    std::vector<unsigned char> pixels;
+    readbackFrame(pixels);
+
+    //binary ppm, the alpha channel is dropped
+    std::ofstream file(filename, std::ios::binary);
+    if(!file.is_open())
+    {
+        throw std::runtime_error("failed to open the following file: " + filename);
+    }
+
+    file << "P6\n" << swapChainExtent.width << " " << swapChainExtent.height << "\n255\n";
+    for(size_t i = 0; i < pixels.size(); i += 4)
+    {
+        file.write(reinterpret_cast<const char*>(&pixels[i]), 3);
+    }
+
+    file.close();
+}
+
 void PixelRenderer::createSynchronizationObjects() {
     printf("Creating Synchronization Objects\n");
     fflush(stdout);
@@ -985,6 +1655,7 @@ void PixelRenderer::createSynchronizationObjects() {
     computeFinishedSemaphore.resize(MAX_FRAME_DRAWS);
     inFlightDrawFences.resize(MAX_FRAME_DRAWS);
     inFlightComputeFences.resize(MAX_FRAME_DRAWS);
+    imagesInFlight.resize(swapChainImages.size(), VK_NULL_HANDLE);
 
     VkSemaphoreCreateInfo semaphoreCreateInfo{};
     semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -1031,162 +1702,105 @@ void PixelRenderer::createSynchronizationObjects() {
 
 void PixelRenderer::createBuffer(VkDeviceSize bufferSize,
                                  VkBufferUsageFlags bufferUsageFlags, VkMemoryPropertyFlags bufferproperties,
-                                 VkBuffer *buffer, VkDeviceMemory *bufferMemory) {
+                                 VkBuffer *buffer, PixAllocation *bufferAllocation) {
 
-    //does not have any memory, just a header
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = bufferSize;
-    bufferInfo.usage = bufferUsageFlags;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    //the buffer memory is sub-allocated from a larger block instead of having its own vkAllocateMemory
+    memoryAllocator.createBuffer(bufferSize, bufferUsageFlags, bufferproperties, buffer, bufferAllocation);
+}
 
-    VkResult result = vkCreateBuffer(mainDevice.logicalDevice, &bufferInfo, nullptr, buffer);
-    if(result != VK_SUCCESS)
-    {
-        throw std::runtime_error("failed to create vertex buffer");
-        //give access to memory [beep(2) boop(9) bop(4)]
+void PixelRenderer::createTextureBuffer(PixelImage* pixImage) {
 
+    if(pixImage->isUploadQueued())
+    {
+        return; //the pixels were staged while the texture was loaded
     }
 
-    //get buffer memory requirements
-    VkMemoryRequirements memoryRequirements{};
-    vkGetBufferMemoryRequirements(mainDevice.logicalDevice, *buffer, &memoryRequirements);
-
-    //allocate memory buffer
-    VkMemoryAllocateInfo allocateInfo{};
-    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocateInfo.allocationSize = memoryRequirements.size;
-    allocateInfo.memoryTypeIndex = findMemoryTypeIndex(mainDevice.physicalDevice, memoryRequirements.memoryTypeBits,   bufferproperties);
-
-    result = vkAllocateMemory(mainDevice.logicalDevice, &allocateInfo, nullptr, bufferMemory);
-    if(result != VK_SUCCESS)
+    if(pixImage->getImageData() != nullptr)
     {
-        throw std::runtime_error("Failed to allocate device memory for object");
+        //transfer dst -> copy -> shader read only, all recorded in the current upload batch
+        uploadBatcher.uploadImage(pixImage, pixImage->getImageData(), pixImage->getImageBufferSize());
+        pixImage->releaseImageData(); //staged, the cpu copy is not needed anymore
+    } else
+    {
+        uploadBatcher.transitionImage(pixImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
     }
-
-    vkBindBufferMemory(mainDevice.logicalDevice, *buffer, *bufferMemory, 0);
 }
 
-void PixelRenderer::copySrcBuffertoDstBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize bufferSize) {
-
-    //Command Buffer to hold the commands
-    VkCommandBuffer transferCommandBuffer = beginSingleUseCommandBuffer();
-
-    //region of data to copy from and too
-    VkBufferCopy bufferCopy{};
-    bufferCopy.srcOffset = 0;
-    bufferCopy.dstOffset = 0;
-    bufferCopy.size = bufferSize;
-
-    vkCmdCopyBuffer(transferCommandBuffer, srcBuffer, dstBuffer, 1, &bufferCopy);
+void PixelRenderer::createGeometryBuffers(PixelScene *pixScene) {
 
-    submitAndEndSingleUseCommandBuffer(&transferCommandBuffer);
+    //give each object its range in the scene's buffers
+    pixScene->packGeometry();
 
-}
-
-void PixelRenderer::createVertexBuffer(PixelObject* pixObject) {
-
-    //temporary buffer to stage the vertex buffer before being transfered to the GPU
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-
-    //create the buffer to be transfered somewhere else
-    createBuffer(pixObject->getVertexBufferSize(),
-                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 &stagingBuffer, &stagingBufferMemory);
-
-    //Map memory to staging buffer
-    void *data; //create a pointer to a point in normal memory
-    vkMapMemory(mainDevice.logicalDevice, stagingBufferMemory, 0, pixObject->getVertexBufferSize(), 0, &data); //map vertex buffer memory to that point
-    memcpy(data, pixObject->getVertices()->data(), (size_t)pixObject->getVertexBufferSize()); //copy memory from vertex memory to the data pointer (ie vertex buffer memory)
-    vkUnmapMemory(mainDevice.logicalDevice, stagingBufferMemory); //unmap memory
+    if(pixScene->getIndexBufferSize() == 0)
+    {
+        return;
+    }
 
-    //create buffer with transfer dst bit to mark as recipient of transfer data
-    //buffer memory is only accessible in gpu memory. it is a buffer used for vertices
-    createBuffer(pixObject->getVertexBufferSize(),
+    //create buffers with transfer dst bit to mark as recipient of transfer data
+    //buffer memory is only accessible in gpu memory. one buffer for every vertex and one for every index of the scene
+    createBuffer(pixScene->getVertexBufferSize(),
                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                 pixObject->getVertexBuffer(), pixObject->getVertexBufferMemory());
+                 pixScene->getVertexBuffer(), pixScene->getVertexBufferAllocation());
 
-    //graphics queues are also transfer queues & graphics command pool are also transfer command pools
-    copySrcBuffertoDstBuffer(stagingBuffer, *pixObject->getVertexBuffer(), pixObject->getVertexBufferSize());
+    createBuffer(pixScene->getIndexBufferSize(),
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 pixScene->getIndexBuffer(), pixScene->getIndexBufferAllocation());
 
-    //cleanup transferbuffer
-    vkDestroyBuffer(mainDevice.logicalDevice, stagingBuffer, nullptr);
-    vkFreeMemory(mainDevice.logicalDevice, stagingBufferMemory, nullptr);
-}
+    //every mesh goes through the staging ring to its own offset and is copied with the rest of the batch
+    for(int i = 0; i < pixScene->getNumObjects(); i++)
+    {
+        PixelObject* pixObject = pixScene->getObjectAt(i);
+        if(pixObject->getIndexCount() == 0)
+        {
+            continue;
+        }
 
-void PixelRenderer::createTextureBuffer(PixelImage* pixImage) {
+        PixelObject::VertexFormat vertexFormat = pixObject->getVertexFormat();
+        uploadBatcher.uploadBuffer(*pixScene->getVertexBuffer(), pixObject->getVertexData(), pixObject->getVertexBufferSize(),
+                                   pixScene->getVertexRegionOffset(vertexFormat) +
+                                   PixelObject::getVertexStride(vertexFormat) * static_cast<VkDeviceSize>(pixObject->getVertexOffset()),
+                                   VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
 
-    //temporary buffer to stage the vertex buffer before being transfered to the GPU
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
+        uploadBatcher.uploadBuffer(*pixScene->getIndexBuffer(), pixObject->getIndices()->data(), pixObject->getIndexBufferSize(),
+                                   sizeof(uint32_t) * static_cast<VkDeviceSize>(pixObject->getFirstIndex()),
+                                   VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+    }
+}
 
-    //create the buffer to be transfered somewhere else
-    createBuffer(pixImage->getImageBufferSize(),
-                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 &stagingBuffer, &stagingBufferMemory);
+void PixelRenderer::createObjectTextures(PixelObject *pixObject) {
 
-    if(pixImage->getImageData() != nullptr)
+    for(auto& texture : *pixObject->getTextures())
     {
-        //Map memory to staging buffer
-        void *data; //create a pointer to a point in normal memory
-        vkMapMemory(mainDevice.logicalDevice, stagingBufferMemory, 0, pixImage->getImageBufferSize(), 0, &data); //map vertex buffer memory to that point
-        memcpy(data, pixImage->getImageData(), static_cast<size_t>(pixImage->getImageBufferSize())); //copy memory from vertex memory to the data pointer (ie vertex buffer memory)
-        vkUnmapMemory(mainDevice.logicalDevice, stagingBufferMemory); //unmap memory
-
-        //transition the image to image layout transfer bit so it can receive the buffer data during the transfer stage.
-        transitionImageLayout(pixImage->getImage(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-        //graphics queues are also transfer queues & graphics command pool are also transfer command pools
-        copySrcBuffertoDstImage(stagingBuffer, pixImage->getImage(), pixImage->getWidth(), pixImage->getHeight());
+        createTextureBuffer(&texture);
+        texture.setTextureIndex(static_cast<int>(textureTable.addTexture(&texture)));
+    }
 
-        //transition the image from image layout transfer bit so it can be read by the shader.
-        transitionImageLayout(pixImage->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    } else
+    //the object samples its first texture through the global index
+    if(!pixObject->getTextures()->empty())
     {
-        transitionImageLayout(pixImage->getImage(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        pixObject->setTexID(pixObject->getTextures()->front().getTextureIndex());
     }
-
-
-    //cleanup transferbuffer
-    vkDestroyBuffer(mainDevice.logicalDevice, stagingBuffer, nullptr);
-    vkFreeMemory(mainDevice.logicalDevice, stagingBufferMemory, nullptr);
 }
 
-void PixelRenderer::createIndexBuffer(PixelObject *pixObject)
-{
-    //temporary buffer to stage the vertex buffer before being transfered to the GPU
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-
-    //create the buffer to be transfered somewhere else
-    createBuffer(pixObject->getIndexBufferSize(),
-                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 &stagingBuffer, &stagingBufferMemory);
-
-    //Map memory to staging buffer
-    void *data; //create a pointer to a point in normal memory
-    vkMapMemory(mainDevice.logicalDevice, stagingBufferMemory, 0, pixObject->getIndexBufferSize(), 0, &data); //map vertex buffer memory to that point
-    memcpy(data, pixObject->getIndices()->data(), (size_t)pixObject->getIndexBufferSize()); //copy memory from vertex memory to the data pointer (ie vertex buffer memory)
-    vkUnmapMemory(mainDevice.logicalDevice, stagingBufferMemory); //unmap memory
-
-    //create buffer with transfer dst bit to mark as recipient of transfer data
-    //buffer memory is only accessible in gpu memory. it is a buffer used for vertices
-    createBuffer(pixObject->getIndexBufferSize(),
-                 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                 pixObject->getIndexBuffer(), pixObject->getIndexBufferMemory());
+void PixelRenderer::updateSceneGeometry(PixelScene *pixScene) {
 
-    //graphics queues are also transfer queues & graphics command pool are also transfer command pools
-    copySrcBuffertoDstBuffer(stagingBuffer, *pixObject->getIndexBuffer(), pixObject->getIndexBufferSize());
+    if(pixScene->getPackedObjectCount() == static_cast<uint32_t>(pixScene->getNumObjects()))
+    {
+        return;
+    }
 
-    //cleanup transferbuffer
-    vkDestroyBuffer(mainDevice.logicalDevice, stagingBuffer, nullptr);
-    vkFreeMemory(mainDevice.logicalDevice, stagingBufferMemory, nullptr);
-}
+    printf("Packing %u added objects\n", pixScene->getNumObjects() - pixScene->getPackedObjectCount());
+    fflush(stdout);
+
+    for(int i = static_cast<int>(pixScene->getPackedObjectCount()); i < pixScene->getNumObjects(); i++)
+    {
+        createObjectTextures(pixScene->getObjectAt(i));
+    }
 
-void PixelRenderer::initializeObjectBuffers(PixelObject *pixObject) {
-    createVertexBuffer(pixObject);
-    createIndexBuffer(pixObject);
+    //every object gets a new range, all of them go through the current upload batch again. the object table and the
+    //draw buffers grow on their own when the frame updates them
+    pixScene->retireGeometryBuffers();
+    createGeometryBuffers(pixScene);
 }
 
 void PixelRenderer::createUniformBuffers(PixelScene *pixScene) {
@@ -1198,12 +1812,28 @@ void PixelRenderer::createUniformBuffers(PixelScene *pixScene) {
         createBuffer(PixelScene::getUniformBufferSize(),
                      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     pixScene->getUniformBuffers(i), pixScene->getUniformBufferMemories(i));
+                     pixScene->getUniformBuffers(i), pixScene->getUniformBufferAllocations(i));
 
-        createBuffer(pixScene->getDynamicUniformBufferSize(),
-                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        createBuffer(pixScene->getObjectBufferSize(),
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     pixScene->getDynamicUniformBuffers(i), pixScene->getDynamicUniformBufferMemories(i));
+                     pixScene->getObjectBuffers(i), pixScene->getObjectBufferAllocations(i));
+
+        pixScene->createDrawBuffers(i);
+    }
+}
+
+void PixelRenderer::remapTextureIndex(int oldIndex, int newIndex) {
+
+    for(auto& scene : scenes)
+    {
+        for(int i = 0; i < scene.getNumObjects(); i++)
+        {
+            if(scene.getObjectAt(i)->getObjectData()->texIndex == oldIndex)
+            {
+                scene.getObjectAt(i)->setTexID(newIndex);
+            }
+        }
     }
 }
 
@@ -1216,16 +1846,17 @@ void PixelRenderer::initializeScenes() {
     emptyTexture.loadEmptyTexture();
     createTextureBuffer(&emptyTexture);
 
+    //the grid draws from its own scene's buffers
+    createGeometryBuffers(&defaultGridScene);
+
     //initialize all objects in the scene
     for(auto& scene : scenes)
     {
+        createGeometryBuffers(&scene); //depends on the upload batcher
+
         for(int i = 0 ; i < scene.getNumObjects(); i++)
         {
-            initializeObjectBuffers(scene.getObjectAt(i)); //depends on graphics command pool
-            for(auto texture : scene.getObjectAt(i)->getTextures())
-            {
-                createTextureBuffer(&texture);
-            }
+            createObjectTextures(scene.getObjectAt(i));
         }
 
         createUniformBuffers(&scene);
@@ -1233,6 +1864,11 @@ void PixelRenderer::initializeScenes() {
         createDescriptorSets(&scene);
     }
 
+    //submit every upload in one go. draws are submitted to the same queue after this batch so they are ordered
+    //behind its barriers, no need to wait for the copies here
+    uint64_t batchId = uploadBatcher.flush();
+    printf("Submitted upload batch %llu (%.2f MB staged)\n", (unsigned long long)batchId, (float)uploadBatcher.getBytesUploaded() / (1024.0f * 1024.0f));
+    fflush(stdout);
 
 }
 
@@ -1255,9 +1891,11 @@ void PixelRenderer::createScene() {
             2,3,0
     };
 
+    //the files are loaded on the job system while the rest of the scene is built
+    uint32_t skullTexture = assetLoader.requestStreamedTexture(&textureStreamer, "Skull.jpg");
+
     auto square = PixelObject(&mainDevice, vertices, indices);
 
-    square.addTexture("Skull.jpg");
     square.setGraphicsPipelineIndex(0);
     //square.addTexture(computePipeline.getOutputTexture());
     //square.addTexture(computePipeline.getCustomTexture());
@@ -1267,15 +1905,30 @@ void PixelRenderer::createScene() {
     //firstScene->addObject(object1);
     scene1.addObject(square);
 
+    //benchmark scene: a grid of small quads, each with its own transform
+    uint32_t gridSide = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(benchmarkObjectCount))));
+    for(uint32_t i = 0; i < benchmarkObjectCount; i++)
+    {
+        auto quad = PixelObject(&mainDevice, vertices, indices);
+        float x = (static_cast<float>(i % gridSide) - gridSide * 0.5f) * 0.25f;
+        float y = (static_cast<float>(i / gridSide) - gridSide * 0.5f) * 0.25f;
+        quad.setTransform(glm::translate(glm::mat4(1.0f), glm::vec3(x, y, -1.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.1f)));
+        quad.setVertexFormat(PixelObject::VERTEX_FORMAT_PACKED);
+        scene1.addObject(quad);
+    }
+
     //mug.setTexID(1); //TODO:problem there. value not copied
 
+    assetLoader.waitAll();
+    scene1.getObjectAt(0)->setTexID(textureStreamer.getTextureIndex(assetLoader.getStreamedTexture(skullTexture))); //streamed, follows the remaps
+    assetLoader.clear();
+
     scenes.push_back(scene1);
 
 }
 
 void PixelRenderer::createDescriptorPool(PixelScene* pixScene) {
 
-    size_t numTextureDescriptorSet = 1;
     size_t numUniformDescriptorSets = swapChainImages.size();
 
     //number of descriptors and not descriptor sets. combined, it makes the pool size
@@ -1283,20 +1936,17 @@ void PixelRenderer::createDescriptorPool(PixelScene* pixScene) {
     vpPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     vpPoolSize.descriptorCount = static_cast<uint32_t>(numUniformDescriptorSets); //one descriptor per swapchain image
 
-    VkDescriptorPoolSize dynamicModelPoolSize{};
-    dynamicModelPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    dynamicModelPoolSize.descriptorCount = static_cast<uint32_t>(numUniformDescriptorSets); //one descriptor per swapchain image
-
-    VkDescriptorPoolSize samplerPoolSize{};
-    samplerPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    samplerPoolSize.descriptorCount = static_cast<uint32_t>(MAX_OBJECTS * MAX_TEXTURE_PER_OBJECT); //one descriptor per swapchain image
+    VkDescriptorPoolSize objectTablePoolSize{};
+    objectTablePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    objectTablePoolSize.descriptorCount = static_cast<uint32_t>(numUniformDescriptorSets); //one descriptor per swapchain image
 
-    std::array<VkDescriptorPoolSize, 3> poolSizes = {vpPoolSize, dynamicModelPoolSize, samplerPoolSize};
+    //textures live in the global texture table and not in the scene's pool
+    std::array<VkDescriptorPoolSize, 2> poolSizes = {vpPoolSize, objectTablePoolSize};
 
     //includes info about the descriptor set that contains the descriptor
     VkDescriptorPoolCreateInfo poolCreateInfo{};
     poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolCreateInfo.maxSets = static_cast<uint32_t>(numUniformDescriptorSets + numTextureDescriptorSet); //maximum number of descriptor sets that can be created from pool
+    poolCreateInfo.maxSets = static_cast<uint32_t>(numUniformDescriptorSets); //maximum number of descriptor sets that can be created from pool
     poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     poolCreateInfo.pPoolSizes = poolSizes.data();
 
@@ -1310,7 +1960,7 @@ void PixelRenderer::createDescriptorPool(PixelScene* pixScene) {
 
 void PixelRenderer::createDescriptorSets(PixelScene *pixScene)
 {
-    //we have 1 Descriptor Set and 2 bindings. one binding for the VP matrices. one binding for the dynamic buffer object for M matrix.
+    //we have 1 Descriptor Set and 2 bindings. one binding for the VP matrices. one binding for the object table.
     const size_t numImages = swapChainImages.size();
     //resize the descriptor sets to match the uniform buffers that contain its data
     pixScene->resizeDesciptorSets(numImages);
@@ -1333,20 +1983,6 @@ void PixelRenderer::createDescriptorSets(PixelScene *pixScene)
         throw std::runtime_error("failed to allocate descriptor set for ubos");
     }
 
-    //allocate info for texture descriptor set. they are not created but allocated from the pool
-    VkDescriptorSetAllocateInfo textureSetAllocateInfo{};
-    textureSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    textureSetAllocateInfo.descriptorPool = *pixScene->getDescriptorPool();
-    textureSetAllocateInfo.descriptorSetCount = 1;
-    textureSetAllocateInfo.pSetLayouts = pixScene->getDescriptorSetLayout(TEXTURES);  //matches the number of swapchain images but they are all the same.
-    // has to be 1:1 relationship with descriptor sets
-
-    result = vkAllocateDescriptorSets(mainDevice.logicalDevice, &textureSetAllocateInfo, pixScene->getTextureDescriptorSet());
-    if(result != VK_SUCCESS)
-    {
-        throw std::runtime_error("failed to allocate descriptor set for textures");
-    }
-
     //all of the descriptor pool and descriptor set created are used to build these following struct
     for(size_t i = 0; i < pixScene->getUniformDescriptorSets()->size() ; i++)
     {
@@ -1367,62 +2003,27 @@ void PixelRenderer::createDescriptorSets(PixelScene *pixScene)
         vpBufferSet.pBufferInfo = &descriptorBufferInfo;
 
         //BINDING 1 of SET 0 --------
-        VkDescriptorBufferInfo descriptorDynamicBufferInfo{};
-        descriptorDynamicBufferInfo.buffer = *pixScene->getDynamicUniformBuffers(i); //buffer to get data from
-        descriptorDynamicBufferInfo.offset = 0;
-        descriptorDynamicBufferInfo.range = pixScene->getMinAlignment(); //what is the size of one chunk of memory
-
-        VkWriteDescriptorSet dynamicBufferSet{};
-        dynamicBufferSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        dynamicBufferSet.dstSet = *pixScene->getUniformDescriptorSetAt(i);
-        dynamicBufferSet.dstBinding = 1; //matches layout(binding = 0)
-        dynamicBufferSet.dstArrayElement = 0; //index in the array we want to update. we don't have an array to update here
-        dynamicBufferSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-        dynamicBufferSet.descriptorCount = 1;
-        dynamicBufferSet.pBufferInfo = &descriptorDynamicBufferInfo;
-
-        std::array<VkWriteDescriptorSet, 2> descriptorWrites = {vpBufferSet, dynamicBufferSet};
+        VkDescriptorBufferInfo descriptorObjectBufferInfo{};
+        descriptorObjectBufferInfo.buffer = *pixScene->getObjectBuffers(i); //buffer to get data from
+        descriptorObjectBufferInfo.offset = 0;
+        descriptorObjectBufferInfo.range = VK_WHOLE_SIZE; //the whole object table, indexed in the shader
+
+        VkWriteDescriptorSet objectBufferSet{};
+        objectBufferSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        objectBufferSet.dstSet = *pixScene->getUniformDescriptorSetAt(i);
+        objectBufferSet.dstBinding = 1; //matches layout(binding = 1)
+        objectBufferSet.dstArrayElement = 0; //index in the array we want to update. we don't have an array to update here
+        objectBufferSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        objectBufferSet.descriptorCount = 1;
+        objectBufferSet.pBufferInfo = &descriptorObjectBufferInfo;
+
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites = {vpBufferSet, objectBufferSet};
 
         //update the descriptor sets with new buffer binding info
         vkUpdateDescriptorSets(mainDevice.logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
     }
 
-    //BINDING 0 of SET 1 --------
-    std::array<VkDescriptorImageInfo, MAX_TEXTURE_PER_OBJECT> textureSamplerDescriptorInfos{};
-    //VkDescriptorImageInfo textureSamplerDescriptorInfo{};
-    for(int i = 0 ; i < textureSamplerDescriptorInfos.size(); i++)
-    {
-        if(i < pixScene->getAllTextures().size())
-        {
-            if(pixScene->getAllTextures()[i].hasBeenInitialized()) //TODO:make sure we go through all the scenes
-            {
-                textureSamplerDescriptorInfos[i].imageView = pixScene->getAllTextures()[i].getImageView(); //image view of the texture
-            }
-            else
-            {
-                textureSamplerDescriptorInfos[i].imageView = emptyTexture.getImageView(); //image view of the texture
-            }
-        }else
-        {
-            textureSamplerDescriptorInfos[i].imageView = emptyTexture.getImageView(); //image view of the texture
-        }
-        textureSamplerDescriptorInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; //what is the image layout when in use
-        textureSamplerDescriptorInfos[i].sampler = imageSampler; //the image sampler
-    }
-
-
-    VkWriteDescriptorSet textureSamplerDescriptorSet{};
-    textureSamplerDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    textureSamplerDescriptorSet.dstSet = *pixScene->getTextureDescriptorSet();
-    textureSamplerDescriptorSet.dstBinding = 0; //matches layout(binding = 0)
-    textureSamplerDescriptorSet.dstArrayElement = 0; //index in the array we want to update. we don't have an array to update here
-    textureSamplerDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    textureSamplerDescriptorSet.descriptorCount = static_cast<uint32_t>(textureSamplerDescriptorInfos.size()); //number of textures
-    textureSamplerDescriptorSet.pImageInfo = textureSamplerDescriptorInfos.data();
-
-    //update the descriptor sets with new buffer binding info
-    vkUpdateDescriptorSets(mainDevice.logicalDevice, 1, &textureSamplerDescriptorSet, 0, nullptr);
-
+    //SET 1 is the global texture table, written as textures are registered
 }
 
 void PixelRenderer::createDepthBuffer() {
@@ -1474,97 +2075,6 @@ void PixelRenderer::submitAndEndSingleUseCommandBuffer(VkCommandBuffer* commandB
     vkFreeCommandBuffers(mainDevice.logicalDevice, graphicsCommandPool, 1, commandBuffer);
 }
 
-void PixelRenderer::copySrcBuffertoDstImage(VkBuffer srcBuffer, VkImage dstImageBuffer, uint32_t width, uint32_t height) {
-
-    //copying buffer memory to image memory
-    VkCommandBuffer transferCommandBuffer = beginSingleUseCommandBuffer();
-
-    //region of data to copy from and too
-    VkBufferImageCopy bufferCopy{};
-    bufferCopy.bufferOffset = 0;
-    bufferCopy.bufferRowLength = 0; //for data spacing
-    bufferCopy.bufferImageHeight = 0; //for data spacing. because everything is 0, the data is tightly packed
-    bufferCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    bufferCopy.imageSubresource.layerCount = 1;
-    bufferCopy.imageSubresource.baseArrayLayer = 0;
-    bufferCopy.imageSubresource.mipLevel = 0; //TODO:: implement mipmap level for textures
-    bufferCopy.imageOffset = {0,0,0}; //start at the origin. no offset
-    bufferCopy.imageExtent = {width, height, 1}; //size of the region to copy
-
-    vkCmdCopyBufferToImage(transferCommandBuffer, srcBuffer, dstImageBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           1, &bufferCopy); //we have to specify as dst_optimal because it is receiving the data from a staging buffer.
-
-
-    submitAndEndSingleUseCommandBuffer(&transferCommandBuffer);
-}
-
-void PixelRenderer::transitionImageLayout(VkImage imageToTransition, VkImageLayout currentLayout, VkImageLayout newLayout)
-{
-
-    VkCommandBuffer commandBuffer = beginSingleUseCommandBuffer();
-
-    // 1- allows us to specify stage dependencies
-    // 2- allows us to transition image layout
-    VkImageMemoryBarrier imageMemoryBarrier{};
-    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    imageMemoryBarrier.oldLayout = currentLayout;
-    imageMemoryBarrier.newLayout = newLayout;
-    imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED; //don't bother transfer from queue. has to be specified
-    imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED; //don't bother transfer to queue. has to be specified
-    imageMemoryBarrier.image = imageToTransition;
-    imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    imageMemoryBarrier.subresourceRange.layerCount = 1;
-    imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
-    imageMemoryBarrier.subresourceRange.levelCount = 1;
-    imageMemoryBarrier.subresourceRange.baseMipLevel = 0; //TODO:: implement mipmap level for textures
-
-    VkPipelineStageFlags srcStage;
-    VkPipelineStageFlags dstStage;
-
-    if(currentLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-    {
-        imageMemoryBarrier.srcAccessMask = 0; //from the very start. there is no specified stage.
-        imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT; //we want the transfer to happen before this stage
-        //transfer write bit are operations like transfering memory from staging buffer to image buffer.
-
-        srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    } else if(currentLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-    {
-        imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT; //from the very start. there is no specified stage.
-        imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT; //we want the transfer to happen before this stage
-        //transfer write bit are operations like transfering memory from staging buffer to image buffer.
-
-        srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    }else if(currentLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-    {
-        imageMemoryBarrier.srcAccessMask = 0; //from the very start. there is no specified stage.
-        imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT; //we want the transfer to happen before this stage
-        //transfer write bit are operations like transfering memory from staging buffer to image buffer.
-
-        srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    }else if(currentLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_GENERAL)
-    {
-        imageMemoryBarrier.srcAccessMask = 0; //from the very start. there is no specified stage.
-        imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT; //we want the transfer to happen before this stage
-        //transfer write bit are operations like transfering memory from staging buffer to image buffer.
-
-        srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        dstStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-    }
-
-    vkCmdPipelineBarrier(commandBuffer,
-                         srcStage, dstStage, //match to src and dst access mask
-                         0,
-                         0, nullptr, //general memory barrier
-                         0, nullptr, //buffer memory barrier
-                         1, &imageMemoryBarrier); //image memory barrier
-
-    submitAndEndSingleUseCommandBuffer(&commandBuffer);
-}
-
 void PixelRenderer::transitionImageLayoutUsingCommandBuffer(VkCommandBuffer commandBuffer, VkImage imageToTransition, VkImageLayout currentLayout, VkImageLayout newLayout)
 {
 
@@ -1704,10 +2214,10 @@ void PixelRenderer::createTextureSampler() {
     samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     samplerCreateInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK; //not used because we use repeat
     samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
-    samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR; //TODO:Implement Mip Map
+    samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR; //blend between the two closest mip levels
     samplerCreateInfo.mipLodBias = 0.0f; //adding an offset to the mip map level
-    samplerCreateInfo.minLod = 0.0f; //TODO:Implement Mip Map
-    samplerCreateInfo.maxLod = 0.0f; //TODO:Implement Mip Map
+    samplerCreateInfo.minLod = 0.0f;
+    samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE; //the sampler is shared by every texture, each image view limits the range to its own levels
     samplerCreateInfo.anisotropyEnable = VK_TRUE;
     samplerCreateInfo.maxAnisotropy = 16; //number of samples taken for the anisotropy filtering
 
@@ -1800,7 +2310,7 @@ void PixelRenderer::imGuiParameters() {
                    ImGuiWindowFlags_NoMove); // Create a window called "Hello,
                                              // world!" and append into it.
 
-  ImGui::SetWindowSize(ImVec2(350.0f, 50.0f), 0);
+  ImGui::SetWindowSize(ImVec2(350.0f, 90.0f), 0);
 
   // ImGui::Text("Fog Effect intensity.");               // Display some text
   // (you can use a format strings too) static float test = 0.0f;
@@ -1860,6 +2370,47 @@ void PixelRenderer::imGuiParameters() {
   ImGui::Text("Application average %.3f ms/frame (%.1f FPS)",
               1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 
+  PixMemoryStats memoryStats = memoryAllocator.getStats();
+  ImGui::Text("GPU memory %.1f / %.1f MB (%u allocations, %u blocks)",
+              memoryStats.bytesInUse / (1024.0f * 1024.0f), memoryStats.bytesReserved / (1024.0f * 1024.0f),
+              memoryStats.allocationCount, memoryStats.blockCount);
+  ImGui::Text("free regions %u, fragmentation %.1f%%",
+              memoryStats.freeRegionCount, memoryStats.fragmentation * 100.0f);
+
+  PixelCullingPipeline::CullStats cullStats = cullingPipeline.getStats();
+  ImGui::Text("culling: %u tested, %u frustum culled, %u occluded, %u drawn",
+              cullStats.tested, cullStats.frustumCulled, cullStats.occlusionCulled, cullStats.drawn);
+  bool occlusionCulling = cullingPipeline.isOcclusionEnabled();
+  if(ImGui::Checkbox("occlusion culling", &occlusionCulling))
+  {
+      cullingPipeline.setOcclusionEnabled(occlusionCulling);
+  }
+
+  VkExtent2D computeExtent = computePipeline.getExtent();
+  ImGui::SliderFloat("ray trace scale", &computeRenderScale, MIN_COMPUTE_RENDER_SCALE, 1.0f);
+  ImGui::Text("ray traced at %ux%u", computeExtent.width, computeExtent.height);
+
+  //1 traces every tile that is not converged, each frame
+  ImGui::SliderFloat("samples per frame", &computeSampleRate, MIN_COMPUTE_SAMPLE_RATE, 1.0f);
+  computePipeline.setSampleBudget(computeSampleRate < 1.0f ? static_cast<uint32_t>(computeSampleRate * computeExtent.width * computeExtent.height) : 0);
+  float targetError = computePipeline.getTargetError();
+  if(ImGui::SliderFloat("target error", &targetError, 0.001f, 0.1f, "%.3f", ImGuiSliderFlags_Logarithmic))
+  {
+      computePipeline.setTargetError(targetError);
+  }
+  ImGui::Checkbox("animate the square", &animateSceneObject); //its ray traced copy is refit
+  bool heatmap = computePipeline.isHeatmapEnabled();
+  if(ImGui::Checkbox("tile error heatmap", &heatmap))
+  {
+      computePipeline.setHeatmapEnabled(heatmap);
+  }
+  PixelComputePipeline::SamplingStats samplingStats = computePipeline.getSamplingStats();
+  ImGui::Text("tiles: %u traced, %u copied, %u converged of %u (max error %.4f)",
+              samplingStats.tracedTiles, samplingStats.copiedTiles, samplingStats.convergedTiles,
+              samplingStats.tileCount, samplingStats.maxError);
+  ImGui::Text("samples: %llu this frame, %llu total", static_cast<unsigned long long>(samplingStats.samples),
+              static_cast<unsigned long long>(samplingStats.totalSamples));
+
   ImGui::End();
 }
 
@@ -1872,8 +2423,44 @@ void PixelRenderer::init_compute() {
 
     printf("Init Compute Pipeline\n");
     fflush(stdout);
-    computePipeline = PixelComputePipeline(&mainDevice, {});
-    computePipeline.init();
+    computePipeline = PixelComputePipeline(&mainDevice, getComputeExtent());
+
+    //ray traced scene: three spheres, a pyramid and the main scene's first object on a checkerboard
+    computePipeline.addSphere({0.0f, 0.0f, -3.0f}, 1.0f, {1.0f, 0.0f, 0.0f}, 0.5f);
+    computePipeline.addSphere({2.0f, 1.0f, -8.0f}, 2.0f, {1.0f, 0.3f, 0.0f}, 0.5f);
+    computePipeline.addSphere({-2.0f, -0.5f, -1.0f}, 0.5f, {0.0f, 0.5f, 1.0f}, 0.5f);
+    computePipeline.addPlane({0.0f, -1.0f, -5.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, 0.0f);
+
+    std::vector<PixelObject::Vertex> pyramidVertices = {
+            {{-0.5f,0.0f,-0.5f,1.0f}, {0.0f,-1.0f,0.0f,0.0f}, {1.0f,1.0f,1.0f,1.0f}, {0.0f,0.0f}},
+            {{0.5f,0.0f,-0.5f,1.0f},  {0.0f,-1.0f,0.0f,0.0f}, {1.0f,1.0f,1.0f,1.0f}, {1.0f,0.0f}},
+            {{0.5f,0.0f,0.5f,1.0f},   {0.0f,-1.0f,0.0f,0.0f}, {1.0f,1.0f,1.0f,1.0f}, {1.0f,1.0f}},
+            {{-0.5f,0.0f,0.5f,1.0f},  {0.0f,-1.0f,0.0f,0.0f}, {1.0f,1.0f,1.0f,1.0f}, {0.0f,1.0f}},
+            {{0.0f,1.0f,0.0f,1.0f},   {0.0f,1.0f,0.0f,0.0f},  {1.0f,1.0f,1.0f,1.0f}, {0.5f,0.5f}}
+    };
+    std::vector<uint32_t> pyramidIndices{
+            0,1,2, 0,2,3, //base
+            0,4,1, 1,4,2, 2,4,3, 3,4,0
+    };
+    auto pyramid = PixelObject(&mainDevice, pyramidVertices, pyramidIndices);
+    pyramid.setTransform(glm::translate(glm::mat4(1.0f), glm::vec3(1.2f, -1.0f, -2.5f)));
+    computePipeline.addMesh(&pyramid, {0.9f, 0.8f, 0.2f}, 0.2f);
+
+    //the quad of the main scene, left of the spheres. it goes through the same BVH as any loaded mesh
+    PixelObject* sceneObject = scenes[0].getObjectAt(0);
+    computeSceneMeshPlacement = glm::translate(glm::mat4(1.0f), glm::vec3(-1.5f, 0.5f, -5.5f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.75f));
+    computeSceneMeshTransform = sceneObject->getObjectData()->M;
+    computeSceneMesh = computePipeline.addMesh(sceneObject, {0.8f, 0.8f, 0.8f}, 0.3f);
+    computePipeline.setMeshTransform(computeSceneMesh, computeSceneMeshPlacement * computeSceneMeshTransform);
+
+    computePipeline.setJobSystem(&jobSystem);
+    computePipeline.init(MAX_FRAME_DRAWS);
+
+    const PixelBVH::Stats& bvhStats = computePipeline.getBVHStats();
+    printf("Ray traced BVH: %u triangles, %u nodes, %u leaves, depth %u, built in %.2f ms. per ray: %.1f node visits, %.1f triangle tests\n",
+           bvhStats.primitiveCount, bvhStats.nodeCount, bvhStats.leafCount, bvhStats.maxDepth, bvhStats.buildMs,
+           bvhStats.expectedNodeVisits, bvhStats.expectedPrimitiveTests);
+    fflush(stdout);
 
     for(int i = 0; i < 512; i++)
     {
@@ -1884,64 +2471,50 @@ void PixelRenderer::init_compute() {
     }
 }
 
-void PixelRenderer::recordComputeCommands(uint32_t currentImageIndex) {
-    VkCommandBufferBeginInfo bufferBeginInfo{};
-    bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+void PixelRenderer::updateComputeScene() {
 
-    VkResult result = vkBeginCommandBuffer(computeCommandBuffers[currentImageIndex], &bufferBeginInfo);
-    if(result != VK_SUCCESS)
+    const glm::mat4& transform = scenes[0].getObjectAt(0)->getObjectData()->M;
+    if(transform == computeSceneMeshTransform)
     {
-        throw std::runtime_error("failed to being recording compute command");
+        return;
     }
 
+    //the primitive buffers are read by every compute frame in flight. the tree is kept, only its boxes are refit
+    vkQueueWaitIdle(computeQueue);
+    computeSceneMeshTransform = transform;
+    computePipeline.setMeshTransform(computeSceneMesh, computeSceneMeshPlacement * computeSceneMeshTransform);
+    computePipeline.updatePrimitiveBuffers();
+    computePipeline.resetAccumulation();
+}
 
+void PixelRenderer::init_culling() {
 
-    transitionImageLayoutUsingCommandBuffer(computeCommandBuffers[currentImageIndex], computePipeline.getInputTexture()->getImage(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-    transitionImageLayoutUsingCommandBuffer(computeCommandBuffers[currentImageIndex], computePipeline.getOutputTexture()->getImage(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-    transitionImageLayoutUsingCommandBuffer(computeCommandBuffers[currentImageIndex], computePipeline.getCustomTexture()->getImage(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-
-    vkCmdBindPipeline(computeCommandBuffers[currentImageIndex], VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline.getPipeline());
-
-    std::array<VkDescriptorSet, 1> descriptorSets = {
-            computePipeline.getDescriptorSet()};
-    vkCmdBindDescriptorSets(computeCommandBuffers[currentImageIndex], VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline.getPipelineLayout(), 0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0, 0);
-
-    vkCmdPushConstants(computeCommandBuffers[currentImageIndex],
-                       computePipeline.getPipelineLayout(),
-                       VK_SHADER_STAGE_COMPUTE_BIT,
-                       0,
-                       PixelComputePipeline::pushComputeConstantRange.size,
-                       computePipeline.getPushObj());
-
-    vkCmdDispatch(computeCommandBuffers[currentImageIndex], 32, 32, 1);
-
-    transitionImageLayoutUsingCommandBuffer(computeCommandBuffers[currentImageIndex], computePipeline.getInputTexture()->getImage(), VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    transitionImageLayoutUsingCommandBuffer(computeCommandBuffers[currentImageIndex], computePipeline.getOutputTexture()->getImage(), VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-
+    printf("Init Culling Pipeline\n");
+    fflush(stdout);
+    cullingPipeline.init(&mainDevice, &depthImage, static_cast<uint32_t>(swapChainImages.size()));
+}
 
+VkExtent2D PixelRenderer::getComputeExtent() {
+    float scale = glm::clamp(computeRenderScale, MIN_COMPUTE_RENDER_SCALE, 1.0f);
+    return {std::max(static_cast<uint32_t>((float)swapChainExtent.width * scale + 0.5f), 1u),
+            std::max(static_cast<uint32_t>((float)swapChainExtent.height * scale + 0.5f), 1u)};
+}
 
-        VkImageCopy imageCopy{};
-        imageCopy.srcOffset = {0,0,0};
-        imageCopy.dstOffset = {0,0,0}; //for data spacing
-        imageCopy.extent = {computePipeline.getInputTexture()->getWidth(), computePipeline.getInputTexture()->getHeight(), 1};
-        imageCopy.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageCopy.srcSubresource.layerCount = 1;
-        imageCopy.srcSubresource.baseArrayLayer = 0;
-        imageCopy.srcSubresource.mipLevel = 0; //TODO:: implement mipmap level for textures
-        imageCopy.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageCopy.dstSubresource.layerCount = 1;
-        imageCopy.dstSubresource.baseArrayLayer = 0;
-        imageCopy.dstSubresource.mipLevel = 0; //TODO:: implement mipmap level for textures
+void PixelRenderer::recordComputeCommands(uint32_t currentImageIndex) {
+    VkCommandBufferBeginInfo bufferBeginInfo{};
+    bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-        vkCmdCopyImage(computeCommandBuffers[currentImageIndex],
-                       computePipeline.getOutputTexture()->getImage(),VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                       computePipeline.getInputTexture()->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                       1, &imageCopy);
+    VkResult result = vkBeginCommandBuffer(computeCommandBuffers[currentImageIndex], &bufferBeginInfo);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to being recording compute command");
+    }
 
+    //every sample looks through another point of the lens, the accumulation averages them into the depth of field
+    PixelComputePipeline::PObj* pushObj = computePipeline.getPushObj();
+    pushObj->randomOffsets = randomArray[pushObj->currentSample % randomArray.size()];
 
-    transitionImageLayoutUsingCommandBuffer(computeCommandBuffers[currentImageIndex], computePipeline.getInputTexture()->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    transitionImageLayoutUsingCommandBuffer(computeCommandBuffers[currentImageIndex], computePipeline.getCustomTexture()->getImage(), VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    transitionImageLayoutUsingCommandBuffer(computeCommandBuffers[currentImageIndex], computePipeline.getOutputTexture()->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    computePipeline.recordRaytracing(computeCommandBuffers[currentImageIndex], currentImageIndex);
 
     result = vkEndCommandBuffer(computeCommandBuffers[currentImageIndex]);
     if (result != VK_SUCCESS) {
@@ -1950,26 +2523,6 @@ void PixelRenderer::recordComputeCommands(uint32_t currentImageIndex) {
 
 }
 
-void PixelRenderer::updateComputeTextureDescriptor() {
-    std::array<VkWriteDescriptorSet,1> textureDescriptorInfo{};
-
-    VkDescriptorImageInfo textureSamplerDescriptorInfo{};
-    textureSamplerDescriptorInfo.imageView = computePipeline.getInputTexture()->getImageView();
-    textureSamplerDescriptorInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    textureSamplerDescriptorInfo.sampler = VK_NULL_HANDLE;
-
-    textureDescriptorInfo[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    textureDescriptorInfo[0].dstSet = computePipeline.getDescriptorSet();
-    textureDescriptorInfo[0].dstBinding = 0; //matches layout(binding = 0)
-    textureDescriptorInfo[0].dstArrayElement = 0; //index in the array we want to update. we don't have an array to update here
-    textureDescriptorInfo[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    textureDescriptorInfo[0].descriptorCount = static_cast<uint32_t>(1); //number of textures
-    textureDescriptorInfo[0].pImageInfo = &textureSamplerDescriptorInfo;
-
-    //update the descriptor sets with new buffer binding info
-    vkUpdateDescriptorSets(mainDevice.logicalDevice, 2, textureDescriptorInfo.data(), 0, nullptr);
-}
-
 void PixelRenderer::init_io() {
     printf("Initialization GLFW IO\n");
     fflush(stdout);
@@ -1981,9 +2534,16 @@ void PixelRenderer::init_io() {
 void PixelRenderer::preDraw() {
     imGuiParameters();
     double posX, posY;
+    int windowWidth, windowHeight;
     glfwGetCursorPos(pixWindow.getWindow(), &posX, &posY);
-    mouseCoord.x = (int)glm::clamp(posX, 0.0, 1024.0);
-    mouseCoord.y = (int)glm::clamp(posY, 0.0, 768.0);
+    glfwGetWindowSize(pixWindow.getWindow(), &windowWidth, &windowHeight);
+    mouseCoord.x = (int)glm::clamp(posX, 0.0, (double)windowWidth);
+    mouseCoord.y = (int)glm::clamp(posY, 0.0, (double)windowHeight);
+
+    //the outline is traced at the pixel under the mouse, in the resolution of the ray traced images
+    VkExtent2D computeExtent = computePipeline.getExtent();
+    computePipeline.getPushObj()->mouseCoordX = static_cast<uint32_t>(mouseCoord.x * computeExtent.width / std::max(windowWidth, 1));
+    computePipeline.getPushObj()->mouseCoordY = static_cast<uint32_t>(mouseCoord.y * computeExtent.height / std::max(windowHeight, 1));
     if(MPRESS_L || *ImGui::GetIO().MouseDown && guiItemHovered)
     {
         lastClicked.x = mouseCoord.x;
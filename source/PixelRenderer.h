@@ -9,6 +9,12 @@ const bool enableValidationLayers = true;
 #include "PixelWindow.h"
 #include "PixelGraphicsPipeline.h"
 #include "PixelComputePipeline.h"
+#include "PixelCullingPipeline.h"
+#include "PixelMemoryAllocator.h"
+#include "PixelUploadBatcher.h"
+#include "PixelTextureTable.h"
+#include "PixelJobSystem.h"
+#include "PixelAssetLoader.h"
 #include "Utility.h"
 
 #include <imgui.h>
@@ -23,6 +29,9 @@ const bool enableValidationLayers = true;
 #include <cstring>
 
 const int MAX_FRAME_DRAWS = 2; //we always have "MAX_FRAME_DRAWS" being drawing at once.
+const uint32_t MAX_RECORDING_THREADS = 16; //most secondary command buffers a scene is split in
+const float MIN_COMPUTE_RENDER_SCALE = 0.25f; //smallest ray traced resolution, relative to the swapchain
+const float MIN_COMPUTE_SAMPLE_RATE = 0.05f; //smallest ray traced sample budget, relative to the ray traced pixels
 static float dofFocus = 13.152946438f;
 static bool autoFocus = false;
 static bool autoFocusFinished = true;
@@ -43,9 +52,16 @@ public:
 	~PixelRenderer() = default;
 
 	int initRenderer();
+    int initHeadlessRenderer(uint32_t width, uint32_t height);
+    int initBenchmarkRenderer(uint32_t width, uint32_t height, uint32_t objectCount);
     void addScene(PixelScene* pixScene);
     void draw();
     void run();
+    void runHeadless(uint32_t frameCount);
+    void runRecordingBenchmark(uint32_t iterations);
+    void runLoadingBenchmark(uint32_t iterations);
+    void readbackFrame(std::vector<unsigned char>& pixels);
+    void saveFrame(const std::string& filename);
 	bool windowShouldClose();
 	void cleanup();
 
@@ -57,25 +73,34 @@ private:
 
 	//vulkan component
 #ifdef __APPLE__
-	const std::vector<const char*> deviceExtensions = {
+	std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME,
     "VK_KHR_portability_subset",
     "VK_EXT_descriptor_indexing"
 	};
 #else
-    const std::vector<const char*> deviceExtensions = {
+    std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 	};
 #endif
 
     //logical and physical device
     PixBackend mainDevice;
+    PixelMemoryAllocator memoryAllocator;
+    PixelUploadBatcher uploadBatcher;
+    PixelTextureTable textureTable;
+    PixelTextureStreamer textureStreamer;
+    PixelJobSystem jobSystem;
+    PixelAssetLoader assetLoader;
 
     //window component
     PixelWindow pixWindow{};
 
     //physical device features the logical device will be using
     VkPhysicalDeviceFeatures deviceFeatures = {};
+    VkPhysicalDeviceVulkan12Features enabledVulkan12Features = {};
+    bool multiDrawIndirectSupported = false;
+    bool drawIndirectCountSupported = false;
 
 	VkInstance instance{};
 	VkQueue graphicsQueue{};
@@ -85,10 +110,22 @@ private:
 	VkSwapchainKHR swapChain{};
     std::vector<VkFramebuffer> swapchainFramebuffers;
     std::vector<VkCommandBuffer> commandBuffers;
+    std::vector<std::vector<std::vector<VkCommandBuffer>>> sceneCommandBuffers; //[scene][image][recording thread] secondary, kept until the scene changes
+    std::vector<std::vector<uint64_t>> recordedSceneVersions; //[scene][image] draw state each buffer was recorded with
+    std::vector<VkCommandBuffer> guiCommandBuffers; //secondary, recorded every frame
     std::vector<VkCommandBuffer> computeCommandBuffers;
     std::vector<std::unique_ptr<PixelGraphicsPipeline>> graphicsPipelines;
+    std::vector<std::unique_ptr<PixelGraphicsPipeline>> packedGraphicsPipelines; //graphicsPipelines reading PackedVertex
     std::unique_ptr<PixelGraphicsPipeline> defaultGridGraphicsPipeline;
     PixelComputePipeline computePipeline;
+    float computeRenderScale = 1.0f; //ray traced resolution relative to the swapchain
+    float computeSampleRate = 1.0f; //ray traced samples per frame relative to the ray traced pixels
+    //the main scene's first object is traced too, moved into the ray traced scene by computeSceneMeshPlacement
+    uint32_t computeSceneMesh = 0;
+    glm::mat4 computeSceneMeshPlacement = glm::mat4(1.0f);
+    glm::mat4 computeSceneMeshTransform = glm::mat4(1.0f); //the object's transform its traced triangles were placed with
+    bool animateSceneObject = false;
+    PixelCullingPipeline cullingPipeline;
 
     //images
     std::vector<PixelImage> swapChainImages;
@@ -100,9 +137,20 @@ private:
 	VkFormat swapChainImageFormat{};
 	VkExtent2D swapChainExtent{};
 
+    //headless (offscreen) rendering
+    bool headless = false;
+    VkExtent2D headlessExtent{};
+    uint32_t benchmarkObjectCount = 0; //extra objects added to the default scene
+    bool perObjectDraws = false; //one draw call per object instead of one indirect draw per group
+    VkBuffer readbackBuffer{};
+    PixAllocation readbackBufferAllocation{};
+    uint32_t lastRenderedImage = 0;
+
     // Pools
     VkCommandPool graphicsCommandPool{};
     VkCommandPool computeCommandPool{};
+    std::vector<VkCommandPool> recordingCommandPools; //one per recording thread, a pool is only used by one thread at a time
+    uint32_t recordingThreadCount = 1; //secondary command buffers each scene is split in
 
     // gui ressources
     VkDescriptorPool imguiPool{};
@@ -120,6 +168,7 @@ private:
     std::vector<VkSemaphore> renderFinishedSemaphore;
     std::vector<VkSemaphore> computeFinishedSemaphore;
     std::vector<VkFence> inFlightDrawFences;
+    std::vector<VkFence> imagesInFlight; //per swapchain image, the draw fence of the frame that last rendered it
     std::vector<VkFence> inFlightComputeFences;
     int currentFrame = 0;
     std::array<glm::vec3, 512> randomArray;
@@ -129,12 +178,15 @@ private:
 	PixelScene defaultGridScene{};
 
 	//---------vulkan functions
+	int initVulkan();
+
 	//create functions
 	void createInstance();
 	void setupPhysicalDevice();
 	void createLogicalDevice();
 	void createSurface();
 	void createSwapChain();
+    void createOffscreenTargets();
     void createGraphicsPipelines();
     void createFramebuffers();
     void createCommandPools();
@@ -146,12 +198,20 @@ private:
 	void initializeScenes();
     void createSynchronizationObjects();
     void recordCommands(uint32_t currentImageIndex);
+    void recordSceneCommands(int sceneIndx, uint32_t currentImageIndex);
+    void recordSceneCommandRange(int sceneIndx, uint32_t currentImageIndex, uint32_t rangeIndex, uint32_t firstDraw, uint32_t endDraw);
+    void setRecordingThreadCount(uint32_t threadCount);
+    void recordGuiCommands(uint32_t currentImageIndex);
+    void createSceneCommandBuffers();
     void recordComputeCommands(uint32_t currentImageIndex);
+    void updateComputeScene(); //refits the traced copy of the scene's object when it moved
+    VkExtent2D getComputeExtent();
     VkCommandBuffer beginSingleUseCommandBuffer();
     void submitAndEndSingleUseCommandBuffer(VkCommandBuffer* commandBuffer);
 	QueueFamilyIndices setupQueueFamilies(VkPhysicalDevice device);
 	void init_io();
     void init_compute();
+    void init_culling();
 	void preDraw();
 
     //gui functions
@@ -163,7 +223,6 @@ private:
 	void createDescriptorPool(PixelScene* pixScene);
 	void createDescriptorSets(PixelScene* pixScene);
 	void createUniformBuffers(PixelScene* pixScene);
-    void updateComputeTextureDescriptor();
 
     //debug validation layer
     void setupDebugMessenger();
@@ -173,21 +232,19 @@ private:
 	bool checkIfPhysicalDeviceSuitable(VkPhysicalDevice device);
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device);
 	VkExtent2D chooseSwapChainExtent(VkSurfaceCapabilitiesKHR surfaceCapabilities);
-    void transitionImageLayout(VkImage imageToTransition, VkImageLayout currentLayout, VkImageLayout newLayout);
     void transitionImageLayoutUsingCommandBuffer(VkCommandBuffer commandBuffer, VkImage imageToTransition, VkImageLayout currentLayout, VkImageLayout newLayout);
     void createBuffer(VkDeviceSize bufferSize,
                      VkBufferUsageFlags bufferUsageFlags, VkMemoryPropertyFlags bufferproperties,
-                     VkBuffer* buffer, VkDeviceMemory* bufferMemory);
-    void copySrcBuffertoDstBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize bufferSize);
-    void copySrcBuffertoDstImage(VkBuffer srcBuffer, VkImage dstImageBuffer, uint32_t width, uint32_t height);
+                     VkBuffer* buffer, PixAllocation* bufferAllocation);
 
-    void initializeObjectBuffers(PixelObject* pixObject);
-    void createVertexBuffer(PixelObject* pixObject);
-    void createIndexBuffer(PixelObject* pixObject);
+    void createGeometryBuffers(PixelScene* pixScene);
+    void updateSceneGeometry(PixelScene* pixScene); //packs and uploads objects added after init
+    void createObjectTextures(PixelObject* pixObject);
     void createTextureBuffer(PixelImage* pixImage);
     void createTextureSampler();
 
     void updateSceneCamera(PixelScene* pixScene);
+    void remapTextureIndex(int oldIndex, int newIndex);
 
 	//getter functions
 	SwapchainDetails getSwapChainDetails(VkPhysicalDevice device);
@@ -3,11 +3,13 @@
 //
 
 #include "PixelScene.h"
+#include "PixelTextureTable.h"
 #include "glm/glm.hpp"
 #include "glm/ext/matrix_relational.hpp"
 
 #include <vector>
 #include <cstdlib>
+#include <algorithm>
 
 PixelScene::PixelScene(PixBackend* backend) : m_backend(backend)
 {
@@ -18,24 +20,20 @@ PixelScene::PixelScene(PixBackend* backend) : m_backend(backend)
 void PixelScene::cleanup()
 {
 
-#ifdef __APPLE__
-    free(modelTransferSpace);
-
-#else
-    _aligned_free(modelTransferSpace);
-#endif
-
-
     vkDestroyDescriptorPool(m_backend->logicalDevice, m_descriptorPool, nullptr);
     vkDestroyDescriptorSetLayout(m_backend->logicalDevice, m_descriptorSetLayouts[UBOS], nullptr);
-    vkDestroyDescriptorSetLayout(m_backend->logicalDevice, m_descriptorSetLayouts[TEXTURES], nullptr);
     for(int i = 0; i < uniformBuffers.size(); i++)
     {
-        vkDestroyBuffer(m_backend->logicalDevice, dynamicUniformBuffers[i], nullptr);
-        vkFreeMemory(m_backend->logicalDevice, dynamicUniformBufferMemories[i], nullptr);
-        vkDestroyBuffer(m_backend->logicalDevice, uniformBuffers[i], nullptr);
-        vkFreeMemory(m_backend->logicalDevice, uniformBufferMemories[i], nullptr);
+        m_backend->allocator->destroyBuffer(&objectBuffers[i], &objectBufferAllocations[i]);
+        m_backend->allocator->destroyBuffer(&uniformBuffers[i], &uniformBufferAllocations[i]);
+        m_backend->allocator->destroyBuffer(&drawCandidateBuffers[i], &drawCandidateBufferAllocations[i]);
+        m_backend->allocator->destroyBuffer(&indirectBuffers[i], &indirectBufferAllocations[i]);
+        m_backend->allocator->destroyBuffer(&drawCountBuffers[i], &drawCountBufferAllocations[i]);
     }
+    destroyRetiredBuffers(true);
+
+    m_backend->allocator->destroyBuffer(&vertexBuffer, &vertexBufferAllocation);
+    m_backend->allocator->destroyBuffer(&indexBuffer, &indexBufferAllocation);
 
     for(auto& object : allObjects)
     {
@@ -61,24 +59,30 @@ VkBuffer* PixelScene::getUniformBuffers(int index) {
     return &(uniformBuffers[index]);
 }
 
-VkDeviceMemory* PixelScene::getUniformBufferMemories(int index) {
-    return &(uniformBufferMemories[index]);
+PixAllocation* PixelScene::getUniformBufferAllocations(int index) {
+    return &(uniformBufferAllocations[index]);
 }
 
 void PixelScene::resizeBuffers(size_t newSize) {
     uniformBuffers.resize(newSize);
-    uniformBufferMemories.resize(newSize);
-    dynamicUniformBuffers.resize(newSize);
-    dynamicUniformBufferMemories.resize(newSize);
-    buffersUpdated.resize(newSize, false);
+    uniformBufferAllocations.resize(newSize);
+    objectBuffers.resize(newSize);
+    objectBufferAllocations.resize(newSize);
+    drawCandidateBuffers.resize(newSize);
+    drawCandidateBufferAllocations.resize(newSize);
+    indirectBuffers.resize(newSize);
+    indirectBufferAllocations.resize(newSize);
+    drawCountBuffers.resize(newSize);
+    drawCountBufferAllocations.resize(newSize);
+    objectBufferCapacities.resize(newSize, std::max<uint32_t>(MIN_OBJECT_CAPACITY, static_cast<uint32_t>(allObjects.size())));
+    drawBufferCapacities.resize(newSize, std::max<uint32_t>(MIN_OBJECT_CAPACITY, static_cast<uint32_t>(allObjects.size())));
+    writtenSceneVPVersions.resize(newSize, 0); //0 is never a valid version, every buffer gets written once
+    writtenObjectVersions.resize(newSize);
 }
 
 void PixelScene::addObject(PixelObject pixObject) {
-    if(pixObject.getTextures().size() > 0)
-    {
-        pixObject.setTextureIDOffset(getAllTextures().size());
-    }
     allObjects.push_back(pixObject);
+    drawStateVersion++;
 }
 
 int PixelScene::getNumObjects() {
@@ -107,23 +111,23 @@ std::vector<VkDescriptorSet>* PixelScene::getUniformDescriptorSets() {
 
 void PixelScene::updateUniformBuffer(uint32_t bufferIndex)
 {
+        //this buffer already holds the current view projection
+        if(writtenSceneVPVersions[bufferIndex] == sceneVPVersion)
+        {
+            return;
+        }
 
-        UboVP scenePFlipped = sceneVP;
-
-		scenePFlipped.P[1][1] *= -1; //invert the y scale to flip the image. Vulkan is flipped by default
-
-        void* data;
-        vkMapMemory(m_backend->logicalDevice, uniformBufferMemories[bufferIndex], 0, getUniformBufferSize(),0,&data);
-        memcpy(data, &scenePFlipped, getUniformBufferSize());
-        vkUnmapMemory(m_backend->logicalDevice, uniformBufferMemories[bufferIndex]);
+        //uniform buffers live in persistently mapped memory, write straight into them
+        auto* mappedVP = static_cast<UboVP*>(uniformBufferAllocations[bufferIndex].mappedData);
+        *mappedVP = sceneVP;
+        mappedVP->P[1][1] *= -1; //invert the y scale to flip the image. Vulkan is flipped by default
 
-        buffersUpdated[bufferIndex] = true;
+        writtenSceneVPVersions[bufferIndex] = sceneVPVersion;
 }
 
 void PixelScene::createDescriptorSetLayout() {
 
     VkDescriptorSetLayout uniformDescriptorSetLayout{};
-    VkDescriptorSetLayout textureDescriptorSetLayout{};
 
     //how data is bound to the shader in binding 0
     VkDescriptorSetLayoutBinding uniformBufferLayoutBinding{};
@@ -134,22 +138,14 @@ void PixelScene::createDescriptorSetLayout() {
     uniformBufferLayoutBinding.pImmutableSamplers = nullptr;
 
     //how data is bound to the shader in binding 1
-    VkDescriptorSetLayoutBinding dynamicBufferLayoutBinding{};
-    dynamicBufferLayoutBinding.binding = 1; //binding point in shader
-    dynamicBufferLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    dynamicBufferLayoutBinding.descriptorCount = 1; //only binding one uniform buffer
-    dynamicBufferLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    dynamicBufferLayoutBinding.pImmutableSamplers = nullptr;
-
-    //how data is bound to the shader in binding 2
-    VkDescriptorSetLayoutBinding textureSamplerLayoutBinding{};
-    textureSamplerLayoutBinding.binding = 0; //binding point in shader
-    textureSamplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    textureSamplerLayoutBinding.descriptorCount = static_cast<uint32_t>(MAX_TEXTURE_PER_OBJECT); //only binding one combine image sampler buffer
-    textureSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    textureSamplerLayoutBinding.pImmutableSamplers = nullptr;
-
-    std::array<VkDescriptorSetLayoutBinding, 2> descriptorSetLayoutBindings = {uniformBufferLayoutBinding, dynamicBufferLayoutBinding};
+    VkDescriptorSetLayoutBinding objectBufferLayoutBinding{};
+    objectBufferLayoutBinding.binding = 1; //binding point in shader
+    objectBufferLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; //object table, indexed by the instance index
+    objectBufferLayoutBinding.descriptorCount = 1;
+    objectBufferLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    objectBufferLayoutBinding.pImmutableSamplers = nullptr;
+
+    std::array<VkDescriptorSetLayoutBinding, 2> descriptorSetLayoutBindings = {uniformBufferLayoutBinding, objectBufferLayoutBinding};
 
     //Create descriptor set layout given binding
     VkDescriptorSetLayoutCreateInfo uniformBufferObjectDescriptorSetlayoutCreateInfo{};
@@ -163,20 +159,8 @@ void PixelScene::createDescriptorSetLayout() {
         throw std::runtime_error("Failed to create descriptor set layout for ubos");
     }
 
-    //Create descriptor set layout given binding
-    VkDescriptorSetLayoutCreateInfo textureDescriptorSetLayoutCreateInfo{};
-    textureDescriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    textureDescriptorSetLayoutCreateInfo.pBindings = &textureSamplerLayoutBinding;
-    textureDescriptorSetLayoutCreateInfo.bindingCount = 1;
-
-    result = vkCreateDescriptorSetLayout(m_backend->logicalDevice, &textureDescriptorSetLayoutCreateInfo, nullptr, &textureDescriptorSetLayout);
-    if(result != VK_SUCCESS)
-    {
-        throw std::runtime_error("Failed to create descriptor set layout for textures");
-    }
-
     m_descriptorSetLayouts.push_back(uniformDescriptorSetLayout);
-    m_descriptorSetLayouts.push_back(textureDescriptorSetLayout);
+    m_descriptorSetLayouts.push_back(*m_backend->textureTable->getDescriptorSetLayout()); //owned by the texture table
 }
 
 PixelScene::UboVP PixelScene::getSceneVP() {
@@ -185,15 +169,24 @@ PixelScene::UboVP PixelScene::getSceneVP() {
 
 void PixelScene::setSceneVP(PixelScene::UboVP vpData)
 {
-    sceneVP = vpData;
+    //the camera sets this every frame, only count it as a change when it actually moved
+    if(memcmp(&sceneVP, &vpData, sizeof(UboVP)) != 0)
+    {
+        sceneVP = vpData;
+        sceneVPVersion++;
+    }
 }
 
 void PixelScene::setSceneV(glm::mat4 V) {
-    sceneVP.V = glm::mat4(V);
+    UboVP vpData = sceneVP;
+    vpData.V = glm::mat4(V);
+    setSceneVP(vpData);
 }
 
 void PixelScene::setSceneP(glm::mat4 P) {
-    sceneVP.P = glm::mat4(P);
+    UboVP vpData = sceneVP;
+    vpData.P = glm::mat4(P);
+    setSceneVP(vpData);
 }
 
 bool PixelScene::areMatricesEqual(glm::mat4 x, glm::mat4 y) {
@@ -212,76 +205,332 @@ bool PixelScene::areMatricesEqual(glm::mat4 x, glm::mat4 y) {
     return true;
 }
 
-void PixelScene::allocateDynamicBufferTransferSpace()
-{
-    //calculate allignment
-    objectUBOAllignment = (sizeof(PixelObject::DynamicUBObj) + minUBOOffset - 1) & ~(minUBOOffset - 1); //right portion is our mask
+VkBuffer *PixelScene::getObjectBuffers(int index) {
+    return &(objectBuffers[index]);
+}
 
-    
-#ifdef __APPLE__
-//create memory for all the objects dynamic buffers;
-    modelTransferSpace = (PixelObject::DynamicUBObj*) aligned_alloc(minUBOOffset, objectUBOAllignment * MAX_OBJECTS);
-#else
-//create memory for all the objects dynamic buffers;
-    modelTransferSpace = (PixelObject::DynamicUBObj*) _aligned_malloc(objectUBOAllignment * MAX_OBJECTS, minUBOOffset);
-#endif
+PixAllocation *PixelScene::getObjectBufferAllocations(int index) {
+    return &(objectBufferAllocations[index]);
+}
 
+VkDeviceSize PixelScene::getObjectBufferSize() const {
+    return sizeof(PixelObject::ObjectData) * std::max<uint32_t>(MIN_OBJECT_CAPACITY, static_cast<uint32_t>(allObjects.size()));
 }
 
-void PixelScene::getMinUBOOffset(VkPhysicalDevice physicalDevice) {
-    VkPhysicalDeviceProperties physicalDeviceProperties{};
-    vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
-    minUBOOffset = physicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
+void PixelScene::updateObjectBuffer(uint32_t bufferIndex) {
+
+    objectBufferFrame++;
+    destroyRetiredBuffers(false);
+
+    if(allObjects.size() > objectBufferCapacities[bufferIndex])
+    {
+        growObjectBuffer(bufferIndex);
+    }
+
+    auto& writtenVersions = writtenObjectVersions[bufferIndex];
+    writtenVersions.resize(allObjects.size(), 0);
+
+    auto* objectTable = static_cast<PixelObject::ObjectData*>(objectBufferAllocations[bufferIndex].mappedData);
+
+    //write each stale object straight into its record of the persistently mapped table
+    for(size_t i = 0; i<allObjects.size(); i++)
+    {
+        uint32_t objectVersion = allObjects[i].getObjectDataVersion();
+        if(writtenVersions[i] == objectVersion)
+        {
+            continue;
+        }
+
+        objectTable[i] = *(allObjects[i].getObjectData());
+        writtenVersions[i] = objectVersion;
+    }
 }
 
-VkBuffer *PixelScene::getDynamicUniformBuffers(int index) {
-    return &(dynamicUniformBuffers[index]);
+void PixelScene::growObjectBuffer(uint32_t bufferIndex) {
+
+    uint32_t newCapacity = objectBufferCapacities[bufferIndex];
+    while(newCapacity < allObjects.size())
+    {
+        newCapacity *= 2;
+    }
+
+    printf("Growing object table %u to %u objects\n", bufferIndex, newCapacity);
+    fflush(stdout);
+
+    //the old table may still be read by a frame in flight. keep it around for a full round of frames instead of waiting on it
+    retiredBuffers.push_back({objectBuffers[bufferIndex], objectBufferAllocations[bufferIndex], objectBufferFrame + objectBuffers.size() + 1});
+
+    m_backend->allocator->createBuffer(sizeof(PixelObject::ObjectData) * newCapacity,
+                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       &objectBuffers[bufferIndex], &objectBufferAllocations[bufferIndex]);
+    objectBufferCapacities[bufferIndex] = newCapacity;
+
+    //the new table is empty, every object has to be written again
+    writtenObjectVersions[bufferIndex].assign(writtenObjectVersions[bufferIndex].size(), 0);
+
+    //this frame's descriptor set is about to be used by the command buffer we record next
+    writeObjectBufferDescriptor(bufferIndex);
+
+    //command buffers recorded with the old descriptor are invalid now
+    drawStateVersion++;
 }
 
-VkDeviceMemory *PixelScene::getDynamicUniformBufferMemories(int index) {
-    return &(dynamicUniformBufferMemories[index]);
+void PixelScene::createDrawBuffers(uint32_t bufferIndex) {
+
+    //candidates are written by the cpu every frame, commands and counts by the culling pass
+    m_backend->allocator->createBuffer(getDrawCandidateBufferSize(static_cast<int>(bufferIndex)),
+                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       &drawCandidateBuffers[bufferIndex], &drawCandidateBufferAllocations[bufferIndex]);
+
+    m_backend->allocator->createBuffer(getIndirectBufferSize(static_cast<int>(bufferIndex)),
+                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                       &indirectBuffers[bufferIndex], &indirectBufferAllocations[bufferIndex]);
+
+    m_backend->allocator->createBuffer(getDrawCountBufferSize(static_cast<int>(bufferIndex)),
+                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                       &drawCountBuffers[bufferIndex], &drawCountBufferAllocations[bufferIndex]);
 }
 
-VkDeviceSize PixelScene::getDynamicUniformBufferSize() const {
-    return objectUBOAllignment * MAX_OBJECTS;
+void PixelScene::growDrawBuffers(uint32_t bufferIndex) {
+
+    uint32_t newCapacity = drawBufferCapacities[bufferIndex];
+    while(newCapacity < allObjects.size())
+    {
+        newCapacity *= 2;
+    }
+
+    printf("Growing draw buffers %u to %u draws\n", bufferIndex, newCapacity);
+    fflush(stdout);
+
+    //like the object table, the old buffers may still be read by a frame in flight
+    uint64_t releaseFrame = objectBufferFrame + objectBuffers.size() + 1;
+    retiredBuffers.push_back({drawCandidateBuffers[bufferIndex], drawCandidateBufferAllocations[bufferIndex], releaseFrame});
+    retiredBuffers.push_back({indirectBuffers[bufferIndex], indirectBufferAllocations[bufferIndex], releaseFrame});
+    retiredBuffers.push_back({drawCountBuffers[bufferIndex], drawCountBufferAllocations[bufferIndex], releaseFrame});
+
+    drawBufferCapacities[bufferIndex] = newCapacity;
+    createDrawBuffers(bufferIndex);
+
+    //command buffers recorded with the old indirect and count buffers are invalid now. the culling pass rewrites its
+    //descriptor set when it sees the new buffers
+    drawStateVersion++;
 }
 
-VkDeviceSize PixelScene::getMinAlignment() const {
-    return objectUBOAllignment;
+void PixelScene::writeObjectBufferDescriptor(uint32_t bufferIndex) {
+
+    VkDescriptorBufferInfo objectBufferInfo{};
+    objectBufferInfo.buffer = objectBuffers[bufferIndex];
+    objectBufferInfo.offset = 0;
+    objectBufferInfo.range = VK_WHOLE_SIZE; //the shader sees a runtime sized array over the whole table
+
+    VkWriteDescriptorSet objectBufferSet{};
+    objectBufferSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    objectBufferSet.dstSet = m_uniformDescriptorSets[bufferIndex];
+    objectBufferSet.dstBinding = 1; //matches layout(binding = 1)
+    objectBufferSet.dstArrayElement = 0;
+    objectBufferSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    objectBufferSet.descriptorCount = 1;
+    objectBufferSet.pBufferInfo = &objectBufferInfo;
+
+    vkUpdateDescriptorSets(m_backend->logicalDevice, 1, &objectBufferSet, 0, nullptr);
 }
 
-void PixelScene::updateDynamicUniformBuffer(uint32_t bufferIndex) {
-    for(size_t i = 0; i<allObjects.size(); i++)
+void PixelScene::destroyRetiredBuffers(bool destroyAll) {
+
+    for(auto it = retiredBuffers.begin(); it != retiredBuffers.end();)
     {
-        auto* currentPushM = (PixelObject::DynamicUBObj*)((uint64_t)modelTransferSpace + (i * objectUBOAllignment));
-        *currentPushM = *(allObjects[i].getDynamicUBObj());
+        if(destroyAll || it->releaseFrame <= objectBufferFrame)
+        {
+            m_backend->allocator->destroyBuffer(&it->buffer, &it->allocation);
+            it = retiredBuffers.erase(it);
+        } else
+        {
+            ++it;
+        }
     }
-
-    //map the whole chunk of memory data
-    void* data;
-    vkMapMemory(m_backend->logicalDevice, dynamicUniformBufferMemories[bufferIndex], 0, objectUBOAllignment * allObjects.size() , 0 , &data);
-    memcpy(data, modelTransferSpace, objectUBOAllignment * allObjects.size());
-    vkUnmapMemory(m_backend->logicalDevice, dynamicUniformBufferMemories[bufferIndex]);
 }
 
 void PixelScene::initialize() {
-    getMinUBOOffset(m_backend->physicalDevice);
-    allocateDynamicBufferTransferSpace();
     createDescriptorSetLayout();
 }
 
-std::vector<PixelImage> PixelScene::getAllTextures() {
-    std::vector<PixelImage> allTextures;
+void PixelScene::packGeometry() {
 
-    for(int i = 0 ; i < allObjects.size(); i++)
+    //place every mesh back to back in the shared buffers. vertices of different formats have different strides,
+    //each format gets its own region of the vertex buffer
+    uint32_t firstIndex = 0;
+    std::array<int32_t, PixelObject::VERTEX_FORMAT_COUNT> vertexOffsets{};
+    for(auto& object : allObjects)
     {
-        for(int j = 0; j < allObjects[i].getTextures().size(); j++)
+        PixelObject::VertexFormat vertexFormat = object.getVertexFormat();
+        object.setGeometryOffsets(firstIndex, vertexOffsets[vertexFormat]);
+        firstIndex += static_cast<uint32_t>(object.getIndexCount());
+        vertexOffsets[vertexFormat] += object.getVertexCount();
+    }
+
+    vertexBufferSize = 0;
+    for(int vertexFormat = 0; vertexFormat < PixelObject::VERTEX_FORMAT_COUNT; vertexFormat++)
+    {
+        vertexRegionOffsets[vertexFormat] = (vertexBufferSize + 15) & ~VkDeviceSize(15); //keep every attribute aligned
+        vertexBufferSize = vertexRegionOffsets[vertexFormat] +
+                PixelObject::getVertexStride(static_cast<PixelObject::VertexFormat>(vertexFormat)) * static_cast<VkDeviceSize>(vertexOffsets[vertexFormat]);
+    }
+    indexBufferSize = sizeof(uint32_t) * static_cast<VkDeviceSize>(firstIndex);
+    packedObjectCount = static_cast<uint32_t>(allObjects.size());
+
+    buildDrawGroups();
+}
+
+void PixelScene::retireGeometryBuffers() {
+
+    uint64_t releaseFrame = objectBufferFrame + objectBuffers.size() + 1;
+    if(vertexBuffer != VK_NULL_HANDLE)
+    {
+        retiredBuffers.push_back({vertexBuffer, vertexBufferAllocation, releaseFrame});
+        vertexBuffer = VK_NULL_HANDLE;
+    }
+    if(indexBuffer != VK_NULL_HANDLE)
+    {
+        retiredBuffers.push_back({indexBuffer, indexBufferAllocation, releaseFrame});
+        indexBuffer = VK_NULL_HANDLE;
+    }
+
+    //the recorded draws bind the old buffers
+    drawStateVersion++;
+}
+
+void PixelScene::buildDrawGroups() {
+
+    //sort the objects by pipeline and vertex format so each pair draws one contiguous range of commands
+    drawOrder.resize(allObjects.size());
+    for(uint32_t i = 0; i < drawOrder.size(); i++)
+    {
+        drawOrder[i] = i;
+    }
+    std::stable_sort(drawOrder.begin(), drawOrder.end(), [this](uint32_t a, uint32_t b){
+        if(allObjects[a].getGraphicsPipelineIndex() != allObjects[b].getGraphicsPipelineIndex())
+        {
+            return allObjects[a].getGraphicsPipelineIndex() < allObjects[b].getGraphicsPipelineIndex();
+        }
+        return allObjects[a].getVertexFormat() < allObjects[b].getVertexFormat();
+    });
+
+    drawGroups.clear();
+    for(uint32_t i = 0; i < drawOrder.size(); i++)
+    {
+        int pipelineIndex = allObjects[drawOrder[i]].getGraphicsPipelineIndex();
+        PixelObject::VertexFormat vertexFormat = allObjects[drawOrder[i]].getVertexFormat();
+        if(drawGroups.empty() || drawGroups.back().pipelineIndex != pipelineIndex || drawGroups.back().vertexFormat != vertexFormat)
+        {
+            DrawGroup group{};
+            group.pipelineIndex = pipelineIndex;
+            group.vertexFormat = vertexFormat;
+            group.firstCommand = i;
+            drawGroups.push_back(group);
+        }
+        drawGroups.back().maxDrawCount++;
+    }
+
+    seenObjectDrawVersions.resize(allObjects.size());
+    for(size_t i = 0; i < allObjects.size(); i++)
+    {
+        seenObjectDrawVersions[i] = allObjects[i].getDrawStateVersion();
+    }
+    drawStateVersion++;
+}
+
+void PixelScene::refreshDrawState() {
+
+    //an object was hidden, shown or moved to another pipeline since the groups were built
+    bool changed = seenObjectDrawVersions.size() != allObjects.size();
+    for(size_t i = 0; !changed && i < allObjects.size(); i++)
+    {
+        changed = seenObjectDrawVersions[i] != allObjects[i].getDrawStateVersion();
+    }
+
+    if(changed)
+    {
+        buildDrawGroups();
+    }
+}
+
+void PixelScene::updateDrawCandidates(uint32_t bufferIndex) {
+
+    if(allObjects.size() > drawBufferCapacities[bufferIndex])
+    {
+        growDrawBuffers(bufferIndex);
+    }
+
+    auto* drawCandidates = static_cast<DrawCandidate*>(drawCandidateBufferAllocations[bufferIndex].mappedData);
+
+    //candidates keep the group order, the culling pass compacts the survivors of each group
+    drawCandidateCount = 0;
+    for(size_t groupIndex = 0; groupIndex < drawGroups.size(); groupIndex++)
+    {
+        DrawGroup& group = drawGroups[groupIndex];
+        group.drawCount = 0;
+
+        for(uint32_t i = group.firstCommand; i < group.firstCommand + group.maxDrawCount; i++)
         {
-            allTextures.push_back(allObjects[i].getTextures()[j]);
+            uint32_t objectIndex = drawOrder[i];
+            PixelObject& object = allObjects[objectIndex];
+            if(object.isHidden() || object.getIndexCount() == 0)
+            {
+                continue;
+            }
+
+            DrawCandidate& candidate = drawCandidates[drawCandidateCount++];
+            candidate.command.indexCount = static_cast<uint32_t>(object.getIndexCount());
+            candidate.command.instanceCount = 1;
+            candidate.command.firstIndex = object.getFirstIndex();
+            candidate.command.vertexOffset = object.getVertexOffset();
+            candidate.command.firstInstance = objectIndex; //the vertex shader reads the object table with it
+            candidate.groupIndex = static_cast<uint32_t>(groupIndex);
+            candidate.groupFirstCommand = group.firstCommand;
+            candidate.commandSlot = group.firstCommand + group.drawCount;
+            group.drawCount++;
         }
     }
+}
+
+VkBuffer *PixelScene::getDrawCandidateBuffers(int index) {
+    return &(drawCandidateBuffers[index]);
+}
+
+PixAllocation *PixelScene::getDrawCandidateBufferAllocations(int index) {
+    return &(drawCandidateBufferAllocations[index]);
+}
+
+VkDeviceSize PixelScene::getDrawCandidateBufferSize(int index) const {
+    return sizeof(DrawCandidate) * static_cast<VkDeviceSize>(drawBufferCapacities[index]);
+}
+
+VkBuffer *PixelScene::getIndirectBuffers(int index) {
+    return &(indirectBuffers[index]);
+}
+
+PixAllocation *PixelScene::getIndirectBufferAllocations(int index) {
+    return &(indirectBufferAllocations[index]);
+}
+
+VkDeviceSize PixelScene::getIndirectBufferSize(int index) const {
+    return sizeof(VkDrawIndexedIndirectCommand) * static_cast<VkDeviceSize>(drawBufferCapacities[index]);
+}
+
+VkBuffer *PixelScene::getDrawCountBuffers(int index) {
+    return &(drawCountBuffers[index]);
+}
+
+PixAllocation *PixelScene::getDrawCountBufferAllocations(int index) {
+    return &(drawCountBufferAllocations[index]);
+}
 
-    return allTextures;
+VkDeviceSize PixelScene::getDrawCountBufferSize(int index) const {
+    return sizeof(uint32_t) * static_cast<VkDeviceSize>(drawBufferCapacities[index]); //at most one group per object
 }
 
 std::vector<VkDescriptorSetLayout> *PixelScene::getAllDescriptorSetLayouts() {
@@ -289,7 +538,7 @@ std::vector<VkDescriptorSetLayout> *PixelScene::getAllDescriptorSetLayouts() {
 }
 
 VkDescriptorSet *PixelScene::getTextureDescriptorSet() {
-    return &m_textureDescriptorSet;
+    return m_backend->textureTable->getDescriptorSet(); //textures are global, every scene binds the same table
 }
 
 glm::vec3 PixelScene::getCameraPos() {
@@ -15,8 +15,7 @@ static const glm::mat4 MAT4_IDENTITY = {1,0,0,0,
                                         0,0,1,0,
                                         0,0,0,1};
 
-const int MAX_OBJECTS = 10;
-const int MAX_TEXTURE_PER_OBJECT = 16;
+const uint32_t MIN_OBJECT_CAPACITY = 64; //smallest object table, it doubles from there
 enum DescSetLayoutIndex{
     UBOS,
     TEXTURES
@@ -24,6 +23,24 @@ enum DescSetLayoutIndex{
 
 class PixelScene {
 public:
+
+    //objects drawn with one pipeline and vertex format. their commands are contiguous in the indirect buffer
+    struct DrawGroup{
+        int pipelineIndex = 0;
+        PixelObject::VertexFormat vertexFormat = PixelObject::VERTEX_FORMAT_FULL;
+        uint32_t firstCommand = 0;
+        uint32_t maxDrawCount = 0; //objects in the group
+        uint32_t drawCount = 0; //draw candidates written by the last updateDrawCandidates()
+    };
+
+    //one non-hidden object, before culling. layout must match DrawCandidate in cull.comp (std430)
+    struct DrawCandidate{
+        VkDrawIndexedIndirectCommand command; //first instance is the object's index in the object table
+        uint32_t groupIndex;
+        uint32_t groupFirstCommand; //first command of the group in the indirect buffer
+        uint32_t commandSlot; //slot of the command when the draws are not compacted
+    };
+
     PixelScene(PixBackend* backend);
     PixelScene() = default;
     //PixelScene(const PixelScene&) = delete;
@@ -35,7 +52,7 @@ public:
     };
 
     //setter functions
-    void addObject(PixelObject pixObject);
+    void addObject(PixelObject pixObject); //after init, the renderer packs and uploads the scene's geometry again
 
     //getter functions
     VkDescriptorSetLayout* getDescriptorSetLayout(DescSetLayoutIndex indx);
@@ -45,15 +62,33 @@ public:
     VkDescriptorSet* getTextureDescriptorSet();
     std::vector<VkDescriptorSet>* getUniformDescriptorSets();
     static VkDeviceSize getUniformBufferSize();
-    VkDeviceSize getDynamicUniformBufferSize() const;
-    VkDeviceSize getMinAlignment() const;
+    VkDeviceSize getObjectBufferSize() const;
     VkBuffer* getUniformBuffers(int index);
-    VkDeviceMemory* getUniformBufferMemories(int index);
-    VkBuffer* getDynamicUniformBuffers(int index);
-    VkDeviceMemory* getDynamicUniformBufferMemories(int index);
+    PixAllocation* getUniformBufferAllocations(int index);
+    VkBuffer* getObjectBuffers(int index);
+    PixAllocation* getObjectBufferAllocations(int index);
+    VkBuffer* getVertexBuffer(){return &vertexBuffer;}
+    PixAllocation* getVertexBufferAllocation(){return &vertexBufferAllocation;}
+    VkDeviceSize getVertexBufferSize() const {return vertexBufferSize;}
+    VkDeviceSize getVertexRegionOffset(PixelObject::VertexFormat vertexFormat) const {return vertexRegionOffsets[vertexFormat];}
+    VkBuffer* getIndexBuffer(){return &indexBuffer;}
+    PixAllocation* getIndexBufferAllocation(){return &indexBufferAllocation;}
+    VkDeviceSize getIndexBufferSize() const {return indexBufferSize;}
+    VkBuffer* getDrawCandidateBuffers(int index);
+    PixAllocation* getDrawCandidateBufferAllocations(int index);
+    VkDeviceSize getDrawCandidateBufferSize(int index) const;
+    uint32_t getDrawCandidateCount() const {return drawCandidateCount;}
+    VkBuffer* getIndirectBuffers(int index);
+    PixAllocation* getIndirectBufferAllocations(int index);
+    VkDeviceSize getIndirectBufferSize(int index) const;
+    VkBuffer* getDrawCountBuffers(int index);
+    PixAllocation* getDrawCountBufferAllocations(int index);
+    VkDeviceSize getDrawCountBufferSize(int index) const;
+    std::vector<DrawGroup>* getDrawGroups(){return &drawGroups;}
+    uint64_t getDrawStateVersion() const {return drawStateVersion;}
     int getNumObjects();
+    uint32_t getPackedObjectCount() const {return packedObjectCount;} //objects with a range in the geometry buffers
     PixelObject* getObjectAt(int index);
-    std::vector<PixelImage> getAllTextures();
     UboVP getSceneVP();
     glm::vec3 getCameraPos();
     glm::vec3 getLookAtVec();
@@ -67,13 +102,19 @@ public:
 
     //create functions
     void createDescriptorSetLayout();
+    void createDrawBuffers(uint32_t bufferIndex); //sized for the current objects, grown by updateDrawCandidates()
 
     //update functons
     void updateUniformBuffer(uint32_t bufferIndex);
-    void updateDynamicUniformBuffer(uint32_t bufferIndex);
+    void updateObjectBuffer(uint32_t bufferIndex);
+    void updateDrawCandidates(uint32_t bufferIndex);
+    void refreshDrawState();
 
     //helper functions
     void initialize();
+    void packGeometry();
+    void retireGeometryBuffers(); //before packing added objects, the frames in flight may still draw from them
+    void buildDrawGroups();
     void resizeBuffers(size_t newSize);
     void resizeDesciptorSets(size_t newSize);
     static bool areMatricesEqual(glm::mat4 x, glm::mat4 y);
@@ -87,39 +128,73 @@ private:
 
     //objects
     std::vector<PixelObject> allObjects{};
-    std::vector<PixelObject::Vertex> allVertices{};
-    std::vector<uint32_t> allIndices{};
 
     glm::vec3 m_lookAtVec{};
     glm::vec3 m_cameraPos{};
 
-    //helper functions
-    void getMinUBOOffset(VkPhysicalDevice physicalDevice);
-
     //allocator functions
-    void allocateDynamicBufferTransferSpace();
+    void growObjectBuffer(uint32_t bufferIndex);
+    void growDrawBuffers(uint32_t bufferIndex);
+    void writeObjectBufferDescriptor(uint32_t bufferIndex);
+    void destroyRetiredBuffers(bool destroyAll);
 
     //------UNIFORM BUFFER
     UboVP sceneVP; //model view projection matrix
     std::vector<VkBuffer> uniformBuffers;
-    std::vector<VkDeviceMemory> uniformBufferMemories;
-    std::vector<VkBuffer> dynamicUniformBuffers;
-    std::vector<VkDeviceMemory> dynamicUniformBufferMemories;
-    PixelObject::DynamicUBObj* modelTransferSpace{};
-
-    //------TEXTURES
+    std::vector<PixAllocation> uniformBufferAllocations;
+
+    //------GEOMETRY (every mesh of the scene packed in one vertex and one index buffer)
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    PixAllocation vertexBufferAllocation{};
+    VkDeviceSize vertexBufferSize = 0;
+    //the vertex buffer holds one region per vertex format, an object's vertex offset counts from the start of its region
+    std::array<VkDeviceSize, PixelObject::VERTEX_FORMAT_COUNT> vertexRegionOffsets{};
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    PixAllocation indexBufferAllocation{};
+    VkDeviceSize indexBufferSize = 0;
+    uint32_t packedObjectCount = 0;
+
+    //------INDIRECT DRAWS (per frame: the cpu writes the candidates, the culling pass writes the commands and the counts)
+    std::vector<VkBuffer> drawCandidateBuffers;
+    std::vector<PixAllocation> drawCandidateBufferAllocations;
+    std::vector<VkBuffer> indirectBuffers;
+    std::vector<PixAllocation> indirectBufferAllocations;
+    std::vector<VkBuffer> drawCountBuffers; //one count per group
+    std::vector<PixAllocation> drawCountBufferAllocations;
+    std::vector<uint32_t> drawBufferCapacities; //in draws, there is at most one draw and one group per object
+    uint32_t drawCandidateCount = 0;
+    std::vector<DrawGroup> drawGroups;
+    std::vector<uint32_t> drawOrder; //object indices sorted by draw group
+
+    //command buffers drawing the scene are only recorded again when this changes
+    uint64_t drawStateVersion = 1;
+    std::vector<uint32_t> seenObjectDrawVersions; //draw state version of each object when the groups were built
+
+    //------OBJECT TABLE (one storage buffer per frame, grows with the number of objects)
+    std::vector<VkBuffer> objectBuffers;
+    std::vector<PixAllocation> objectBufferAllocations;
+    std::vector<uint32_t> objectBufferCapacities; //in objects
+
+    //replaced object tables, draw buffers and geometry buffers stay alive until the frames that may still read them are done
+    struct RetiredBuffer
+    {
+        VkBuffer buffer;
+        PixAllocation allocation;
+        uint64_t releaseFrame;
+    };
+    std::vector<RetiredBuffer> retiredBuffers;
+    uint64_t objectBufferFrame = 0;
 
-    //utility (Dynamic Buffers)
-    VkDeviceSize minUBOOffset{}; //this is device specific and is a constant
-    size_t objectUBOAllignment{}; //this is a multiple of minUBOOffset and will depend on the size of the object's UBO
-    std::vector<bool> buffersUpdated;
+    //what is currently written in each per-frame buffer. buffers are persistently mapped and only rewritten when stale
+    uint32_t sceneVPVersion = 1;
+    std::vector<uint32_t> writtenSceneVPVersions;
+    std::vector<std::vector<uint32_t>> writtenObjectVersions; //[bufferIndex][objectIndex]
 
     //vulkan component
     PixBackend* m_backend{};
     VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
     std::vector<VkDescriptorSet> m_uniformDescriptorSets{};
     std::vector<VkDescriptorSetLayout> m_descriptorSetLayouts{};
-    VkDescriptorSet m_textureDescriptorSet = VK_NULL_HANDLE;
 };
 
 
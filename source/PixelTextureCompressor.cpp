@@ -0,0 +1,948 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#include "PixelTextureCompressor.h"
+#include "PixelImageDecoder.h"
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PIXELENGINE_DOWNSAMPLE_SSE2
+#endif
+
+//DDS layout (little endian), the header follows the "DDS " magic
+struct DDSPixelFormat{
+    uint32_t size;
+    uint32_t flags;
+    uint32_t fourCC;
+    uint32_t rgbBitCount;
+    uint32_t bitMasks[4];
+};
+
+struct DDSHeader{
+    uint32_t size;
+    uint32_t flags;
+    uint32_t height;
+    uint32_t width;
+    uint32_t pitchOrLinearSize;
+    uint32_t depth;
+    uint32_t mipMapCount;
+    uint32_t reserved1[11];
+    DDSPixelFormat pixelFormat;
+    uint32_t caps[4];
+    uint32_t reserved2;
+};
+
+struct DDSHeaderDX10{
+    uint32_t dxgiFormat;
+    uint32_t resourceDimension;
+    uint32_t miscFlag;
+    uint32_t arraySize;
+    uint32_t miscFlags2;
+};
+
+//KTX2 layout, the header follows the 12 byte identifier
+struct KTX2Header{
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+
+struct KTX2LevelIndex{
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+static const uint32_t DDS_MAGIC = 0x20534444; //"DDS "
+static const uint32_t DDS_FOURCC_FLAG = 0x4;
+static const uint32_t DDS_HEADER_FLAGS = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; //caps, height, width, pixel format, mip count, linear size
+static const uint32_t DDS_CAPS_TEXTURE = 0x1000;
+static const uint32_t DDS_CAPS_MIPMAP = 0x400000 | 0x8; //mipmap, complex
+static const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+static const unsigned char KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+static constexpr uint32_t makeFourCC(char a, char b, char c, char d)
+{
+    return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+}
+
+//DXGI_FORMAT values of the formats we read and write
+static const uint32_t DXGI_FORMAT_R8G8B8A8_UNORM = 28;
+static const uint32_t DXGI_FORMAT_BC1_UNORM = 71;
+static const uint32_t DXGI_FORMAT_BC1_UNORM_SRGB = 72;
+static const uint32_t DXGI_FORMAT_BC3_UNORM = 77;
+static const uint32_t DXGI_FORMAT_BC3_UNORM_SRGB = 78;
+static const uint32_t DXGI_FORMAT_BC5_UNORM = 83;
+static const uint32_t DXGI_FORMAT_BC7_UNORM = 98;
+static const uint32_t DXGI_FORMAT_BC7_UNORM_SRGB = 99;
+
+static VkFormat formatFromDXGI(uint32_t dxgiFormat)
+{
+    switch(dxgiFormat)
+    {
+        case DXGI_FORMAT_R8G8B8A8_UNORM: return VK_FORMAT_R8G8B8A8_UNORM;
+        case DXGI_FORMAT_BC1_UNORM: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case DXGI_FORMAT_BC1_UNORM_SRGB: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+        case DXGI_FORMAT_BC3_UNORM: return VK_FORMAT_BC3_UNORM_BLOCK;
+        case DXGI_FORMAT_BC3_UNORM_SRGB: return VK_FORMAT_BC3_SRGB_BLOCK;
+        case DXGI_FORMAT_BC5_UNORM: return VK_FORMAT_BC5_UNORM_BLOCK;
+        case DXGI_FORMAT_BC7_UNORM: return VK_FORMAT_BC7_UNORM_BLOCK;
+        case DXGI_FORMAT_BC7_UNORM_SRGB: return VK_FORMAT_BC7_SRGB_BLOCK;
+        default: return VK_FORMAT_UNDEFINED;
+    }
+}
+
+static uint32_t formatToDXGI(VkFormat format)
+{
+    for(uint32_t dxgiFormat : {DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC1_UNORM_SRGB, DXGI_FORMAT_BC3_UNORM,
+                               DXGI_FORMAT_BC3_UNORM_SRGB, DXGI_FORMAT_BC5_UNORM, DXGI_FORMAT_BC7_UNORM, DXGI_FORMAT_BC7_UNORM_SRGB})
+    {
+        if(formatFromDXGI(dxgiFormat) == format)
+        {
+            return dxgiFormat;
+        }
+    }
+    return 0;
+}
+
+static bool readFile(const std::string& path, std::vector<unsigned char>& bytes)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if(!file)
+    {
+        return false;
+    }
+    auto size = static_cast<size_t>(file.tellg());
+    bytes.resize(size);
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(size));
+    return static_cast<bool>(file);
+}
+
+//allocate the texture's data for every level of the chain
+static bool allocateLevels(PixelTextureCompressor::TextureData& texture)
+{
+    texture.size = 0;
+    for(uint32_t level = 0; level < texture.mipLevels; level++)
+    {
+        texture.size += PixelTextureCompressor::getLevelSize(texture.format, std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u));
+    }
+    texture.data = static_cast<stbi_uc*>(malloc(static_cast<size_t>(texture.size)));
+    return texture.data != nullptr;
+}
+
+uint32_t PixelTextureCompressor::getBlockSize(VkFormat format) {
+
+    switch(format)
+    {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            return 8;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+VkDeviceSize PixelTextureCompressor::getLevelSize(VkFormat format, uint32_t width, uint32_t height) {
+
+    uint32_t blockSize = getBlockSize(format);
+    if(blockSize == 0)
+    {
+        return static_cast<VkDeviceSize>(width) * height * 4;
+    }
+    return static_cast<VkDeviceSize>((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+}
+
+bool PixelTextureCompressor::isContainerFile(const std::string& path) {
+
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+    return extension == ".dds" || extension == ".ktx2";
+}
+
+bool PixelTextureCompressor::loadContainer(const std::string& path, TextureData& texture) {
+
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+    return extension == ".ktx2" ? loadKTX2(path, texture) : loadDDS(path, texture);
+}
+
+bool PixelTextureCompressor::loadDDS(const std::string& path, TextureData& texture) {
+
+    std::vector<unsigned char> bytes;
+    if(!readFile(path, bytes) || bytes.size() < sizeof(uint32_t) + sizeof(DDSHeader))
+    {
+        return false;
+    }
+
+    uint32_t magic = 0;
+    DDSHeader header{};
+    memcpy(&magic, bytes.data(), sizeof(uint32_t));
+    memcpy(&header, bytes.data() + sizeof(uint32_t), sizeof(DDSHeader));
+    if(magic != DDS_MAGIC || header.size != sizeof(DDSHeader))
+    {
+        return false;
+    }
+
+    size_t dataOffset = sizeof(uint32_t) + sizeof(DDSHeader);
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    if((header.pixelFormat.flags & DDS_FOURCC_FLAG) != 0)
+    {
+        switch(header.pixelFormat.fourCC)
+        {
+            case makeFourCC('D', 'X', 'T', '1'): format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK; break;
+            case makeFourCC('D', 'X', 'T', '5'): format = VK_FORMAT_BC3_UNORM_BLOCK; break;
+            case makeFourCC('A', 'T', 'I', '2'):
+            case makeFourCC('B', 'C', '5', 'U'): format = VK_FORMAT_BC5_UNORM_BLOCK; break;
+            case makeFourCC('D', 'X', '1', '0'):
+            {
+                if(bytes.size() < dataOffset + sizeof(DDSHeaderDX10))
+                {
+                    return false;
+                }
+                DDSHeaderDX10 headerDX10{};
+                memcpy(&headerDX10, bytes.data() + dataOffset, sizeof(DDSHeaderDX10));
+                dataOffset += sizeof(DDSHeaderDX10);
+                if(headerDX10.resourceDimension != DDS_DIMENSION_TEXTURE2D || headerDX10.arraySize > 1)
+                {
+                    return false; //no arrays, cube maps or volumes
+                }
+                format = formatFromDXGI(headerDX10.dxgiFormat);
+                break;
+            }
+            default: break;
+        }
+    }
+    if(format == VK_FORMAT_UNDEFINED)
+    {
+        return false;
+    }
+
+    texture.format = format;
+    texture.width = header.width;
+    texture.height = header.height;
+    texture.mipLevels = std::max(header.mipMapCount, 1u);
+    if(texture.width == 0 || texture.height == 0 || !allocateLevels(texture))
+    {
+        return false;
+    }
+    if(bytes.size() < dataOffset + texture.size)
+    {
+        stbi_image_free(texture.data);
+        texture.data = nullptr;
+        return false;
+    }
+
+    memcpy(texture.data, bytes.data() + dataOffset, static_cast<size_t>(texture.size));
+    return true;
+}
+
+bool PixelTextureCompressor::loadKTX2(const std::string& path, TextureData& texture) {
+
+    std::vector<unsigned char> bytes;
+    if(!readFile(path, bytes) || bytes.size() < sizeof(KTX2_IDENTIFIER) + sizeof(KTX2Header) ||
+       memcmp(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+    {
+        return false;
+    }
+
+    KTX2Header header{};
+    memcpy(&header, bytes.data() + sizeof(KTX2_IDENTIFIER), sizeof(KTX2Header));
+
+    //plain 2D textures only, basis/zstd supercompressed files have to be transcoded first
+    auto format = static_cast<VkFormat>(header.vkFormat);
+    if(header.supercompressionScheme != 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 ||
+       header.pixelWidth == 0 || header.pixelHeight == 0 || (getBlockSize(format) == 0 && format != VK_FORMAT_R8G8B8A8_UNORM))
+    {
+        return false;
+    }
+
+    texture.format = format;
+    texture.width = header.pixelWidth;
+    texture.height = header.pixelHeight;
+    texture.mipLevels = std::max(header.levelCount, 1u); //0 asks for generated levels, we only take the first
+    size_t levelIndexOffset = sizeof(KTX2_IDENTIFIER) + sizeof(KTX2Header);
+    if(bytes.size() < levelIndexOffset + sizeof(KTX2LevelIndex) * texture.mipLevels || !allocateLevels(texture))
+    {
+        return false;
+    }
+
+    //the file stores the smallest level first, the index points at each of them
+    VkDeviceSize dataOffset = 0;
+    for(uint32_t level = 0; level < texture.mipLevels; level++)
+    {
+        KTX2LevelIndex levelIndex{};
+        memcpy(&levelIndex, bytes.data() + levelIndexOffset + sizeof(KTX2LevelIndex) * level, sizeof(KTX2LevelIndex));
+        VkDeviceSize levelSize = getLevelSize(format, std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u));
+        if(levelIndex.byteLength != levelSize || levelIndex.byteOffset + levelIndex.byteLength > bytes.size())
+        {
+            stbi_image_free(texture.data);
+            texture.data = nullptr;
+            return false;
+        }
+        memcpy(texture.data + dataOffset, bytes.data() + levelIndex.byteOffset, static_cast<size_t>(levelSize));
+        dataOffset += levelSize;
+    }
+
+    return true;
+}
+
+bool PixelTextureCompressor::saveDDS(const std::string& path, const TextureData& texture) {
+
+    DDSHeader header{};
+    header.size = sizeof(DDSHeader);
+    header.flags = DDS_HEADER_FLAGS;
+    header.height = texture.height;
+    header.width = texture.width;
+    header.pitchOrLinearSize = static_cast<uint32_t>(getLevelSize(texture.format, texture.width, texture.height));
+    header.depth = 1;
+    header.mipMapCount = texture.mipLevels;
+    header.pixelFormat.size = sizeof(DDSPixelFormat);
+    header.pixelFormat.flags = DDS_FOURCC_FLAG;
+    header.pixelFormat.fourCC = makeFourCC('D', 'X', '1', '0');
+    header.caps[0] = DDS_CAPS_TEXTURE | (texture.mipLevels > 1 ? DDS_CAPS_MIPMAP : 0);
+
+    DDSHeaderDX10 headerDX10{};
+    headerDX10.dxgiFormat = formatToDXGI(texture.format);
+    headerDX10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+    headerDX10.arraySize = 1;
+    if(headerDX10.dxgiFormat == 0)
+    {
+        return false;
+    }
+
+    //written aside and renamed, a crash never leaves a half written cache behind
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if(!file)
+        {
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&DDS_MAGIC), sizeof(uint32_t));
+        file.write(reinterpret_cast<const char*>(&header), sizeof(DDSHeader));
+        file.write(reinterpret_cast<const char*>(&headerDX10), sizeof(DDSHeaderDX10));
+        file.write(reinterpret_cast<const char*>(texture.data), static_cast<std::streamsize>(texture.size));
+        if(!file)
+        {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    return !error;
+}
+
+std::string PixelTextureCompressor::getCachePath(const std::string& sourcePath) {
+    return sourcePath + ".bc.dds";
+}
+
+bool PixelTextureCompressor::isCacheValid(const std::string& sourcePath) {
+
+    std::error_code error;
+    std::string cachePath = getCachePath(sourcePath);
+    if(!std::filesystem::exists(cachePath, error))
+    {
+        return false;
+    }
+    if(!std::filesystem::exists(sourcePath, error))
+    {
+        return true; //shipped without its source
+    }
+    return std::filesystem::last_write_time(cachePath, error) >= std::filesystem::last_write_time(sourcePath, error);
+}
+
+VkFormat PixelTextureCompressor::chooseFormat(const std::string& filename, const stbi_uc* pixels, uint32_t width, uint32_t height) {
+
+    std::string name = filename;
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+    if(name.find("normal") != std::string::npos)
+    {
+        return VK_FORMAT_BC7_UNORM_BLOCK; //all three components, the shaders sample normal maps like any other texture
+    }
+
+    size_t texelCount = static_cast<size_t>(width) * height;
+    for(size_t i = 0; i < texelCount; i++)
+    {
+        if(pixels[i * 4 + 3] != 255)
+        {
+            return VK_FORMAT_BC7_UNORM_BLOCK;
+        }
+    }
+    return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+}
+
+void PixelTextureCompressor::downsampleRGBA8(const stbi_uc* source, uint32_t width, uint32_t height, stbi_uc* destination) {
+
+    uint32_t mipWidth = std::max(width >> 1, 1u);
+    uint32_t mipHeight = std::max(height >> 1, 1u);
+
+    for(uint32_t y = 0; y < mipHeight; y++)
+    {
+        const stbi_uc* row0 = source + static_cast<size_t>(std::min(y * 2, height - 1)) * width * 4;
+        const stbi_uc* row1 = source + static_cast<size_t>(std::min(y * 2 + 1, height - 1)) * width * 4;
+        stbi_uc* mipRow = destination + static_cast<size_t>(y) * mipWidth * 4;
+
+        uint32_t x = 0;
+#ifdef PIXELENGINE_DOWNSAMPLE_SSE2
+        //two output texels from four source texels of each row, summed in 16 bit lanes
+        if(width >= 4)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i rounding = _mm_set1_epi16(2);
+            for(; x + 2 <= mipWidth && x * 2 + 4 <= width; x += 2)
+            {
+                __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+                __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+
+                __m128i columnsLow = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero)); //texels 0 and 1
+                __m128i columnsHigh = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero)); //texels 2 and 3
+                __m128i sumLow = _mm_add_epi16(columnsLow, _mm_srli_si128(columnsLow, 8));
+                __m128i sumHigh = _mm_add_epi16(columnsHigh, _mm_srli_si128(columnsHigh, 8));
+
+                __m128i average = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sumLow, sumHigh), rounding), 2);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(mipRow + x * 4), _mm_packus_epi16(average, zero));
+            }
+        }
+#endif
+        for(; x < mipWidth; x++)
+        {
+            uint32_t x0 = std::min(x * 2, width - 1) * 4;
+            uint32_t x1 = std::min(x * 2 + 1, width - 1) * 4;
+            for(uint32_t channel = 0; channel < 4; channel++)
+            {
+                uint32_t sum = row0[x0 + channel] + row0[x1 + channel] + row1[x0 + channel] + row1[x1 + channel];
+                mipRow[x * 4 + channel] = static_cast<stbi_uc>((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+bool PixelTextureCompressor::buildMipChain(TextureData& texture) {
+
+    texture.mipLevels = 1;
+    for(uint32_t size = std::max(texture.width, texture.height); size > 1; size >>= 1)
+    {
+        texture.mipLevels++;
+    }
+
+    stbi_uc* firstLevel = texture.data;
+    if(!allocateLevels(texture))
+    {
+        texture.data = firstLevel;
+        return false;
+    }
+    memcpy(texture.data, firstLevel, static_cast<size_t>(getLevelSize(texture.format, texture.width, texture.height)));
+    stbi_image_free(firstLevel);
+
+    stbi_uc* source = texture.data;
+    for(uint32_t level = 1; level < texture.mipLevels; level++)
+    {
+        uint32_t width = std::max(texture.width >> (level - 1), 1u);
+        uint32_t height = std::max(texture.height >> (level - 1), 1u);
+        stbi_uc* destination = source + getLevelSize(texture.format, width, height);
+        downsampleRGBA8(source, width, height, destination);
+        source = destination;
+    }
+    return true;
+}
+
+bool PixelTextureCompressor::compress(const TextureData& source, VkFormat format, TextureData& texture) {
+
+    texture.format = format;
+    texture.width = source.width;
+    texture.height = source.height;
+    texture.mipLevels = source.mipLevels;
+    if(!allocateLevels(texture))
+    {
+        return false;
+    }
+
+    const stbi_uc* sourceLevel = source.data;
+    stbi_uc* destinationLevel = texture.data;
+    for(uint32_t level = 0; level < texture.mipLevels; level++)
+    {
+        uint32_t width = std::max(texture.width >> level, 1u);
+        uint32_t height = std::max(texture.height >> level, 1u);
+        encode(sourceLevel, width, height, format, destinationLevel);
+        sourceLevel += getLevelSize(source.format, width, height);
+        destinationLevel += getLevelSize(format, width, height);
+    }
+    return true;
+}
+
+bool PixelTextureCompressor::compressFile(const std::string& sourcePath, TextureData& texture) {
+
+    uint32_t width, height;
+    stbi_uc* pixels = PixelImageDecoder::loadRGBA(sourcePath, width, height);
+    if(pixels == nullptr)
+    {
+        return false;
+    }
+
+    TextureData source{};
+    source.format = VK_FORMAT_R8G8B8A8_UNORM;
+    source.width = width;
+    source.height = height;
+    source.data = pixels;
+    source.size = getLevelSize(source.format, source.width, source.height);
+
+    VkFormat format = chooseFormat(sourcePath, pixels, source.width, source.height);
+    bool compressed = buildMipChain(source) && compress(source, format, texture);
+    stbi_image_free(source.data);
+    if(!compressed)
+    {
+        return false;
+    }
+
+    if(!saveDDS(getCachePath(sourcePath), texture))
+    {
+        printf("Could not write the compressed copy of %s\n", sourcePath.c_str());
+        fflush(stdout);
+    }
+    return true;
+}
+
+bool PixelTextureCompressor::loadCompressedFile(const std::string& sourcePath, TextureData& texture) {
+
+    if(isCacheValid(sourcePath) && loadContainer(getCachePath(sourcePath), texture))
+    {
+        if(texture.format != VK_FORMAT_BC5_UNORM_BLOCK)
+        {
+            return true;
+        }
+        //normal maps used to be cached as BC5, which drops z
+        stbi_image_free(texture.data);
+        texture = TextureData{};
+    }
+    return compressFile(sourcePath, texture);
+}
+
+bool PixelTextureCompressor::loadMipChain(const std::string& path, bool compress, TextureData& texture) {
+
+    if(isContainerFile(path))
+    {
+        return loadContainer(path, texture);
+    }
+
+    if(compress)
+    {
+        return loadCompressedFile(path, texture);
+    }
+
+    uint32_t width, height;
+    stbi_uc* pixels = PixelImageDecoder::loadRGBA(path, width, height);
+    if(pixels == nullptr)
+    {
+        return false;
+    }
+
+    texture.format = VK_FORMAT_R8G8B8A8_UNORM;
+    texture.width = width;
+    texture.height = height;
+    texture.data = pixels;
+    texture.size = getLevelSize(texture.format, texture.width, texture.height);
+    if(!buildMipChain(texture))
+    {
+        stbi_image_free(texture.data);
+        texture.data = nullptr;
+        return false;
+    }
+    return true;
+}
+
+//encoders. a block is 4x4 texels, texels past the edge of the image repeat the last row or column
+
+static void fetchBlock(const stbi_uc* pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, float block[16][4])
+{
+    for(uint32_t y = 0; y < 4; y++)
+    {
+        uint32_t row = std::min(blockY * 4 + y, height - 1);
+        for(uint32_t x = 0; x < 4; x++)
+        {
+            const stbi_uc* texel = pixels + (static_cast<size_t>(row) * width + std::min(blockX * 4 + x, width - 1)) * 4;
+            for(uint32_t channel = 0; channel < 4; channel++)
+            {
+                block[y * 4 + x][channel] = static_cast<float>(texel[channel]);
+            }
+        }
+    }
+}
+
+//ends of the block's principal axis over the first channelCount channels
+static void principalEndpoints(const float block[16][4], int channelCount, float endpoint0[4], float endpoint1[4])
+{
+    float mean[4] = {};
+    float minimum[4] = {255.0f, 255.0f, 255.0f, 255.0f};
+    float maximum[4] = {};
+    for(int i = 0; i < 16; i++)
+    {
+        for(int c = 0; c < channelCount; c++)
+        {
+            mean[c] += block[i][c] / 16.0f;
+            minimum[c] = std::min(minimum[c], block[i][c]);
+            maximum[c] = std::max(maximum[c], block[i][c]);
+        }
+    }
+
+    float covariance[4][4] = {};
+    for(int i = 0; i < 16; i++)
+    {
+        for(int a = 0; a < channelCount; a++)
+        {
+            for(int b = 0; b < channelCount; b++)
+            {
+                covariance[a][b] += (block[i][a] - mean[a]) * (block[i][b] - mean[b]);
+            }
+        }
+    }
+
+    //power iteration from the bounding box diagonal
+    float axis[4] = {};
+    for(int c = 0; c < channelCount; c++)
+    {
+        axis[c] = maximum[c] - minimum[c];
+    }
+    for(int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+        for(int a = 0; a < channelCount; a++)
+        {
+            for(int b = 0; b < channelCount; b++)
+            {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length = std::max(length, std::fabs(next[a]));
+        }
+        if(length == 0.0f)
+        {
+            break;
+        }
+        for(int c = 0; c < channelCount; c++)
+        {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    float axisLengthSquared = 0.0f;
+    for(int c = 0; c < channelCount; c++)
+    {
+        axisLengthSquared += axis[c] * axis[c];
+    }
+    if(axisLengthSquared == 0.0f)
+    {
+        for(int c = 0; c < 4; c++)
+        {
+            endpoint0[c] = c < channelCount ? mean[c] : 0.0f; //flat block
+            endpoint1[c] = endpoint0[c];
+        }
+        return;
+    }
+
+    float lowest = 0.0f;
+    float highest = 0.0f;
+    for(int i = 0; i < 16; i++)
+    {
+        float t = 0.0f;
+        for(int c = 0; c < channelCount; c++)
+        {
+            t += (block[i][c] - mean[c]) * axis[c];
+        }
+        t /= axisLengthSquared;
+        lowest = std::min(lowest, t);
+        highest = std::max(highest, t);
+    }
+
+    for(int c = 0; c < 4; c++)
+    {
+        endpoint0[c] = c < channelCount ? std::clamp(mean[c] + lowest * axis[c], 0.0f, 255.0f) : 0.0f;
+        endpoint1[c] = c < channelCount ? std::clamp(mean[c] + highest * axis[c], 0.0f, 255.0f) : 0.0f;
+    }
+}
+
+static uint16_t packRGB565(const float color[4])
+{
+    auto r = static_cast<uint16_t>(std::lround(color[0] * 31.0f / 255.0f));
+    auto g = static_cast<uint16_t>(std::lround(color[1] * 63.0f / 255.0f));
+    auto b = static_cast<uint16_t>(std::lround(color[2] * 31.0f / 255.0f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(uint16_t packed, int color[3])
+{
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+static void encodeBC1Block(const float block[16][4], stbi_uc* destination)
+{
+    float endpoint0[4];
+    float endpoint1[4];
+    principalEndpoints(block, 3, endpoint0, endpoint1);
+
+    //four colour mode needs the first endpoint to be the larger one
+    uint16_t color0 = packRGB565(endpoint1);
+    uint16_t color1 = packRGB565(endpoint0);
+    if(color0 < color1)
+    {
+        std::swap(color0, color1);
+    }
+
+    uint32_t indices = 0;
+    if(color0 != color1)
+    {
+        int palette[4][3];
+        unpackRGB565(color0, palette[0]);
+        unpackRGB565(color1, palette[1]);
+        for(int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for(int i = 0; i < 16; i++)
+        {
+            uint32_t bestIndex = 0;
+            float bestError = 1e30f;
+            for(uint32_t p = 0; p < 4; p++)
+            {
+                float error = 0.0f;
+                for(int c = 0; c < 3; c++)
+                {
+                    float difference = block[i][c] - static_cast<float>(palette[p][c]);
+                    error += difference * difference;
+                }
+                if(error < bestError)
+                {
+                    bestError = error;
+                    bestIndex = p;
+                }
+            }
+            indices |= bestIndex << (i * 2);
+        }
+    }
+
+    memcpy(destination, &color0, sizeof(uint16_t));
+    memcpy(destination + 2, &color1, sizeof(uint16_t));
+    memcpy(destination + 4, &indices, sizeof(uint32_t));
+}
+
+//single channel block (BC4), the alpha of BC3 and each channel of BC5
+static void encodeBC4Block(const float block[16][4], int channel, stbi_uc* destination)
+{
+    float minimum = 255.0f;
+    float maximum = 0.0f;
+    for(int i = 0; i < 16; i++)
+    {
+        minimum = std::min(minimum, block[i][channel]);
+        maximum = std::max(maximum, block[i][channel]);
+    }
+
+    //eight value mode: the first endpoint is the larger one
+    auto value0 = static_cast<int>(std::lround(maximum));
+    auto value1 = static_cast<int>(std::lround(minimum));
+    int palette[8] = {value0, value1};
+    for(int p = 2; p < 8; p++)
+    {
+        palette[p] = ((8 - p) * value0 + (p - 1) * value1) / 7;
+    }
+
+    uint64_t indices = 0;
+    if(value0 != value1)
+    {
+        for(int i = 0; i < 16; i++)
+        {
+            uint64_t bestIndex = 0;
+            float bestError = 1e30f;
+            for(uint64_t p = 0; p < 8; p++)
+            {
+                float error = std::fabs(block[i][channel] - static_cast<float>(palette[p]));
+                if(error < bestError)
+                {
+                    bestError = error;
+                    bestIndex = p;
+                }
+            }
+            indices |= bestIndex << (i * 3);
+        }
+    }
+
+    destination[0] = static_cast<stbi_uc>(value0);
+    destination[1] = static_cast<stbi_uc>(value1);
+    for(int b = 0; b < 6; b++)
+    {
+        destination[2 + b] = static_cast<stbi_uc>(indices >> (b * 8));
+    }
+}
+
+//writes count bits of value at bitPosition, least significant bit first
+static void writeBits(stbi_uc* destination, uint32_t& bitPosition, uint32_t value, uint32_t count)
+{
+    for(uint32_t i = 0; i < count; i++, bitPosition++)
+    {
+        if((value >> i) & 1u)
+        {
+            destination[bitPosition / 8] |= static_cast<stbi_uc>(1u << (bitPosition % 8));
+        }
+    }
+}
+
+//BC7 mode 6 only: one subset, rgba endpoints of 7 bits plus a shared p bit each, 4 bit indices
+static void encodeBC7Block(const float block[16][4], stbi_uc* destination)
+{
+    static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    float endpoints[2][4];
+    principalEndpoints(block, 4, endpoints[0], endpoints[1]);
+
+    //quantize each endpoint with the p bit that fits it best
+    uint32_t quantized[2][4];
+    uint32_t pBits[2];
+    int expanded[2][4];
+    for(int e = 0; e < 2; e++)
+    {
+        float bestError = 1e30f;
+        for(uint32_t p = 0; p < 2; p++)
+        {
+            float error = 0.0f;
+            uint32_t candidate[4];
+            for(int c = 0; c < 4; c++)
+            {
+                candidate[c] = static_cast<uint32_t>(std::clamp(std::lround((endpoints[e][c] - static_cast<float>(p)) / 2.0f), 0L, 127L));
+                float difference = static_cast<float>((candidate[c] << 1) | p) - endpoints[e][c];
+                error += difference * difference;
+            }
+            if(error < bestError)
+            {
+                bestError = error;
+                pBits[e] = p;
+                for(int c = 0; c < 4; c++)
+                {
+                    quantized[e][c] = candidate[c];
+                    expanded[e][c] = static_cast<int>((candidate[c] << 1) | p);
+                }
+            }
+        }
+    }
+
+    uint32_t indices[16];
+    for(int i = 0; i < 16; i++)
+    {
+        float bestError = 1e30f;
+        for(uint32_t w = 0; w < 16; w++)
+        {
+            float error = 0.0f;
+            for(int c = 0; c < 4; c++)
+            {
+                int value = ((64 - weights[w]) * expanded[0][c] + weights[w] * expanded[1][c] + 32) >> 6;
+                float difference = block[i][c] - static_cast<float>(value);
+                error += difference * difference;
+            }
+            if(error < bestError)
+            {
+                bestError = error;
+                indices[i] = w;
+            }
+        }
+    }
+
+    //the first texel's index is stored without its top bit, it has to be below 8
+    if(indices[0] >= 8)
+    {
+        std::swap(quantized[0], quantized[1]);
+        std::swap(pBits[0], pBits[1]);
+        for(auto& index : indices)
+        {
+            index = 15 - index;
+        }
+    }
+
+    memset(destination, 0, 16);
+    uint32_t bitPosition = 0;
+    writeBits(destination, bitPosition, 1u << 6, 7); //mode 6
+    for(int c = 0; c < 4; c++)
+    {
+        writeBits(destination, bitPosition, quantized[0][c], 7);
+        writeBits(destination, bitPosition, quantized[1][c], 7);
+    }
+    writeBits(destination, bitPosition, pBits[0], 1);
+    writeBits(destination, bitPosition, pBits[1], 1);
+    for(int i = 0; i < 16; i++)
+    {
+        writeBits(destination, bitPosition, indices[i], i == 0 ? 3 : 4);
+    }
+}
+
+void PixelTextureCompressor::encode(const stbi_uc* pixels, uint32_t width, uint32_t height, VkFormat format, stbi_uc* destination) {
+
+    uint32_t blockSize = getBlockSize(format);
+    uint32_t blocksWide = (width + 3) / 4;
+    uint32_t blocksHigh = (height + 3) / 4;
+
+    float block[16][4];
+    for(uint32_t blockY = 0; blockY < blocksHigh; blockY++)
+    {
+        for(uint32_t blockX = 0; blockX < blocksWide; blockX++)
+        {
+            fetchBlock(pixels, width, height, blockX, blockY, block);
+            stbi_uc* output = destination + (static_cast<size_t>(blockY) * blocksWide + blockX) * blockSize;
+
+            switch(format)
+            {
+                case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+                    encodeBC1Block(block, output);
+                    break;
+                case VK_FORMAT_BC3_UNORM_BLOCK:
+                    encodeBC4Block(block, 3, output);
+                    encodeBC1Block(block, output + 8);
+                    break;
+                case VK_FORMAT_BC5_UNORM_BLOCK:
+                    encodeBC4Block(block, 0, output);
+                    encodeBC4Block(block, 1, output + 8);
+                    break;
+                case VK_FORMAT_BC7_UNORM_BLOCK:
+                    encodeBC7Block(block, output);
+                    break;
+                default:
+                    throw std::runtime_error("no encoder for the requested texture format");
+            }
+        }
+    }
+}
@@ -0,0 +1,70 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#ifndef PIXELENGINE_PIXELTEXTURECOMPRESSOR_H
+#define PIXELENGINE_PIXELTEXTURECOMPRESSOR_H
+
+#define GLFW_INCLUDE_VULKAN //includes vulkan automatically
+#include <GLFW/glfw3.h>
+
+#include "stb_image.h"
+
+#include <string>
+#include <cstdint>
+
+//block compressed textures: loads DDS and KTX2 containers and encodes rgba8 images to BC1, BC3, BC5 or BC7.
+//the encoded copy of a png/jpg texture is cached next to it as a DDS file, used as long as it is newer than its source
+class PixelTextureCompressor {
+public:
+
+    //every mip level back to back, level 0 first
+    struct TextureData{
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t mipLevels = 0;
+        stbi_uc* data = nullptr; //malloc'd like stb_image's pixels, released with stbi_image_free
+        VkDeviceSize size = 0;
+    };
+
+    //bytes of one 4x4 block, 0 when the format is not block compressed
+    static uint32_t getBlockSize(VkFormat format);
+    //bytes of a width x height level, block compressed or rgba8
+    static VkDeviceSize getLevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+    //containers
+    static bool isContainerFile(const std::string& path); //.dds or .ktx2
+    static bool loadContainer(const std::string& path, TextureData& texture); //false if the file is not a supported 2D texture
+    static bool saveDDS(const std::string& path, const TextureData& texture);
+
+    //encoded copy of a source texture
+    static std::string getCachePath(const std::string& sourcePath);
+    static bool isCacheValid(const std::string& sourcePath);
+
+    //BC7 for normal maps (by name) and when the image has transparency, BC1 otherwise
+    static VkFormat chooseFormat(const std::string& filename, const stbi_uc* pixels, uint32_t width, uint32_t height);
+    //encode one rgba8 level into getLevelSize(format, width, height) bytes
+    static void encode(const stbi_uc* pixels, uint32_t width, uint32_t height, VkFormat format, stbi_uc* destination);
+    //encode every level of an rgba8 texture
+    static bool compress(const TextureData& source, VkFormat format, TextureData& texture);
+    //decode, build the mips, encode and write the cache of a png/jpg texture. false if the file cannot be decoded
+    static bool compressFile(const std::string& sourcePath, TextureData& texture);
+    //the cache when it is valid and still in a format chooseFormat() picks, else compressFile()
+    static bool loadCompressedFile(const std::string& sourcePath, TextureData& texture);
+
+    //2x2 box filter of an rgba8 level into the next one (half the size, rounded down, at least 1).
+    //the last row or column of an odd sized level is averaged with itself
+    static void downsampleRGBA8(const stbi_uc* source, uint32_t width, uint32_t height, stbi_uc* destination);
+    //replace the first level of an rgba8 texture with its full mip chain
+    static bool buildMipChain(TextureData& texture);
+    //every level of a texture file: as stored for containers, else encoded (or from the cache) when compress is set, rgba8 otherwise
+    static bool loadMipChain(const std::string& path, bool compress, TextureData& texture);
+
+private:
+    static bool loadDDS(const std::string& path, TextureData& texture);
+    static bool loadKTX2(const std::string& path, TextureData& texture);
+};
+
+
+#endif //PIXELENGINE_PIXELTEXTURECOMPRESSOR_H
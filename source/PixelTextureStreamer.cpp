@@ -0,0 +1,277 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#include "PixelTextureStreamer.h"
+
+#include <algorithm>
+
+void PixelTextureStreamer::init(PixBackend* backend, PixelUploadBatcher* uploadBatcher, PixelTextureTable* textureTable,
+                                uint32_t framesInFlight, VkDeviceSize budget) {
+
+    printf("Creating Texture Streamer (%.1f MB budget)\n", (float)budget / (1024.0f * 1024.0f));
+    fflush(stdout);
+
+    m_backend = backend;
+    m_uploadBatcher = uploadBatcher;
+    m_textureTable = textureTable;
+    m_framesInFlight = framesInFlight;
+    m_budget = budget;
+}
+
+void PixelTextureStreamer::cleanUp() {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for(auto& retired : m_retiredImages)
+    {
+        retired.image.cleanUp();
+    }
+    m_retiredImages.clear();
+
+    for(auto& texture : m_textures)
+    {
+        texture->image.cleanUp();
+        stbi_image_free(texture->chain.data);
+    }
+    m_textures.clear();
+    m_residentBytes = 0;
+}
+
+uint32_t PixelTextureStreamer::addTexture(const std::string& filename) {
+
+    //the whole chain is read (or encoded) here, without the lock
+    auto texture = std::make_unique<StreamedTexture>();
+    texture->name = filename;
+
+    std::string fileLocation = "Textures/" + filename;
+    if(!PixelTextureCompressor::loadMipChain(fileLocation, m_backend->textureCompressionBC, texture->chain))
+    {
+        throw std::runtime_error("Failed to load texture file: " + fileLocation);
+    }
+    if(PixelTextureCompressor::getBlockSize(texture->chain.format) != 0 && !m_backend->textureCompressionBC)
+    {
+        stbi_image_free(texture->chain.data);
+        throw std::runtime_error("The device cannot sample the block compressed texture: " + fileLocation);
+    }
+
+    uint32_t coarsestLevel = 0;
+    while(coarsestLevel + 1 < texture->chain.mipLevels &&
+          std::max(texture->chain.width, texture->chain.height) >> coarsestLevel > STREAMING_INITIAL_SIZE)
+    {
+        coarsestLevel++;
+    }
+    texture->coarsestLevel = coarsestLevel;
+    texture->desiredLevel = coarsestLevel;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    setResidentLevel(*texture, coarsestLevel);
+    texture->lastUsedFrame = m_frame;
+
+    auto textureId = static_cast<uint32_t>(m_textures.size());
+    m_textures.push_back(std::move(texture));
+    return textureId;
+}
+
+std::vector<PixelTextureStreamer::IndexRemap> PixelTextureStreamer::update() {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_frame++;
+
+    //images replaced more than a frame in flight ago are not sampled anymore
+    for(auto it = m_retiredImages.begin(); it != m_retiredImages.end();)
+    {
+        if(it->releaseFrame <= m_frame)
+        {
+            it->image.cleanUp();
+            it = m_retiredImages.erase(it);
+        } else
+        {
+            ++it;
+        }
+    }
+
+    //the feedback is relative to the first resident level
+    for(auto& texture : m_textures)
+    {
+        int32_t feedback = m_textureTable->takeFeedback(static_cast<uint32_t>(texture->textureIndex));
+        if(feedback == PixelTextureTable::NO_FEEDBACK)
+        {
+            continue;
+        }
+        texture->lastUsedFrame = m_frame;
+        int32_t level = static_cast<int32_t>(texture->residentLevel) + feedback;
+        texture->desiredLevel = static_cast<uint32_t>(std::clamp(level, 0, static_cast<int32_t>(texture->coarsestLevel)));
+    }
+
+    //the budget may have been lowered
+    while(m_residentBytes > m_budget && evictOneLevel(nullptr))
+    {
+    }
+
+    //most recently used textures first
+    std::vector<StreamedTexture*> candidates;
+    for(auto& texture : m_textures)
+    {
+        if(texture->desiredLevel < texture->residentLevel)
+        {
+            candidates.push_back(texture.get());
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const StreamedTexture* a, const StreamedTexture* b){
+        return a->lastUsedFrame > b->lastUsedFrame;
+    });
+
+    //only the new finer levels are uploaded, the resident ones are copied on the gpu. the first texture of a frame may
+    //go over the cap, a level bigger than the cap would never stream in otherwise
+    VkDeviceSize streamedBytes = 0;
+    for(StreamedTexture* texture : candidates)
+    {
+        uint32_t level = texture->desiredLevel;
+        while(level < texture->residentLevel)
+        {
+            VkDeviceSize growth = residentSize(*texture, level) - residentSize(*texture, texture->residentLevel);
+            if(streamedBytes == 0 || streamedBytes + growth <= STREAMING_BYTES_PER_FRAME)
+            {
+                while(m_residentBytes + growth > m_budget && evictOneLevel(texture))
+                {
+                }
+                if(m_residentBytes + growth <= m_budget)
+                {
+                    break;
+                }
+            }
+            level++; //a coarser level may still fit
+        }
+
+        if(level < texture->residentLevel)
+        {
+            streamedBytes += residentSize(*texture, level) - residentSize(*texture, texture->residentLevel);
+            m_streamedLevels += texture->residentLevel - level;
+            setResidentLevel(*texture, level);
+        }
+    }
+
+    std::vector<IndexRemap> remaps = std::move(m_remaps);
+    m_remaps.clear();
+    return remaps;
+}
+
+int PixelTextureStreamer::getTextureIndex(uint32_t textureId) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_textures[textureId]->textureIndex;
+}
+
+PixelTextureStreamer::Stats PixelTextureStreamer::getStats() {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Stats stats{};
+    stats.residentBytes = m_residentBytes;
+    stats.budget = m_budget;
+    stats.textureCount = static_cast<uint32_t>(m_textures.size());
+    stats.streamedLevels = m_streamedLevels;
+    stats.evictedLevels = m_evictedLevels;
+    for(auto& texture : m_textures)
+    {
+        if(!m_uploadBatcher->isBatchComplete(texture->uploadBatchId))
+        {
+            stats.pendingUploads++;
+        }
+    }
+    return stats;
+}
+
+void PixelTextureStreamer::setBudget(VkDeviceSize budget) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budget = budget; //applied by the next update
+}
+
+void PixelTextureStreamer::setResidentLevel(StreamedTexture& texture, uint32_t level) {
+
+    PixelImage image(m_backend, 0, 0, false);
+    image.createMipRange(texture.chain, level);
+
+    //the levels shared with the current image are copied from it, unless its own upload is still being recorded: the
+    //batch would copy from it before writing it
+    VkDeviceSize levelOffset = texture.chain.size - residentSize(texture, level);
+    bool copyResidentLevels = texture.textureIndex >= 0 && texture.uploadBatchId < m_uploadBatcher->getRecordingBatchId();
+    if(copyResidentLevels && level < texture.residentLevel)
+    {
+        //the finer levels from the cpu, the rest from the current image's first level on
+        VkDeviceSize uploadSize = residentSize(texture, level) - residentSize(texture, texture.residentLevel);
+        m_uploadBatcher->uploadImage(&image, texture.chain.data + levelOffset, uploadSize, &texture.image, 0);
+    } else if(copyResidentLevels)
+    {
+        //evicted, every level is already on the gpu
+        m_uploadBatcher->uploadImage(&image, nullptr, 0, &texture.image, level - texture.residentLevel);
+    } else
+    {
+        m_uploadBatcher->uploadImage(&image, texture.chain.data + levelOffset, texture.chain.size - levelOffset);
+    }
+    texture.uploadBatchId = m_uploadBatcher->getRecordingBatchId(); //a full ring may have flushed the first copies already
+
+    //draws submitted after the upload batch see the new image. the old one stays valid for the frames in flight
+    int textureIndex = static_cast<int>(m_textureTable->addTexture(&image));
+    if(texture.textureIndex >= 0)
+    {
+        m_textureTable->removeTexture(static_cast<uint32_t>(texture.textureIndex));
+        m_remaps.push_back({texture.textureIndex, textureIndex});
+        m_residentBytes -= texture.image.getImageAllocation()->size;
+        m_retiredImages.push_back({texture.image, m_frame + m_framesInFlight + 1});
+    }
+
+    texture.image = image;
+    texture.textureIndex = textureIndex;
+    texture.residentLevel = level;
+    m_residentBytes += image.getImageAllocation()->size;
+}
+
+VkDeviceSize PixelTextureStreamer::residentSize(const StreamedTexture& texture, uint32_t level) {
+
+    VkDeviceSize size = 0;
+    for(uint32_t i = level; i < texture.chain.mipLevels; i++)
+    {
+        size += PixelTextureCompressor::getLevelSize(texture.chain.format, std::max(texture.chain.width >> i, 1u), std::max(texture.chain.height >> i, 1u));
+    }
+    return size;
+}
+
+bool PixelTextureStreamer::evictOneLevel(const StreamedTexture* keep) {
+
+    //levels finer than what is sampled go first, then the least recently used textures. a texture used as recently
+    //as the one being streamed in keeps its levels
+    StreamedTexture* victim = nullptr;
+    for(auto& texture : m_textures)
+    {
+        bool hasUnusedLevels = texture->residentLevel < texture->desiredLevel;
+        if(texture.get() == keep || texture->residentLevel >= texture->coarsestLevel ||
+           (!hasUnusedLevels && keep != nullptr && texture->lastUsedFrame >= keep->lastUsedFrame))
+        {
+            continue;
+        }
+
+        if(victim == nullptr)
+        {
+            victim = texture.get();
+            continue;
+        }
+        bool victimHasUnusedLevels = victim->residentLevel < victim->desiredLevel;
+        if(hasUnusedLevels != victimHasUnusedLevels ? hasUnusedLevels : texture->lastUsedFrame < victim->lastUsedFrame)
+        {
+            victim = texture.get();
+        }
+    }
+
+    if(victim == nullptr)
+    {
+        return false;
+    }
+
+    uint32_t level = victim->residentLevel < victim->desiredLevel ? victim->desiredLevel : victim->residentLevel + 1;
+    m_evictedLevels += level - victim->residentLevel;
+    setResidentLevel(*victim, level);
+    return true;
+}
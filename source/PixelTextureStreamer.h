@@ -0,0 +1,107 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#ifndef PIXELENGINE_PIXELTEXTURESTREAMER_H
+#define PIXELENGINE_PIXELTEXTURESTREAMER_H
+
+#include "PixelImage.h"
+#include "PixelTextureCompressor.h"
+#include "PixelTextureTable.h"
+#include "PixelUploadBatcher.h"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <string>
+
+const VkDeviceSize DEFAULT_TEXTURE_BUDGET = 256 * 1024 * 1024; //gpu memory of the streamed textures
+const uint32_t STREAMING_INITIAL_SIZE = 64; //a texture starts with the levels of this size and smaller
+const VkDeviceSize STREAMING_BYTES_PER_FRAME = 16 * 1024 * 1024; //most texels streamed in by one update, past the first texture
+
+//keeps the full mip chain of its textures on the cpu and only the levels the screen needs on the gpu. the fragment
+//shaders report the finest level they sample (texture table feedback), finer levels are streamed in from that and
+//the levels of the least recently used textures are evicted when the budget is exceeded.
+//changing the resident levels creates a new image in a new texture table slot, the levels it shares with the old image
+//are copied on the gpu and only the new finer levels are uploaded. the old images are released once the frames in
+//flight are done with them. update() returns the slots that moved so the objects can follow
+class PixelTextureStreamer {
+public:
+    PixelTextureStreamer() = default;
+    PixelTextureStreamer(const PixelTextureStreamer&) = delete;
+    PixelTextureStreamer& operator=(const PixelTextureStreamer&) = delete;
+
+    void init(PixBackend* backend, PixelUploadBatcher* uploadBatcher, PixelTextureTable* textureTable,
+              uint32_t framesInFlight, VkDeviceSize budget = DEFAULT_TEXTURE_BUDGET);
+    void cleanUp();
+
+    //load a texture file (relative to Textures/) with its smallest levels resident. can be called from any thread
+    uint32_t addTexture(const std::string& filename);
+
+    struct IndexRemap{
+        int oldIndex;
+        int newIndex;
+    };
+
+    //once per frame, after the fence of the frame was waited on. records the uploads in the upload batcher
+    std::vector<IndexRemap> update();
+
+    struct Stats{
+        VkDeviceSize residentBytes = 0;
+        VkDeviceSize budget = 0;
+        uint32_t textureCount = 0;
+        uint32_t pendingUploads = 0; //streamed levels the gpu has not finished copying
+        uint64_t streamedLevels = 0; //levels made resident since init
+        uint64_t evictedLevels = 0; //levels dropped to stay in the budget since init
+    };
+
+    //getters
+    int getTextureIndex(uint32_t textureId);
+    Stats getStats();
+
+    //setters
+    void setBudget(VkDeviceSize budget);
+
+private:
+
+    struct StreamedTexture{
+        std::string name;
+        PixelTextureCompressor::TextureData chain; //every level, on the cpu
+        PixelImage image; //levels [residentLevel, chain.mipLevels)
+        uint32_t residentLevel = 0;
+        uint32_t coarsestLevel = 0; //never evicted past this level
+        uint32_t desiredLevel = 0; //finest level sampled recently
+        int textureIndex = -1;
+        uint64_t lastUsedFrame = 0;
+        uint64_t uploadBatchId = 0;
+    };
+
+    struct RetiredImage{
+        PixelImage image;
+        uint64_t releaseFrame;
+    };
+
+    PixBackend* m_backend{};
+    PixelUploadBatcher* m_uploadBatcher{};
+    PixelTextureTable* m_textureTable{};
+    uint32_t m_framesInFlight = 0;
+    VkDeviceSize m_budget = DEFAULT_TEXTURE_BUDGET;
+
+    std::deque<std::unique_ptr<StreamedTexture>> m_textures;
+    std::vector<RetiredImage> m_retiredImages;
+    std::vector<IndexRemap> m_remaps;
+    uint64_t m_frame = 0;
+    VkDeviceSize m_residentBytes = 0;
+    uint64_t m_streamedLevels = 0;
+    uint64_t m_evictedLevels = 0;
+    std::mutex m_mutex;
+
+    //helper functions, called with the mutex held
+    void setResidentLevel(StreamedTexture& texture, uint32_t level);
+    VkDeviceSize residentSize(const StreamedTexture& texture, uint32_t level);
+    bool evictOneLevel(const StreamedTexture* keep);
+};
+
+
+#endif //PIXELENGINE_PIXELTEXTURESTREAMER_H
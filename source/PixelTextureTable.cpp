@@ -0,0 +1,211 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#include "PixelTextureTable.h"
+
+#include <algorithm>
+#include <array>
+
+void PixelTextureTable::init(PixBackend* backend, VkSampler sampler, uint32_t framesInFlight, uint32_t requestedCapacity) {
+
+    printf("Creating Texture Table\n");
+    fflush(stdout);
+
+    m_backend = backend;
+    m_sampler = sampler;
+    m_framesInFlight = framesInFlight;
+
+    //the table is bounded by the update-after-bind limits of the device
+    VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties{};
+    descriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 deviceProperties{};
+    deviceProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    deviceProperties.pNext = &descriptorIndexingProperties;
+    vkGetPhysicalDeviceProperties2(m_backend->physicalDevice, &deviceProperties);
+
+    m_capacity = std::min({requestedCapacity,
+                           descriptorIndexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+                           descriptorIndexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                           descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+                           descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindSampledImages});
+
+    VkDescriptorSetLayoutBinding textureTableBinding{};
+    textureTableBinding.binding = 0; //binding point in shader
+    textureTableBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    textureTableBinding.descriptorCount = m_capacity;
+    textureTableBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    textureTableBinding.pImmutableSamplers = nullptr;
+
+    VkDescriptorSetLayoutBinding feedbackBinding{};
+    feedbackBinding.binding = 1;
+    feedbackBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    feedbackBinding.descriptorCount = 1;
+    feedbackBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    feedbackBinding.pImmutableSamplers = nullptr;
+
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {textureTableBinding, feedbackBinding};
+
+    //unused slots are allowed to stay empty and slots can be written while the set is bound. the feedback buffer is written once
+    std::array<VkDescriptorBindingFlags, 2> bindingFlags = {VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                                            VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                                            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+                                                            0};
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo{};
+    bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsCreateInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+    bindingFlagsCreateInfo.pBindingFlags = bindingFlags.data();
+
+    VkDescriptorSetLayoutCreateInfo layoutCreateInfo{};
+    layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+    layoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutCreateInfo.pBindings = bindings.data();
+
+    VkResult result = vkCreateDescriptorSetLayout(m_backend->logicalDevice, &layoutCreateInfo, nullptr, &m_descriptorSetLayout);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create descriptor set layout for the texture table");
+    }
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = m_capacity;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo poolCreateInfo{};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolCreateInfo.maxSets = 1;
+    poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolCreateInfo.pPoolSizes = poolSizes.data();
+
+    result = vkCreateDescriptorPool(m_backend->logicalDevice, &poolCreateInfo, nullptr, &m_descriptorPool);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create descriptor pool for the texture table");
+    }
+
+    VkDescriptorSetAllocateInfo setAllocateInfo{};
+    setAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setAllocateInfo.descriptorPool = m_descriptorPool;
+    setAllocateInfo.descriptorSetCount = 1;
+    setAllocateInfo.pSetLayouts = &m_descriptorSetLayout;
+
+    result = vkAllocateDescriptorSets(m_backend->logicalDevice, &setAllocateInfo, &m_descriptorSet);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate descriptor set for the texture table");
+    }
+
+    //no slot was sampled yet
+    m_backend->allocator->createBuffer(sizeof(int32_t) * m_capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       &m_feedbackBuffer, &m_feedbackAllocation);
+    std::fill_n(static_cast<int32_t*>(m_feedbackAllocation.mappedData), m_capacity, NO_FEEDBACK);
+
+    VkDescriptorBufferInfo feedbackBufferInfo{};
+    feedbackBufferInfo.buffer = m_feedbackBuffer;
+    feedbackBufferInfo.offset = 0;
+    feedbackBufferInfo.range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet feedbackWrite{};
+    feedbackWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    feedbackWrite.dstSet = m_descriptorSet;
+    feedbackWrite.dstBinding = 1; //matches layout(binding = 1)
+    feedbackWrite.dstArrayElement = 0;
+    feedbackWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    feedbackWrite.descriptorCount = 1;
+    feedbackWrite.pBufferInfo = &feedbackBufferInfo;
+
+    vkUpdateDescriptorSets(m_backend->logicalDevice, 1, &feedbackWrite, 0, nullptr);
+}
+
+void PixelTextureTable::cleanUp() {
+    m_backend->allocator->destroyBuffer(&m_feedbackBuffer, &m_feedbackAllocation);
+    vkDestroyDescriptorPool(m_backend->logicalDevice, m_descriptorPool, nullptr); //frees the set with it
+    vkDestroyDescriptorSetLayout(m_backend->logicalDevice, m_descriptorSetLayout, nullptr);
+}
+
+uint32_t PixelTextureTable::addTexture(PixelImage* image) {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t textureIndex;
+    if(!m_freeSlots.empty())
+    {
+        textureIndex = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    } else if(m_nextUnusedSlot < m_capacity)
+    {
+        textureIndex = m_nextUnusedSlot++;
+    } else
+    {
+        throw std::runtime_error("the texture table is full");
+    }
+
+    writeSlot(textureIndex, image->getImageView());
+    static_cast<int32_t*>(m_feedbackAllocation.mappedData)[textureIndex] = NO_FEEDBACK; //forget the slot's previous texture
+    m_textureCount++;
+
+    return textureIndex;
+}
+
+void PixelTextureTable::removeTexture(uint32_t textureIndex) {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    //the slot keeps its descriptor until it is reused. nothing indexes it anymore so partially bound covers it
+    m_retiredSlots.push_back({textureIndex, m_frame + m_framesInFlight + 1});
+    m_textureCount--;
+}
+
+void PixelTextureTable::beginFrame() {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_frame++;
+
+    for(auto it = m_retiredSlots.begin(); it != m_retiredSlots.end();)
+    {
+        if(it->releaseFrame <= m_frame)
+        {
+            m_freeSlots.push_back(it->textureIndex);
+            it = m_retiredSlots.erase(it);
+        } else
+        {
+            ++it;
+        }
+    }
+}
+
+int32_t PixelTextureTable::takeFeedback(uint32_t textureIndex) {
+
+    auto feedback = static_cast<volatile int32_t*>(m_feedbackAllocation.mappedData);
+    int32_t level = feedback[textureIndex];
+    feedback[textureIndex] = NO_FEEDBACK;
+    return level;
+}
+
+void PixelTextureTable::writeSlot(uint32_t textureIndex, VkImageView imageView) {
+
+    VkDescriptorImageInfo textureImageInfo{};
+    textureImageInfo.imageView = imageView; //image view of the texture
+    textureImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; //what is the image layout when in use
+    textureImageInfo.sampler = m_sampler;
+
+    VkWriteDescriptorSet textureWrite{};
+    textureWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    textureWrite.dstSet = m_descriptorSet;
+    textureWrite.dstBinding = 0; //matches layout(binding = 0)
+    textureWrite.dstArrayElement = textureIndex; //the global texture index
+    textureWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    textureWrite.descriptorCount = 1;
+    textureWrite.pImageInfo = &textureImageInfo;
+
+    vkUpdateDescriptorSets(m_backend->logicalDevice, 1, &textureWrite, 0, nullptr);
+}
@@ -0,0 +1,80 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#ifndef PIXELENGINE_PIXELTEXTURETABLE_H
+#define PIXELENGINE_PIXELTEXTURETABLE_H
+
+#include "PixelImage.h"
+
+#include <mutex>
+#include <cstdint>
+
+//one global, partially bound array of combined image samplers shared by every scene. a texture keeps the same index
+//for its whole life and shaders index the array with it directly. slots are written with update-after-bind, so
+//textures can come and go while command buffers using the set are recorded or in flight.
+//the set also holds the sampling feedback: the finest mip level the fragment shaders sampled each slot at
+class PixelTextureTable {
+public:
+    PixelTextureTable() = default;
+    PixelTextureTable(const PixelTextureTable&) = delete;
+    PixelTextureTable& operator=(const PixelTextureTable&) = delete;
+
+    void init(PixBackend* backend, VkSampler sampler, uint32_t framesInFlight, uint32_t requestedCapacity = DEFAULT_CAPACITY);
+    void cleanUp();
+
+    //returns the global index of the texture. the image must be in shader read only layout by the time it is sampled
+    uint32_t addTexture(PixelImage* image);
+    //the slot is reused only once every frame that could still sample it is done
+    void removeTexture(uint32_t textureIndex);
+    //advance the frame counter, recycles the slots of removed textures
+    void beginFrame();
+
+    //finest level a slot was sampled at since the last call, relative to the first level of its image view.
+    //NO_FEEDBACK if it was not sampled. frames in flight keep writing while it is read, a missed sample comes back later
+    int32_t takeFeedback(uint32_t textureIndex);
+
+    //getters
+    VkDescriptorSetLayout* getDescriptorSetLayout(){return &m_descriptorSetLayout;}
+    VkDescriptorSet* getDescriptorSet(){return &m_descriptorSet;}
+    uint32_t getCapacity() const {return m_capacity;}
+    uint32_t getTextureCount() const {return m_textureCount;}
+
+    static constexpr uint32_t DEFAULT_CAPACITY = 4096;
+    static constexpr int32_t NO_FEEDBACK = INT32_MAX;
+
+private:
+
+    struct RetiredSlot
+    {
+        uint32_t textureIndex;
+        uint64_t releaseFrame;
+    };
+
+    PixBackend* m_backend{};
+    VkSampler m_sampler{};
+    uint32_t m_capacity = 0;
+    uint32_t m_framesInFlight = 0;
+
+    VkDescriptorSetLayout m_descriptorSetLayout{};
+    VkDescriptorPool m_descriptorPool{};
+    VkDescriptorSet m_descriptorSet{};
+
+    //host visible, one int per slot
+    VkBuffer m_feedbackBuffer{};
+    PixAllocation m_feedbackAllocation{};
+
+    //slot management
+    uint32_t m_nextUnusedSlot = 0;
+    uint32_t m_textureCount = 0;
+    std::vector<uint32_t> m_freeSlots;
+    std::vector<RetiredSlot> m_retiredSlots;
+    uint64_t m_frame = 0;
+    std::mutex m_mutex;
+
+    //helper functions
+    void writeSlot(uint32_t textureIndex, VkImageView imageView);
+};
+
+
+#endif //PIXELENGINE_PIXELTEXTURETABLE_H
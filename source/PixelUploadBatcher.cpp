@@ -0,0 +1,615 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#include "PixelUploadBatcher.h"
+
+#include <limits>
+#include <algorithm>
+
+void PixelUploadBatcher::init(PixBackend* backend, VkQueue queue, uint32_t queueFamilyIndex, VkDeviceSize ringSize) {
+
+    printf("Creating Upload Batcher\n");
+    fflush(stdout);
+
+    m_backend = backend;
+    m_queue = queue;
+    m_ringSize = ringSize;
+
+    //command buffers are reset one by one when their batch is recycled
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+
+    VkResult result = vkCreateCommandPool(m_backend->logicalDevice, &poolInfo, nullptr, &m_commandPool);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create the upload command pool");
+    }
+
+    m_backend->allocator->createBuffer(m_ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       &m_ringBuffer, &m_ringAllocation);
+}
+
+void PixelUploadBatcher::cleanUp() {
+
+    if(m_commandPool == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    waitIdle();
+
+    for(auto& batch : m_freeBatches)
+    {
+        vkDestroyFence(m_backend->logicalDevice, batch.fence, nullptr);
+    }
+    m_freeBatches.clear();
+
+    vkDestroyCommandPool(m_backend->logicalDevice, m_commandPool, nullptr); //frees the command buffers with it
+    m_commandPool = VK_NULL_HANDLE;
+
+    m_backend->allocator->destroyBuffer(&m_ringBuffer, &m_ringAllocation);
+}
+
+void PixelUploadBatcher::uploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset,
+                                      VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+
+    if(size == 0)
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    PendingBufferCopy copy{};
+    copy.dstBuffer = dstBuffer;
+    copy.region.srcOffset = stageData(lock, size, [data, size](void* staging){ memcpy(staging, data, static_cast<size_t>(size)); }, &copy.srcBuffer);
+    copy.region.dstOffset = dstOffset;
+    copy.region.size = size;
+    m_bufferCopies.push_back(copy);
+
+    //one memory barrier at the end of the batch makes every buffer copy visible to its consumers
+    m_postCopyStages |= dstStage;
+    m_postCopyAccess |= dstAccess;
+    m_hasPendingWork = true;
+}
+
+void PixelUploadBatcher::uploadImage(PixelImage* dstImage, const void* data, VkDeviceSize size) {
+    uploadImage(dstImage, size, [data, size](void* staging){ memcpy(staging, data, static_cast<size_t>(size)); });
+}
+
+void PixelUploadBatcher::uploadImage(PixelImage* dstImage, VkDeviceSize size, const std::function<void(void* staging)>& write) {
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    uint32_t copiedLevels = recordLevelUploads(lock, dstImage, size, write);
+
+    //the image has to be in transfer dst layout before the copy and shader read only after it
+    transitionImageLocked(dstImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    if(copiedLevels < dstImage->getMipLevels())
+    {
+        //the blits leave every level in transfer src
+        m_mipChains.push_back({dstImage->getImage(), dstImage->getWidth(), dstImage->getHeight(), std::max(copiedLevels, 1u), dstImage->getMipLevels()});
+        transitionImageLocked(dstImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    } else
+    {
+        transitionImageLocked(dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+}
+
+void PixelUploadBatcher::uploadImage(PixelImage* dstImage, const void* data, VkDeviceSize size, PixelImage* srcImage, uint32_t srcFirstLevel) {
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    uint32_t uploadedLevels = 0;
+    if(size > 0)
+    {
+        uploadedLevels = recordLevelUploads(lock, dstImage, size, [data, size](void* staging){ memcpy(staging, data, static_cast<size_t>(size)); });
+    }
+
+    //the levels the gpu already has are copied image to image, they take no staging space
+    for(uint32_t level = uploadedLevels; level < dstImage->getMipLevels(); level++)
+    {
+        PendingLevelCopy copy{};
+        copy.srcImage = srcImage->getImage();
+        copy.dstImage = dstImage->getImage();
+        copy.region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, srcFirstLevel + level - uploadedLevels, 0, 1};
+        copy.region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+        copy.region.extent = {dstImage->getMipWidth(level), dstImage->getMipHeight(level), 1};
+        m_levelCopies.push_back(copy);
+    }
+
+    transitionImageLocked(dstImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    transitionImageLocked(srcImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    transitionImageLocked(dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    transitionImageLocked(srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+uint32_t PixelUploadBatcher::recordLevelUploads(std::unique_lock<std::mutex>& lock, PixelImage* dstImage, VkDeviceSize size, const std::function<void(void* staging)>& write) {
+
+    VkBuffer srcBuffer = VK_NULL_HANDLE;
+    VkDeviceSize bufferOffset = stageData(lock, size, write, &srcBuffer);
+
+    //one copy per level in the data
+    uint32_t copiedLevels = 0;
+    VkDeviceSize levelOffset = 0;
+    while(copiedLevels < dstImage->getMipLevels() && levelOffset + dstImage->getMipLevelSize(copiedLevels) <= size)
+    {
+        PendingImageCopy copy{};
+        copy.srcBuffer = srcBuffer;
+        copy.dstImage = dstImage->getImage();
+        copy.region.bufferOffset = bufferOffset + levelOffset;
+        copy.region.bufferRowLength = 0; //tightly packed
+        copy.region.bufferImageHeight = 0;
+        copy.region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copy.region.imageSubresource.layerCount = 1;
+        copy.region.imageSubresource.baseArrayLayer = 0;
+        copy.region.imageSubresource.mipLevel = copiedLevels;
+        copy.region.imageOffset = {0,0,0};
+        copy.region.imageExtent = {dstImage->getMipWidth(copiedLevels), dstImage->getMipHeight(copiedLevels), 1};
+        m_imageCopies.push_back(copy);
+
+        levelOffset += dstImage->getMipLevelSize(copiedLevels);
+        copiedLevels++;
+    }
+    return copiedLevels;
+}
+
+void PixelUploadBatcher::transitionImage(PixelImage* image, VkImageLayout oldLayout, VkImageLayout newLayout) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    transitionImageLocked(image, oldLayout, newLayout);
+}
+
+void PixelUploadBatcher::transitionImageLocked(PixelImage* image, VkImageLayout oldLayout, VkImageLayout newLayout) {
+
+    VkImageMemoryBarrier imageMemoryBarrier{};
+    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageMemoryBarrier.oldLayout = oldLayout;
+    imageMemoryBarrier.newLayout = newLayout;
+    imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageMemoryBarrier.image = image->getImage();
+    imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+    imageMemoryBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+    imageMemoryBarrier.subresourceRange.layerCount = 1;
+
+    VkPipelineStageFlags srcStage;
+    VkPipelineStageFlags dstStage;
+    layoutTransitionMasks(oldLayout, newLayout, &imageMemoryBarrier.srcAccessMask, &imageMemoryBarrier.dstAccessMask, &srcStage, &dstStage);
+
+    //transitions into transfer dst or src go before all the copies of the batch, everything else after them
+    if(newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL || newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+    {
+        m_preCopyBarriers.push_back(imageMemoryBarrier);
+        m_preCopyStages |= srcStage;
+    } else
+    {
+        m_postCopyBarriers.push_back(imageMemoryBarrier);
+        m_postCopyStages |= dstStage;
+    }
+
+    m_hasPendingWork = true;
+}
+
+uint64_t PixelUploadBatcher::flush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return flushLocked(lock);
+}
+
+uint64_t PixelUploadBatcher::flushLocked(std::unique_lock<std::mutex>& lock) {
+
+    //staging copies of this batch still being written by other threads
+    m_stagingWritesDone.wait(lock, [this](){ return m_pendingStagingWrites == 0; });
+
+    if(!m_hasPendingWork)
+    {
+        return m_nextBatchId - 1; //nothing recorded, the last submitted batch is the one to wait on
+    }
+
+    Batch batch = acquireBatch();
+
+    //the staging space and dedicated buffers used so far belong to this batch
+    batch.ringBytes = m_currentBatch.ringBytes;
+    batch.dedicatedStaging = std::move(m_currentBatch.dedicatedStaging);
+    m_currentBatch = {};
+
+    batch.id = m_nextBatchId++;
+    batch.ringEnd = m_ringHead;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VkResult result = vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to begin recording the upload command buffer");
+    }
+
+    if(!m_preCopyBarriers.empty())
+    {
+        vkCmdPipelineBarrier(batch.commandBuffer,
+                             m_preCopyStages, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             0, nullptr,
+                             0, nullptr,
+                             static_cast<uint32_t>(m_preCopyBarriers.size()), m_preCopyBarriers.data());
+    }
+
+    for(const auto& copy : m_bufferCopies)
+    {
+        vkCmdCopyBuffer(batch.commandBuffer, copy.srcBuffer, copy.dstBuffer, 1, &copy.region);
+    }
+
+    for(const auto& copy : m_imageCopies)
+    {
+        vkCmdCopyBufferToImage(batch.commandBuffer, copy.srcBuffer, copy.dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+    }
+
+    for(const auto& copy : m_levelCopies)
+    {
+        vkCmdCopyImage(batch.commandBuffer, copy.srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       copy.dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+    }
+
+    for(const auto& mipChain : m_mipChains)
+    {
+        recordMipChain(batch.commandBuffer, mipChain);
+    }
+
+    //a single barrier for every buffer consumer plus the final layout of every image
+    VkMemoryBarrier memoryBarrier{};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = m_postCopyAccess;
+
+    if(m_postCopyStages != 0)
+    {
+        vkCmdPipelineBarrier(batch.commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, m_postCopyStages,
+                             0,
+                             m_bufferCopies.empty() ? 0 : 1, &memoryBarrier,
+                             0, nullptr,
+                             static_cast<uint32_t>(m_postCopyBarriers.size()), m_postCopyBarriers.data());
+    }
+
+    result = vkEndCommandBuffer(batch.commandBuffer);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to end recording the upload command buffer");
+    }
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+    //no wait here. later submissions on the same queue are ordered after the barriers above
+    result = vkQueueSubmit(m_queue, 1, &submitInfo, batch.fence);
+    if(result != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to submit the upload batch");
+    }
+
+    uint64_t batchId = batch.id;
+    m_inFlightBatches.push_back(std::move(batch));
+
+    m_preCopyBarriers.clear();
+    m_preCopyStages = 0;
+    m_bufferCopies.clear();
+    m_imageCopies.clear();
+    m_levelCopies.clear();
+    m_mipChains.clear();
+    m_postCopyBarriers.clear();
+    m_postCopyStages = 0;
+    m_postCopyAccess = 0;
+    m_hasPendingWork = false;
+
+    return batchId;
+}
+
+void PixelUploadBatcher::poll() {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    //batches are submitted to a single queue so they complete in order
+    while(!m_inFlightBatches.empty())
+    {
+        if(vkGetFenceStatus(m_backend->logicalDevice, m_inFlightBatches.front().fence) != VK_SUCCESS)
+        {
+            break;
+        }
+
+        retireBatch(m_inFlightBatches.front());
+        m_inFlightBatches.pop_front();
+    }
+}
+
+void PixelUploadBatcher::waitForBatch(uint64_t batchId) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    waitForBatchLocked(lock, batchId);
+}
+
+void PixelUploadBatcher::waitForBatchLocked(std::unique_lock<std::mutex>& lock, uint64_t batchId) {
+
+    if(batchId >= m_nextBatchId)
+    {
+        flushLocked(lock); //the batch is still being recorded
+    }
+
+    while(!m_inFlightBatches.empty() && m_inFlightBatches.front().id <= batchId)
+    {
+        vkWaitForFences(m_backend->logicalDevice, 1, &m_inFlightBatches.front().fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        retireBatch(m_inFlightBatches.front());
+        m_inFlightBatches.pop_front();
+    }
+}
+
+void PixelUploadBatcher::waitIdle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    waitForBatchLocked(lock, flushLocked(lock));
+}
+
+bool PixelUploadBatcher::isBatchComplete(uint64_t batchId) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return batchId <= m_completedBatchId;
+}
+
+uint64_t PixelUploadBatcher::getCompletedBatchId() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_completedBatchId;
+}
+
+uint64_t PixelUploadBatcher::getRecordingBatchId() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_nextBatchId;
+}
+
+uint32_t PixelUploadBatcher::getBatchesInFlight() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return static_cast<uint32_t>(m_inFlightBatches.size());
+}
+
+VkDeviceSize PixelUploadBatcher::getBytesUploaded() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bytesUploaded;
+}
+
+VkDeviceSize PixelUploadBatcher::stageData(std::unique_lock<std::mutex>& lock, VkDeviceSize size, const std::function<void(void* staging)>& write, VkBuffer* srcBuffer) {
+
+    m_bytesUploaded += size;
+
+    void* staging = nullptr;
+    VkDeviceSize offset = 0;
+    if(size > m_ringSize)
+    {
+        //too big for the ring, give it a staging buffer of its own that dies with the batch
+        std::pair<VkBuffer, PixAllocation> dedicated{};
+        m_backend->allocator->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                           &dedicated.first, &dedicated.second);
+
+        staging = dedicated.second.mappedData;
+        *srcBuffer = dedicated.first;
+        m_currentBatch.dedicatedStaging.push_back(dedicated);
+    } else
+    {
+        while(!tryAllocateFromRing(size, &offset))
+        {
+            //the ring is full. submit what we have and wait for the oldest batch to give its space back
+            flushLocked(lock);
+            waitForBatchLocked(lock, m_inFlightBatches.front().id);
+        }
+
+        staging = static_cast<char*>(m_ringAllocation.mappedData) + offset;
+        *srcBuffer = m_ringBuffer;
+    }
+
+    //the space is reserved, other threads can record while this one writes it
+    m_pendingStagingWrites++;
+    lock.unlock();
+    write(staging);
+    lock.lock();
+    if(--m_pendingStagingWrites == 0)
+    {
+        m_stagingWritesDone.notify_all();
+    }
+
+    return offset;
+}
+
+bool PixelUploadBatcher::tryAllocateFromRing(VkDeviceSize size, VkDeviceSize* offset) {
+
+    if(m_ringUsed == 0)
+    {
+        m_ringHead = 0;
+        m_ringTail = 0;
+    } else if(m_ringHead == m_ringTail)
+    {
+        return false; //completely full
+    }
+
+    VkDeviceSize alignedHead = (m_ringHead + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+    VkDeviceSize takenBytes = 0;
+
+    if(m_ringHead >= m_ringTail)
+    {
+        //free space is [head, end) followed by [0, tail)
+        if(alignedHead + size <= m_ringSize)
+        {
+            *offset = alignedHead;
+            takenBytes = alignedHead + size - m_ringHead;
+        } else if(size <= m_ringTail)
+        {
+            *offset = 0;
+            takenBytes = (m_ringSize - m_ringHead) + size; //the end of the ring is skipped
+        } else
+        {
+            return false;
+        }
+    } else
+    {
+        //free space is [head, tail)
+        if(alignedHead + size > m_ringTail)
+        {
+            return false;
+        }
+        *offset = alignedHead;
+        takenBytes = alignedHead + size - m_ringHead;
+    }
+
+    m_ringHead = (*offset + size) % m_ringSize;
+    m_ringUsed += takenBytes;
+    m_currentBatch.ringBytes += takenBytes;
+
+    return true;
+}
+
+void PixelUploadBatcher::retireBatch(Batch& batch) {
+
+    m_ringUsed -= batch.ringBytes;
+    m_ringTail = batch.ringEnd;
+    m_completedBatchId = batch.id;
+
+    for(auto& staging : batch.dedicatedStaging)
+    {
+        m_backend->allocator->destroyBuffer(&staging.first, &staging.second);
+    }
+
+    //keep the command buffer and fence for a later batch
+    Batch freeBatch{};
+    freeBatch.commandBuffer = batch.commandBuffer;
+    freeBatch.fence = batch.fence;
+    vkResetFences(m_backend->logicalDevice, 1, &freeBatch.fence);
+    vkResetCommandBuffer(freeBatch.commandBuffer, 0);
+    m_freeBatches.push_back(freeBatch);
+}
+
+PixelUploadBatcher::Batch PixelUploadBatcher::acquireBatch() {
+
+    Batch batch{};
+
+    if(!m_freeBatches.empty())
+    {
+        batch = m_freeBatches.back();
+        m_freeBatches.pop_back();
+    } else
+    {
+        VkCommandBufferAllocateInfo allocateInfo{};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocateInfo.commandPool = m_commandPool;
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocateInfo.commandBufferCount = 1;
+
+        VkResult result = vkAllocateCommandBuffers(m_backend->logicalDevice, &allocateInfo, &batch.commandBuffer);
+        if(result != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate an upload command buffer");
+        }
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        result = vkCreateFence(m_backend->logicalDevice, &fenceInfo, nullptr, &batch.fence);
+        if(result != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create an upload fence");
+        }
+    }
+
+    return batch;
+}
+
+void PixelUploadBatcher::recordMipChain(VkCommandBuffer commandBuffer, const PendingMipChain& mipChain) {
+
+    VkImageMemoryBarrier imageMemoryBarrier{};
+    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageMemoryBarrier.image = mipChain.image;
+    imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+    imageMemoryBarrier.subresourceRange.layerCount = 1;
+    imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    //the copied levels become blit sources, then each generated level once it is written
+    imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+    imageMemoryBarrier.subresourceRange.levelCount = mipChain.firstLevel;
+    for(uint32_t level = mipChain.firstLevel; level <= mipChain.levelCount; level++)
+    {
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             0, nullptr,
+                             0, nullptr,
+                             1, &imageMemoryBarrier);
+
+        if(level == mipChain.levelCount)
+        {
+            break;
+        }
+
+        VkImageBlit blit{};
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = level - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = 1;
+        blit.srcOffsets[1] = {static_cast<int32_t>(std::max(mipChain.width >> (level - 1), 1u)), static_cast<int32_t>(std::max(mipChain.height >> (level - 1), 1u)), 1};
+        blit.dstSubresource = blit.srcSubresource;
+        blit.dstSubresource.mipLevel = level;
+        blit.dstOffsets[1] = {static_cast<int32_t>(std::max(mipChain.width >> level, 1u)), static_cast<int32_t>(std::max(mipChain.height >> level, 1u)), 1};
+
+        vkCmdBlitImage(commandBuffer,
+                       mipChain.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       mipChain.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       1, &blit, VK_FILTER_LINEAR);
+
+        imageMemoryBarrier.subresourceRange.baseMipLevel = level;
+        imageMemoryBarrier.subresourceRange.levelCount = 1;
+    }
+}
+
+void PixelUploadBatcher::layoutTransitionMasks(VkImageLayout oldLayout, VkImageLayout newLayout,
+                                               VkAccessFlags* srcAccess, VkAccessFlags* dstAccess,
+                                               VkPipelineStageFlags* srcStage, VkPipelineStageFlags* dstStage) {
+
+    if(oldLayout == VK_IMAGE_LAYOUT_UNDEFINED)
+    {
+        *srcAccess = 0; //from the very start. there is no specified stage.
+        *srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    } else if(oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+    {
+        *srcAccess = 0; //the draws submitted before only read it, waiting for them is enough
+        *srcStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    } else
+    {
+        *srcAccess = VK_ACCESS_TRANSFER_WRITE_BIT; //everything the batcher writes comes from a transfer
+        *srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+
+    if(newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+    {
+        *dstAccess = VK_ACCESS_TRANSFER_WRITE_BIT;
+        *dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    } else if(newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+    {
+        *dstAccess = VK_ACCESS_TRANSFER_READ_BIT;
+        *dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    } else if(newLayout == VK_IMAGE_LAYOUT_GENERAL)
+    {
+        *dstAccess = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        *dstStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    } else
+    {
+        *dstAccess = VK_ACCESS_SHADER_READ_BIT;
+        *dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    }
+}
@@ -0,0 +1,157 @@
+//
+// Created by hlahm on 2026-10-18.
+//
+
+#ifndef PIXELENGINE_PIXELUPLOADBATCHER_H
+#define PIXELENGINE_PIXELUPLOADBATCHER_H
+
+#include "PixelImage.h"
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+//records buffer and texture uploads into one command buffer per batch. the source data is copied into a persistently
+//mapped staging ring right away, so the caller can release its cpu copy as soon as the upload call returns.
+//submitting a batch does not wait on the gpu, poll() retires finished batches and gives their staging space back.
+//uploads can be recorded from several threads, the copies into the staging ring run in parallel. a batch is submitted
+//to the queue from whichever thread flushes it (or fills the ring), the queue must not be used elsewhere meanwhile
+class PixelUploadBatcher {
+public:
+    PixelUploadBatcher() = default;
+    PixelUploadBatcher(const PixelUploadBatcher&) = delete;
+    PixelUploadBatcher& operator=(const PixelUploadBatcher&) = delete;
+
+    void init(PixBackend* backend, VkQueue queue, uint32_t queueFamilyIndex, VkDeviceSize ringSize = DEFAULT_RING_SIZE);
+    void cleanUp();
+
+    //upload functions (recorded into the current batch)
+    void uploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset,
+                      VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+    //data holds the first mip levels of the image back to back, the levels it does not cover are blitted from the last one
+    void uploadImage(PixelImage* dstImage, const void* data, VkDeviceSize size);
+    //same, write(staging) fills the size bytes in the staging memory on the calling thread. decoding straight into it
+    //leaves no cpu copy of the pixels to keep around
+    void uploadImage(PixelImage* dstImage, VkDeviceSize size, const std::function<void(void* staging)>& write);
+    //data holds the first mip levels of dstImage, the levels after them are copied on the gpu from srcImage, starting at
+    //its level srcFirstLevel. srcImage is sampled (shader read only) before and after the batch
+    void uploadImage(PixelImage* dstImage, const void* data, VkDeviceSize size, PixelImage* srcImage, uint32_t srcFirstLevel);
+    void transitionImage(PixelImage* image, VkImageLayout oldLayout, VkImageLayout newLayout);
+
+    //submit the recorded batch without waiting. returns the batch id to check for completion
+    uint64_t flush();
+    //retire every batch the gpu is done with
+    void poll();
+    void waitForBatch(uint64_t batchId);
+    void waitIdle();
+    bool isBatchComplete(uint64_t batchId);
+
+    //getters
+    uint64_t getCompletedBatchId();
+    uint64_t getRecordingBatchId(); //id the next flush submits the recorded copies under
+    uint32_t getBatchesInFlight();
+    VkDeviceSize getBytesUploaded();
+
+    static constexpr VkDeviceSize DEFAULT_RING_SIZE = 32 * 1024 * 1024;
+    static constexpr VkDeviceSize STAGING_ALIGNMENT = 16; //covers the texel/block size of every format we copy to
+
+private:
+
+    struct PendingBufferCopy
+    {
+        VkBuffer srcBuffer;
+        VkBuffer dstBuffer;
+        VkBufferCopy region;
+    };
+
+    struct PendingImageCopy
+    {
+        VkBuffer srcBuffer;
+        VkImage dstImage;
+        VkBufferImageCopy region;
+    };
+
+    struct PendingLevelCopy
+    {
+        VkImage srcImage;
+        VkImage dstImage;
+        VkImageCopy region;
+    };
+
+    //levels of an image blitted from the level before once the copies are done
+    struct PendingMipChain
+    {
+        VkImage image;
+        uint32_t width;
+        uint32_t height;
+        uint32_t firstLevel; //first level to generate, the ones before it are copied
+        uint32_t levelCount;
+    };
+
+    struct Batch
+    {
+        uint64_t id = 0;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        VkDeviceSize ringEnd = 0; //ring head once the batch was recorded
+        VkDeviceSize ringBytes = 0; //ring bytes (including wrap padding) released when the batch retires
+        std::vector<std::pair<VkBuffer, PixAllocation>> dedicatedStaging; //uploads too big for the ring
+    };
+
+    PixBackend* m_backend{};
+    VkQueue m_queue{};
+    VkCommandPool m_commandPool{};
+
+    //staging ring
+    VkBuffer m_ringBuffer{};
+    PixAllocation m_ringAllocation{};
+    VkDeviceSize m_ringSize = 0;
+    VkDeviceSize m_ringHead = 0; //next free byte
+    VkDeviceSize m_ringTail = 0; //first byte the gpu may still be reading
+    VkDeviceSize m_ringUsed = 0; //bytes between tail and head
+
+    //batch being recorded
+    Batch m_currentBatch{};
+    std::vector<VkImageMemoryBarrier> m_preCopyBarriers;
+    VkPipelineStageFlags m_preCopyStages = 0; //stages the images of the pre copy barriers were last used in
+    std::vector<PendingBufferCopy> m_bufferCopies;
+    std::vector<PendingImageCopy> m_imageCopies;
+    std::vector<PendingLevelCopy> m_levelCopies;
+    std::vector<PendingMipChain> m_mipChains;
+    std::vector<VkImageMemoryBarrier> m_postCopyBarriers;
+    VkPipelineStageFlags m_postCopyStages = 0;
+    VkAccessFlags m_postCopyAccess = 0;
+    bool m_hasPendingWork = false;
+
+    //submitted batches, oldest first. retired command buffers and fences are recycled
+    std::deque<Batch> m_inFlightBatches;
+    std::vector<Batch> m_freeBatches;
+    uint64_t m_nextBatchId = 1;
+    uint64_t m_completedBatchId = 0;
+
+    VkDeviceSize m_bytesUploaded = 0;
+
+    //every member above is guarded by the mutex. staging copies are made without it and counted here,
+    //a batch is only submitted once they are done
+    std::mutex m_mutex;
+    std::condition_variable m_stagingWritesDone;
+    uint32_t m_pendingStagingWrites = 0;
+
+    //helper functions, called with the mutex held
+    VkDeviceSize stageData(std::unique_lock<std::mutex>& lock, VkDeviceSize size, const std::function<void(void* staging)>& write, VkBuffer* srcBuffer);
+    uint32_t recordLevelUploads(std::unique_lock<std::mutex>& lock, PixelImage* dstImage, VkDeviceSize size, const std::function<void(void* staging)>& write);
+    uint64_t flushLocked(std::unique_lock<std::mutex>& lock);
+    void waitForBatchLocked(std::unique_lock<std::mutex>& lock, uint64_t batchId);
+    void transitionImageLocked(PixelImage* image, VkImageLayout oldLayout, VkImageLayout newLayout);
+    void recordMipChain(VkCommandBuffer commandBuffer, const PendingMipChain& mipChain);
+    bool tryAllocateFromRing(VkDeviceSize size, VkDeviceSize* offset);
+    void retireBatch(Batch& batch);
+    Batch acquireBatch();
+    static void layoutTransitionMasks(VkImageLayout oldLayout, VkImageLayout newLayout,
+                                      VkAccessFlags* srcAccess, VkAccessFlags* dstAccess,
+                                      VkPipelineStageFlags* srcStage, VkPipelineStageFlags* dstStage);
+};
+
+
+#endif //PIXELENGINE_PIXELUPLOADBATCHER_H
@@ -16,6 +16,9 @@
 #include <cstring>
 
 
+class PixelMemoryAllocator;
+class PixelTextureTable;
+
 inline std::random_device rd;
 inline std::mt19937 gen(rd());
 
@@ -24,6 +27,9 @@ struct PixBackend{
     VkPhysicalDevice physicalDevice{};
     VkDevice logicalDevice{};
     VkExtent2D extent{};
+    PixelMemoryAllocator* allocator{}; //every buffer and image is sub-allocated through this
+    PixelTextureTable* textureTable{}; //global bindless texture array shared by all scenes
+    bool textureCompressionBC = false; //BC1-BC7 textures can be sampled
 };
 
 struct QueueFamilyIndices
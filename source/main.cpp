@@ -3,12 +3,121 @@
 
 #include "PixelScene.h"
 #include "PixelRenderer.h"
+#include "PixelTextureCompressor.h"
+#include "PixelImageDecoder.h"
+#include "PixelBVH.h"
 
-int main()
+#include <filesystem>
+#include <cctype>
+#include <thread>
+
+int main(int argc, char* argv[])
 {
 
 	PixelRenderer pixRenderer;
 
+    //--headless [frameCount] renders offscreen without a window and writes the last frame to frame.ppm
+    if (argc > 1 && strcmp(argv[1], "--headless") == 0)
+    {
+        uint32_t frameCount = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 100;
+
+        if (pixRenderer.initHeadlessRenderer(1024, 768) == EXIT_FAILURE)
+        {
+            return EXIT_FAILURE;
+        }
+
+        pixRenderer.runHeadless(frameCount);
+        pixRenderer.saveFrame("frame.ppm");
+
+        pixRenderer.cleanup();
+
+        return 0;
+    }
+
+    //--benchmark-recording [objectCount] [iterations] times the scene's command recording for every thread count
+    if (argc > 1 && strcmp(argv[1], "--benchmark-recording") == 0)
+    {
+        uint32_t objectCount = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 10000;
+        uint32_t iterations = argc > 3 ? static_cast<uint32_t>(std::stoul(argv[3])) : 20;
+
+        if (pixRenderer.initBenchmarkRenderer(1024, 768, objectCount) == EXIT_FAILURE)
+        {
+            return EXIT_FAILURE;
+        }
+
+        pixRenderer.runHeadless(MAX_FRAME_DRAWS); //every frame's draw candidates are written
+        pixRenderer.runRecordingBenchmark(iterations);
+
+        pixRenderer.cleanup();
+
+        return 0;
+    }
+
+    //--benchmark-loading [iterations] times loading every asset of objects/ and Textures/, sequentially and in parallel
+    if (argc > 1 && strcmp(argv[1], "--benchmark-loading") == 0)
+    {
+        uint32_t iterations = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 3;
+
+        if (pixRenderer.initHeadlessRenderer(1024, 768) == EXIT_FAILURE)
+        {
+            return EXIT_FAILURE;
+        }
+
+        pixRenderer.runLoadingBenchmark(iterations);
+
+        pixRenderer.cleanup();
+
+        return 0;
+    }
+
+    //--benchmark-decode [iterations] times decoding every png/jpg of Textures/ to rgba at each simd level, no device needed
+    if (argc > 1 && strcmp(argv[1], "--benchmark-decode") == 0)
+    {
+        uint32_t iterations = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 3;
+        PixelImageDecoder::runBenchmark("Textures", iterations);
+        return 0;
+    }
+
+    //--benchmark-bvh [triangleCount] times building and refitting the ray tracing BVH on one thread and on the job system
+    if (argc > 1 && strcmp(argv[1], "--benchmark-bvh") == 0)
+    {
+        uint32_t triangleCount = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 1000000;
+        PixelJobSystem jobSystem;
+        jobSystem.init(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+        PixelBVH::runBenchmark(triangleCount, &jobSystem);
+        jobSystem.cleanUp();
+        return 0;
+    }
+
+    //--compress-textures encodes every png/jpg texture to BC with its mips ahead of time, no device needed
+    if (argc > 1 && strcmp(argv[1], "--compress-textures") == 0)
+    {
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator("Textures", error))
+        {
+            std::string path = entry.path().string();
+            std::string extension = entry.path().extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+            if (extension != ".png" && extension != ".jpg" && extension != ".jpeg" && extension != ".bmp" && extension != ".tga")
+            {
+                continue;
+            }
+
+            PixelTextureCompressor::TextureData texture{};
+            if (!PixelTextureCompressor::compressFile(path, texture))
+            {
+                printf("Could not decode %s\n", path.c_str());
+                continue;
+            }
+            printf("%s: %ux%u, %u levels, %.2f MB (%.2f MB as rgba8)\n", path.c_str(), texture.width, texture.height, texture.mipLevels,
+                   (float)texture.size / (1024.0f * 1024.0f),
+                   (float)(texture.width * texture.height * 4) * 4.0f / 3.0f / (1024.0f * 1024.0f));
+            stbi_image_free(texture.data);
+        }
+
+        return 0;
+    }
+
 	if (pixRenderer.initRenderer() == EXIT_FAILURE)
 	{
 		return EXIT_FAILURE;
@@ -20,4 +129,4 @@ int main()
 	pixRenderer.cleanup();
 
 	return 0;
-}
\ No newline at end of file
+}